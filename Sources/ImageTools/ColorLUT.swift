@@ -0,0 +1,59 @@
+//
+//  ColorLUT.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ColorLUT {
+    /// Loads a 3D lookup table from a _.cube_ file.
+    static func load(path: String) throws -> ColorLUT {
+        var error = ImageToolsError()
+        let lut: ColorLUT? = path.withCString { cString in
+            ColorLUT.__loadUnsafe(path: cString, &error)
+        }
+        guard let lut else {
+            throw error
+        }
+        
+        return lut
+    }
+    
+    
+    /// Parses contents of a _.cube_ file.
+    static func load(data: Data) throws -> ColorLUT {
+        var error = ImageToolsError()
+        let lut: ColorLUT? = data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return nil }
+            return ColorLUT.__loadUnsafe(buffer: baseAddress, size: data.count, &error)
+        }
+        guard let lut else {
+            throw error
+        }
+        
+        return lut
+    }
+    
+    
+    /// Creates a table with the [0, 1] domain from `size * size * size` RGB entries, red changes fastest.
+    static func create(size: Int, entries: [Float]) throws -> ColorLUT {
+        guard size > 0, entries.count == size * size * size * 3 else {
+            throw ImageToolsError.other("Number of entries doesn't match the table size")
+        }
+        
+        var error = ImageToolsError()
+        let lut: ColorLUT? = entries.withUnsafeBufferPointer { pointer in
+            ColorLUT.__createUnsafe(size: size, entries: pointer.baseAddress!, &error)
+        }
+        guard let lut else {
+            throw error
+        }
+        
+        return lut
+    }
+}
@@ -0,0 +1,67 @@
+//
+//  ImageBatchLoader.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+/// Receives a loaded image or the reason of the failure. Called on the thread that called ``ImageBatchLoader/load(assumedColorProfile:assumeSRGB:_:)`` in the order images finish loading. Return `true` to cancel loading.
+public typealias ImageBatchLoaderHandler = (_ index: Int, _ result: Result<ImageContainer, ImageToolsError>) -> Bool
+
+fileprivate struct BatchLoaderContext {
+    var handler: ImageBatchLoaderHandler
+}
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImageBatchLoader {
+    /// Adds an encoded image and returns its index. The data is copied.
+    @discardableResult
+    func add(data: Data) -> Int {
+        data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else {
+                // Empty data fails to load like any other invalid image
+                return withUnsafeBytes(of: UInt8(0)) { byte in
+                    __addUnsafe(buffer: byte.baseAddress!, size: 0, copy: true)
+                }
+            }
+            
+            return __addUnsafe(buffer: baseAddress, size: data.count, copy: true)
+        }
+    }
+    
+    
+    /// Loads all items and passes results to the handler in completion order.
+    ///
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    func load(assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true, _ handler: ImageBatchLoaderHandler) throws {
+        try withoutActuallyEscaping(handler) { escapingHandler in
+            var context = BatchLoaderContext(handler: escapingHandler)
+            var error = ImageToolsError()
+            let success = withUnsafeMutablePointer(to: &context) { pointer in
+                __loadUnsafe(assumedColorProfile, assumeSRGB, userInfo: pointer, callback: { userInfo, index, image, error in
+                    guard let userInfo else {
+                        return true
+                    }
+                    
+                    let context = userInfo.assumingMemoryBound(to: BatchLoaderContext.self)
+                    let result: Result<ImageContainer, ImageToolsError>
+                    if let image {
+                        result = .success(image)
+                    }
+                    else {
+                        result = .failure(error?.pointee ?? ImageToolsError.other("Could not load image"))
+                    }
+                    return context.pointee.handler(index, result) || Task.isCancelled
+                }, error: &error)
+            }
+            guard success else {
+                throw error.unwrapError()
+            }
+        }
+    }
+}
@@ -76,6 +76,165 @@ public extension ImageContainer {
     }
     
     
+    /// Loads a region and/or a reduced version of an image from a path.
+    ///
+    /// The whole image is still decoded, only the region is kept. Throws if the region is outside of the image or the reduction factor is not 1, 2, 4 or 8.
+    ///
+    /// - Parameter path: Path to load image from.
+    /// - Parameter options: Region and reduction factor to decode.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func load(path: String, options: ImageLoadOptions, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = path.withCString { cString in
+            ImageContainer.__loadUnsafe(path: cString, options: options, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Loads a region and/or a reduced version of an image from memory.
+    ///
+    /// The whole image is still decoded, only the region is kept. Throws if the region is outside of the image or the reduction factor is not 1, 2, 4 or 8.
+    ///
+    /// - Parameter data: Encoded image data.
+    /// - Parameter options: Region and reduction factor to decode.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func load(data: Data, options: ImageLoadOptions, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return nil }
+            return ImageContainer.__loadUnsafe(buffer: baseAddress, size: data.count, options: options, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Opens an image saved in the native format. Contents are mapped into memory, not read.
+    ///
+    /// - Parameter path: Path to a file written by ``save(path:)``.
+    static func open(path: String) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = path.withCString { cString in
+            ImageContainer.__openUnsafe(path: cString, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Saves the image in the native format, which can be opened without decoding.
+    func save(path: String) throws {
+        var error = ImageToolsError()
+        let success = path.withCString { cString in
+            __saveUnsafe(path: cString, &error)
+        }
+        guard success else {
+            throw error
+        }
+    }
+    
+    
+    /// Creates an image container with contents stored in a memory-mapped file, for images that don't fit into memory.
+    ///
+    /// - Parameter path: File to store contents in. If `nil`, an unnamed temporary file is used.
+    static func createFileBacked(pixelFormat: ImagePixelFormat, colorProfile: LCMSColorProfile? = nil, sRGB: Bool, hdr: Bool, width: Int, height: Int, depth: Int = 1, path: String? = nil) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer?
+        if let path {
+            image = path.withCString { cString in
+                ImageContainer.__createFileBackedUnsafe(pixelFormat, colorProfile, sRGB, hdr, width, height, depth, path: cString, &error)
+            }
+        }
+        else {
+            image = ImageContainer.__createFileBackedUnsafe(pixelFormat, colorProfile, sRGB, hdr, width, height, depth, path: nil, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Creates a copy of the image with contents stored in a memory-mapped file.
+    ///
+    /// - Parameter path: File to store contents in. If `nil`, an unnamed temporary file is used.
+    func copyToFile(path: String? = nil) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer?
+        if let path {
+            image = path.withCString { cString in
+                __copyToFileUnsafe(path: cString, &error)
+            }
+        }
+        else {
+            image = __copyToFileUnsafe(path: nil, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Loads an image header from a path and decodes pixels on first access.
+    ///
+    /// - Parameter path: Path to load image from.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func loadLazily(path: String, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = path.withCString { cString in
+            ImageContainer.__loadLazilyUnsafe(path: cString, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Loads an image header from memory and decodes pixels on first access.
+    ///
+    /// - Parameter data: Encoded image data.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func loadLazily(data: Data, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> sending ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return nil }
+            return ImageContainer.__loadLazilyUnsafe(buffer: baseAddress, size: data.count, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    /// Decodes pixels of a lazily loaded image container.
+    ///
+    /// Throws the decoding error even if pixels were accessed before, in that case contents are filled with zeros.
+    func decode() throws {
+        var error = ImageToolsError()
+        guard __decodeUnsafe(&error) else {
+            throw error
+        }
+    }
+    
+    
     static func load(path: String, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) async throws -> sending ImageContainer {
         try await Task { @concurrent in
             return try ImageContainer.load(path: path, assumedColorProfile: assumedColorProfile, assumeSRGB: assumeSRGB)
@@ -88,11 +247,64 @@ public extension ImageContainer {
             return try ImageContainer.load(data: data, assumedColorProfile: assumedColorProfile, assumeSRGB: assumeSRGB)
         }.value
     }
+    
+    
+    static func load(path: String, options: ImageLoadOptions, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) async throws -> sending ImageContainer {
+        try await Task { @concurrent in
+            return try ImageContainer.load(path: path, options: options, assumedColorProfile: assumedColorProfile, assumeSRGB: assumeSRGB)
+        }.value
+    }
+    
+    
+    static func load(data: Data, options: ImageLoadOptions, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) async throws -> sending ImageContainer {
+        try await Task { @concurrent in
+            return try ImageContainer.load(data: data, options: options, assumedColorProfile: assumedColorProfile, assumeSRGB: assumeSRGB)
+        }.value
+    }
+}
+
+
+/// Per-component statistics and histograms of an image.
+public struct ImageStatistics {
+    /// Statistics of every component.
+    public var channels: [ImageChannelStatistics]
+    
+    /// Histogram of every component.
+    public var histograms: [[Int]]
 }
 
 
 @available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
 public extension ImageContainer {
+    /// Calculates statistics and histograms of every component in one pass.
+    ///
+    /// - Parameter histogramRange: Values outside of the range are counted in the edge bins.
+    func calculateStatistics(numBins: Int = 256, histogramRange: ClosedRange<Float> = 0...1) throws -> ImageStatistics {
+        guard numBins > 0 else {
+            throw ImageToolsError.other("Number of histogram bins has to be positive")
+        }
+        
+        let numComponents = Int(pixelFormat.numComponents)
+        var channels = [ImageChannelStatistics](repeating: ImageChannelStatistics(), count: numComponents)
+        var counts = [Int](repeating: 0, count: numComponents * numBins)
+        
+        var error = ImageToolsError()
+        let success = channels.withUnsafeMutableBufferPointer { channelsPointer in
+            counts.withUnsafeMutableBufferPointer { countsPointer in
+                __calculateStatisticsUnsafe(channelsPointer.baseAddress!, countsPointer.baseAddress, numBins: numBins, histogramMin: histogramRange.lowerBound, histogramMax: histogramRange.upperBound, &error)
+            }
+        }
+        guard success else {
+            throw error
+        }
+        
+        let histograms = (0 ..< numComponents).map { component in
+            Array(counts[component * numBins ..< (component + 1) * numBins])
+        }
+        return ImageStatistics(channels: channels, histograms: histograms)
+    }
+    
+    
     //func createResampled() {
     //
     //}
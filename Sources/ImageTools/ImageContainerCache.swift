@@ -0,0 +1,29 @@
+//
+//  ImageContainerCache.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImageContainerCache {
+    /// Returns a cached image or loads it from a path.
+    ///
+    /// - Parameter path: Path to load image from.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    func load(path: String, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> ImageContainer {
+        var error = ImageToolsError()
+        let image: ImageContainer? = path.withCString { cString in
+            __loadUnsafe(path: cString, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let image else {
+            throw error
+        }
+        
+        return image
+    }
+}
@@ -0,0 +1,85 @@
+//
+//  ImageDiskCache.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImageDiskCacheKey {
+    mutating func add(_ data: Data) {
+        data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return }
+            __addUnsafe(baseAddress, size: data.count)
+        }
+    }
+    
+    
+    mutating func add(_ string: String) {
+        string.withCString { cString in
+            add(cString)
+        }
+    }
+    
+    
+    mutating func addFile(path: String) throws {
+        var error = ImageToolsError()
+        let success = path.withCString { cString in
+            __addFileUnsafe(path: cString, &error)
+        }
+        guard success else {
+            throw error
+        }
+    }
+}
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImageDiskCache {
+    static func create(directory: String, maxBytes: Int) throws -> ImageDiskCache {
+        var error = ImageToolsError()
+        let cache: ImageDiskCache? = directory.withCString { cString in
+            ImageDiskCache.__createUnsafe(directory: cString, maxBytes: maxBytes, &error)
+        }
+        guard let cache else {
+            throw error
+        }
+        
+        return cache
+    }
+    
+    
+    func storeImage(_ image: ImageContainer, for key: ImageDiskCacheKey) throws {
+        var error = ImageToolsError()
+        guard __storeImageUnsafe(key, image, &error) else {
+            throw error
+        }
+    }
+    
+    
+    func storeData(_ data: Data, for key: ImageDiskCacheKey) throws {
+        var error = ImageToolsError()
+        let success = data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return false }
+            return __storeDataUnsafe(key, baseAddress, size: data.count, &error)
+        }
+        guard success else {
+            throw error
+        }
+    }
+    
+    
+    func loadData(for key: ImageDiskCacheKey) -> Data? {
+        var data: Data? = nil
+        let found = withUnsafeMutablePointer(to: &data) { pointer in
+            __loadDataUnsafe(key, userInfo: pointer) { userInfo, bytes, size in
+                userInfo?.assumingMemoryBound(to: Data?.self).pointee = Data(bytes: bytes, count: size)
+            }
+        }
+        return found ? data : nil
+    }
+}
@@ -65,6 +65,15 @@ public extension ImageEditor {
     }
     
     
+    func applyColorLUT(_ lut: ColorLUT, interpolation: ColorLUTInterpolation = .tetrahedral, linearize: Bool = false) throws {
+        var error = ImageToolsError()
+        let success = __applyColorLUTUnsafe(lut, interpolation: interpolation, linearize: linearize, error: &error)
+        guard success else {
+            throw error
+        }
+    }
+    
+    
     func resample(_ algorithm: ResamplingAlgorithm, quality: Float,
                   width: Int, height: Int, depth: Int,
                   renormalize: Bool,
@@ -0,0 +1,42 @@
+//
+//  ImagePyramidBuilder.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+/// Receives a pyramid tile. Called concurrently from multiple threads. Return `true` to cancel building the pyramid.
+public typealias ImagePyramidTileHandler = @Sendable (_ level: Int, _ column: Int, _ row: Int, _ tile: ImageContainer) -> Bool
+
+fileprivate struct PyramidContext {
+    var handler: ImagePyramidTileHandler
+}
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImagePyramidBuilder {
+    /// Builds a deep zoom pyramid of the image and passes its tiles to the handler.
+    static func build(_ image: ImageContainer, options: ImagePyramidOptions = ImagePyramidOptions(), _ handler: ImagePyramidTileHandler) throws {
+        try withoutActuallyEscaping(handler) { escapingHandler in
+            var context = PyramidContext(handler: escapingHandler)
+            var error = ImageToolsError()
+            let success = withUnsafeMutablePointer(to: &context) { pointer in
+                ImagePyramidBuilder.__buildUnsafe(image, options: options, userInfo: pointer, callback: { userInfo, level, column, row, tile in
+                    guard let userInfo else {
+                        return true
+                    }
+                    
+                    let context = userInfo.assumingMemoryBound(to: PyramidContext.self)
+                    return context.pointee.handler(level, column, row, tile) || Task.isCancelled
+                }, &error)
+            }
+            guard success else {
+                throw error.unwrapError()
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+//
+//  ImageRowSource.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+/// Receives a batch of tightly packed rows in the source's pixel format. Called on the thread that called ``ImageRowSource/drain(rowsPerBatch:_:)``. Return `true` to cancel reading.
+public typealias ImageRowSourceHandler = (_ rows: UnsafeRawBufferPointer, _ firstRow: Int, _ numRows: Int) -> Bool
+
+fileprivate struct RowSourceContext {
+    var handler: ImageRowSourceHandler
+    var bytesPerRow: Int
+}
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension ImageRowSource {
+    /// Opens an image for row streaming.
+    ///
+    /// - Parameter path: Path to load image from.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func open(path: String, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> ImageRowSource {
+        var error = ImageToolsError()
+        let source: ImageRowSource? = path.withCString { cString in
+            ImageRowSource.__openUnsafe(path: cString, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let source else {
+            throw error
+        }
+        
+        return source
+    }
+    
+    
+    /// Opens an image in memory for row streaming.
+    ///
+    /// - Parameter data: Encoded image data.
+    /// - Parameter assumeSRGB: Assume the color profile to be sRGB if it could not be determined during the image loading process.
+    static func open(data: Data, assumedColorProfile: LCMSColorProfile? = nil, assumeSRGB: Bool = true) throws -> ImageRowSource {
+        var error = ImageToolsError()
+        let source: ImageRowSource? = data.withUnsafeBytes { pointer in
+            guard let baseAddress = pointer.baseAddress else { return nil }
+            return ImageRowSource.__openUnsafe(buffer: baseAddress, size: data.count, assumedColorProfile, assumeSRGB, &error)
+        }
+        guard let source else {
+            throw error
+        }
+        
+        return source
+    }
+    
+    
+    /// Reads all rows and passes them in batches to the handler.
+    ///
+    /// The next batch is produced on a separate thread while the handler processes the current one. Rows are only valid during the handler call.
+    func drain(rowsPerBatch: Int = 64, _ handler: ImageRowSourceHandler) throws {
+        try withoutActuallyEscaping(handler) { escapingHandler in
+            var context = RowSourceContext(handler: escapingHandler, bytesPerRow: bytesPerRow)
+            var error = ImageToolsError()
+            let success = withUnsafeMutablePointer(to: &context) { pointer in
+                __drainUnsafe(rowsPerBatch: rowsPerBatch, userInfo: pointer, callback: { userInfo, rows, firstRow, numRows in
+                    guard let userInfo else {
+                        return true
+                    }
+                    
+                    let context = userInfo.assumingMemoryBound(to: RowSourceContext.self)
+                    let buffer = UnsafeRawBufferPointer(start: rows, count: numRows * context.pointee.bytesPerRow)
+                    return context.pointee.handler(buffer, firstRow, numRows) || Task.isCancelled
+                }, error: &error)
+            }
+            guard success else {
+                throw error.unwrapError()
+            }
+        }
+    }
+    
+    
+    /// Reads all rows into a new image container.
+    func createImage() throws -> ImageContainer {
+        var error = ImageToolsError()
+        guard let image = __createImageUnsafe(&error) else {
+            throw error
+        }
+        
+        return image
+    }
+}
@@ -105,6 +105,13 @@ public extension ImageContainer {
                 componentMask = CGImageComponentInfo.integer.rawValue
                 orderMask = CGImageByteOrderInfo.orderDefault.rawValue
                 
+            case .uint16:
+                componentMask = CGImageComponentInfo.integer.rawValue
+                orderMask = CGImageByteOrderInfo.order16Little.rawValue
+                
+            case .uint32:
+                throw ImageToolsError.other("32-bit integer components are not supported by CGImage")
+                
             case .float16:
                 componentMask = CGImageComponentInfo.float.rawValue
                 orderMask = CGImageByteOrderInfo.order16Little.rawValue
@@ -124,7 +131,7 @@ public extension ImageContainer {
                 height: height,
                 bitsPerComponent: componentSize * 8,
                 bitsPerPixel: componentSize * 8 * numComponents,
-                bytesPerRow: width * componentSize * numComponents,
+                bytesPerRow: bytesPerRow,
                 space: cgColorProfile,
                 bitmapInfo: .init(rawValue: componentMask | orderMask | alphaMask),
                 provider: dataProvider,
@@ -0,0 +1,117 @@
+//
+//  TiledImage.swift
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+import Foundation
+import ImageToolsC
+
+
+@available(macOS 13.3, iOS 16.4, tvOS 16.4, watchOS 9.4, visionOS 1.0, *)
+public extension TiledImage {
+    /// Splits an image into tiles stored in a temporary file.
+    ///
+    /// - Parameter cacheSize: Maximum size of tiles kept in memory in bytes.
+    static func create(_ image: ImageContainer, tileSize: Int = 512, cacheSize: Int = 512 * 1024 * 1024) throws -> TiledImage {
+        var error = ImageToolsError()
+        guard let tiledImage = TiledImage.__createUnsafe(image, tileSize: tileSize, cacheSize: cacheSize, &error) else {
+            throw error
+        }
+        
+        return tiledImage
+    }
+    
+    
+    /// Reads rows of the source into tiles. The source's decode stage holds the whole decoded image until all rows are read.
+    ///
+    /// - Parameter cacheSize: Maximum size of tiles kept in memory in bytes.
+    static func create(_ source: ImageRowSource, tileSize: Int = 512, cacheSize: Int = 512 * 1024 * 1024) throws -> TiledImage {
+        var error = ImageToolsError()
+        guard let tiledImage = TiledImage.__createUnsafe(source, tileSize: tileSize, cacheSize: cacheSize, &error) else {
+            throw error
+        }
+        
+        return tiledImage
+    }
+    
+    
+    /// Copies a region of the image into an image container.
+    func createImage(x: Int, y: Int, width: Int, height: Int) throws -> ImageContainer {
+        var error = ImageToolsError()
+        guard let image = __createImageUnsafe(x: x, y: y, width: width, height: height, &error) else {
+            throw error
+        }
+        
+        return image
+    }
+    
+    
+    func setImage(_ image: ImageContainer, x: Int, y: Int) throws {
+        var error = ImageToolsError()
+        guard __setImageUnsafe(image, x: x, y: y, &error) else {
+            throw error
+        }
+    }
+    
+    
+    func flush() throws {
+        var error = ImageToolsError()
+        guard __flushUnsafe(&error) else {
+            throw error
+        }
+    }
+    
+    
+    func createPromoted(_ componentType: PixelComponentType, _ progressCallback: ImageContainerCallback = { _ in }) throws -> TiledImage {
+        return try withImageContainerCallback(progressCallback) { userInfo in
+            var error = ImageToolsError()
+            guard let image = __createPromotedUnsafe(componentType, error: &error, userInfo: userInfo, progressCallback: imageContainerCCallback) else {
+                throw error.unwrapError()
+            }
+            return image
+        }
+    }
+    
+    
+    func createSRGBToLinearConverted(preserveAlpha: Bool, _ progressCallback: ImageContainerCallback = { _ in }) throws -> TiledImage {
+        return try withImageContainerCallback(progressCallback) { userInfo in
+            var error = ImageToolsError()
+            guard let image = __createSRGBToLinearConvertedUnsafe(preserveAlpha: preserveAlpha, error: &error, userInfo: userInfo, progressCallback: imageContainerCCallback) else {
+                throw error.unwrapError()
+            }
+            return image
+        }
+    }
+    
+    
+    func createLinearToSRGBConverted(preserveAlpha: Bool, _ progressCallback: ImageContainerCallback = { _ in }) throws -> TiledImage {
+        return try withImageContainerCallback(progressCallback) { userInfo in
+            var error = ImageToolsError()
+            guard let image = __createLinearToSRGBConvertedUnsafe(preserveAlpha: preserveAlpha, error: &error, userInfo: userInfo, progressCallback: imageContainerCCallback) else {
+                throw error.unwrapError()
+            }
+            return image
+        }
+    }
+    
+    
+    func createResampled(quality: Float, width: Int, height: Int, renormalize: Bool = false, _ progressCallback: ImageContainerCallback = { _ in }) throws -> TiledImage {
+        return try withImageContainerCallback(progressCallback) { userInfo in
+            var error = ImageToolsError()
+            guard let image = __createResampledUnsafe(quality: quality, width: width, height: height, renormalize: renormalize, error: &error, userInfo: userInfo, progressCallback: imageContainerCCallback) else {
+                throw error.unwrapError()
+            }
+            return image
+        }
+    }
+    
+    
+    func setChannel(_ channelIndex: Int, image: TiledImage, imageChannelIndex: Int) throws {
+        var error = ImageToolsError()
+        guard __setChannelUnsafe(channelIndex, image, imageChannelIndex, &error) else {
+            throw error
+        }
+    }
+}
@@ -0,0 +1,523 @@
+//
+//  ColorLUT.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ColorLUT.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define USE_X86_KERNELS 1
+#else
+#define USE_X86_KERNELS 0
+#endif
+
+
+/// Largest supported number of entries along every axis. Common tables have 17, 33 or 65 entries.
+static constexpr long _maxSize = 256;
+
+/// Number of pixels converted at once to the planar layout used by lookup kernels.
+static constexpr long _blockLength = 256;
+
+
+ColorLUT::ColorLUT(long size, const float* fn_nonnull domainMin, const float* fn_nonnull domainMax, std::vector<float>&& entries):
+_referenceCounter(1),
+_size(size),
+_domainMin { domainMin[0], domainMin[1], domainMin[2] },
+_domainMax { domainMax[0], domainMax[1], domainMax[2] },
+_entries(std::move(entries)) {
+    //
+}
+
+
+ColorLUT::~ColorLUT() {
+    //
+}
+
+
+// MARK: - Parsing
+
+/// Reads up to `count` numbers from the string.
+///
+/// - Returns: Number of numbers read.
+static long _parseNumbers(const char* fn_nonnull string, float* fn_nonnull numbers, long count) {
+    for (long i = 0; i < count; i++) {
+        char* end = nullptr;
+        numbers[i] = strtof(string, &end);
+        if (end == string) {
+            return i;
+        }
+        string = end;
+    }
+    return count;
+}
+
+
+static bool _checkKeyword(const std::string& line, const char* fn_nonnull keyword) {
+    auto length = strlen(keyword);
+    return line.compare(0, length, keyword) == 0 && (line.size() == length || isspace(static_cast<unsigned char>(line[length])));
+}
+
+
+ColorLUT* fn_nullable ColorLUT::load(const char* fn_nonnull buffer fn_noescape, long bufferSize, ImageToolsError* fn_nullable error fn_noescape) {
+    long size = 0;
+    float domainMin[3] = { 0, 0, 0 };
+    float domainMax[3] = { 1, 1, 1 };
+    auto entries = std::vector<float>();
+    
+    auto line = std::string();
+    long position = 0;
+    while (position < bufferSize) {
+        // Copy the line, so numbers are parsed from a terminated string
+        auto end = position;
+        while (end < bufferSize && buffer[end] != '\n' && buffer[end] != '\r') {
+            end++;
+        }
+        line.assign(buffer + position, end - position);
+        position = end + 1;
+        
+        // Skip indentation, empty lines and comments
+        auto first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        line.erase(0, first);
+        
+        // Table entry
+        if (isalpha(static_cast<unsigned char>(line[0])) == false) {
+            if (size == 0) {
+                ImageToolsError::set(error, "Table entries precede LUT_3D_SIZE");
+                return nullptr;
+            }
+            
+            float entry[3];
+            if (_parseNumbers(line.c_str(), entry, 3) != 3) {
+                ImageToolsError::set(error, "Table entry has less than 3 values");
+                return nullptr;
+            }
+            if (static_cast<long>(entries.size()) >= size * size * size * 3) {
+                ImageToolsError::set(error, "Table has more entries than LUT_3D_SIZE specifies");
+                return nullptr;
+            }
+            entries.insert(entries.end(), entry, entry + 3);
+            continue;
+        }
+        
+        // Keywords
+        if (_checkKeyword(line, "LUT_3D_SIZE")) {
+            size = strtol(line.c_str() + strlen("LUT_3D_SIZE"), nullptr, 10);
+            if (size < 2 || size > _maxSize) {
+                ImageToolsError::set(error, "LUT_3D_SIZE is out of the supported range");
+                return nullptr;
+            }
+            entries.reserve(size * size * size * 3);
+        }
+        else if (_checkKeyword(line, "LUT_1D_SIZE")) {
+            ImageToolsError::set(error, "1D lookup tables are not supported");
+            return nullptr;
+        }
+        else if (_checkKeyword(line, "DOMAIN_MIN")) {
+            if (_parseNumbers(line.c_str() + strlen("DOMAIN_MIN"), domainMin, 3) != 3) {
+                ImageToolsError::set(error, "DOMAIN_MIN has less than 3 values");
+                return nullptr;
+            }
+        }
+        else if (_checkKeyword(line, "DOMAIN_MAX")) {
+            if (_parseNumbers(line.c_str() + strlen("DOMAIN_MAX"), domainMax, 3) != 3) {
+                ImageToolsError::set(error, "DOMAIN_MAX has less than 3 values");
+                return nullptr;
+            }
+        }
+        else if (_checkKeyword(line, "LUT_3D_INPUT_RANGE")) {
+            // Variant of the format that specifies the same domain for all axes
+            float range[2];
+            if (_parseNumbers(line.c_str() + strlen("LUT_3D_INPUT_RANGE"), range, 2) != 2) {
+                ImageToolsError::set(error, "LUT_3D_INPUT_RANGE has less than 2 values");
+                return nullptr;
+            }
+            std::fill_n(domainMin, 3, range[0]);
+            std::fill_n(domainMax, 3, range[1]);
+        }
+        // TITLE and unknown keywords don't affect the table
+    }
+    
+    if (size == 0) {
+        ImageToolsError::set(error, "LUT_3D_SIZE is not specified");
+        return nullptr;
+    }
+    
+    if (static_cast<long>(entries.size()) != size * size * size * 3) {
+        ImageToolsError::set(error, "Table has less entries than LUT_3D_SIZE specifies");
+        return nullptr;
+    }
+    
+    for (auto i = 0; i < 3; i++) {
+        if ((domainMax[i] > domainMin[i]) == false) {
+            ImageToolsError::set(error, "DOMAIN_MAX has to be greater than DOMAIN_MIN");
+            return nullptr;
+        }
+    }
+    
+    return new ColorLUT(size, domainMin, domainMax, std::move(entries));
+}
+
+
+ColorLUT* fn_nullable ColorLUT::load(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    auto file = fopen(path, "rb");
+    if (file == nullptr) {
+        ImageToolsError::set(error, "Could not open file");
+        return nullptr;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    auto size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        ImageToolsError::set(error, "File is empty");
+        return nullptr;
+    }
+    
+    auto contents = std::vector<char>(size);
+    auto numRead = fread(contents.data(), 1, size, file);
+    fclose(file);
+    if (static_cast<long>(numRead) != size) {
+        ImageToolsError::set(error, "Could not read file");
+        return nullptr;
+    }
+    
+    return load(contents.data(), size, error);
+}
+
+
+ColorLUT* fn_nullable ColorLUT::create(long size, const float* fn_nonnull entries fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    if (size < 2 || size > _maxSize) {
+        ImageToolsError::set(error, "Unsupported table size");
+        return nullptr;
+    }
+    
+    static const float domainMin[3] = { 0, 0, 0 };
+    static const float domainMax[3] = { 1, 1, 1 };
+    auto numValues = size * size * size * 3;
+    return new ColorLUT(size, domainMin, domainMax, std::vector<float>(entries, entries + numValues));
+}
+
+
+long ColorLUT::getSize() {
+    return _size;
+}
+
+
+// MARK: - Lookup
+
+/// Table layout prepared for lookups.
+struct LookupTable {
+    const float* fn_nonnull entries;
+    
+    /// Distance between neighbouring entries along red, green and blue axes in floats.
+    long redStride;
+    long greenStride;
+    long blueStride;
+    
+    /// Maps domain values to entry coordinates.
+    float offset[3];
+    float scale[3];
+    
+    /// Coordinate of the last entry along every axis.
+    float maxCoordinate;
+};
+
+
+/// Looks up planar red, green and blue values in place.
+typedef void (* LookupKernel)(const LookupTable& table, float* fn_nonnull red, float* fn_nonnull green, float* fn_nonnull blue, long count);
+
+
+/// Splits a value into the index of the lower entry and the fraction towards the upper one. Values outside of the domain are clamped, NaN is looked up as the domain minimum.
+static inline void _locate(const LookupTable& table, long axis, float value, long& index, float& fraction) {
+    auto coordinate = std::min(table.maxCoordinate, std::max(0.0f, (value - table.offset[axis]) * table.scale[axis]));
+    index = std::min(static_cast<long>(coordinate), static_cast<long>(table.maxCoordinate) - 1);
+    fraction = coordinate - static_cast<float>(index);
+}
+
+
+static void _lookupTrilinearScalar(const LookupTable& table, float* fn_nonnull red, float* fn_nonnull green, float* fn_nonnull blue, long count) {
+    auto sr = table.redStride;
+    auto sg = table.greenStride;
+    auto sb = table.blueStride;
+    
+    for (long i = 0; i < count; i++) {
+        long ir, ig, ib;
+        float fr, fg, fb;
+        _locate(table, 0, red[i], ir, fr);
+        _locate(table, 1, green[i], ig, fg);
+        _locate(table, 2, blue[i], ib, fb);
+        
+        auto c = table.entries + ir * sr + ig * sg + ib * sb;
+        float result[3];
+        for (auto channel = 0; channel < 3; channel++) {
+            auto c00 = c[channel] + (c[sr + channel] - c[channel]) * fr;
+            auto c10 = c[sg + channel] + (c[sr + sg + channel] - c[sg + channel]) * fr;
+            auto c01 = c[sb + channel] + (c[sr + sb + channel] - c[sb + channel]) * fr;
+            auto c11 = c[sg + sb + channel] + (c[sr + sg + sb + channel] - c[sg + sb + channel]) * fr;
+            auto c0 = c00 + (c10 - c00) * fg;
+            auto c1 = c01 + (c11 - c01) * fg;
+            result[channel] = c0 + (c1 - c0) * fb;
+        }
+        
+        red[i] = result[0];
+        green[i] = result[1];
+        blue[i] = result[2];
+    }
+}
+
+
+// Tetrahedral interpolation walks from the lower entry to the upper one along axes sorted by their fractions, largest first.
+// The colour is a blend of the 4 visited entries weighted by differences of sorted fractions. Ties may pick any order since the skipped step gets zero weight.
+
+static void _lookupTetrahedralScalar(const LookupTable& table, float* fn_nonnull red, float* fn_nonnull green, float* fn_nonnull blue, long count) {
+    auto sr = table.redStride;
+    auto sg = table.greenStride;
+    auto sb = table.blueStride;
+    
+    for (long i = 0; i < count; i++) {
+        long ir, ig, ib;
+        float fr, fg, fb;
+        _locate(table, 0, red[i], ir, fr);
+        _locate(table, 1, green[i], ig, fg);
+        _locate(table, 2, blue[i], ib, fb);
+        
+        // First step goes along the axis with the largest fraction, ties resolve to red, then green
+        auto redIsMax = fr >= fg && fr >= fb;
+        auto greenIsMax = redIsMax == false && fg >= fb;
+        auto firstStep = redIsMax ? sr : (greenIsMax ? sg : sb);
+        
+        // Second step leaves out the axis with the smallest fraction, ties resolve to blue, then green
+        auto blueIsMin = fb <= fg && fb <= fr;
+        auto greenIsMin = blueIsMin == false && fg <= fr;
+        auto secondStep = sr + sg + sb - (blueIsMin ? sb : (greenIsMin ? sg : sr));
+        
+        auto maxFraction = std::max(fr, std::max(fg, fb));
+        auto minFraction = std::min(fr, std::min(fg, fb));
+        auto midFraction = fr + fg + fb - maxFraction - minFraction;
+        
+        auto c0 = table.entries + ir * sr + ig * sg + ib * sb;
+        auto c1 = c0 + firstStep;
+        auto c2 = c0 + secondStep;
+        auto c3 = c0 + sr + sg + sb;
+        
+        float result[3];
+        for (auto channel = 0; channel < 3; channel++) {
+            result[channel] = c0[channel] * (1 - maxFraction) +
+                              c1[channel] * (maxFraction - midFraction) +
+                              c2[channel] * (midFraction - minFraction) +
+                              c3[channel] * minFraction;
+        }
+        
+        red[i] = result[0];
+        green[i] = result[1];
+        blue[i] = result[2];
+    }
+}
+
+
+#if USE_X86_KERNELS
+
+#define X86_KERNEL __attribute__((target("avx2")))
+
+/// Splits 8 values into entry indices and fractions like ``_locate``.
+X86_KERNEL static inline void _locate_x86(const LookupTable& table, long axis, __m256 value, __m256i& index, __m256& fraction) {
+    auto coordinate = _mm256_mul_ps(_mm256_sub_ps(value, _mm256_set1_ps(table.offset[axis])), _mm256_set1_ps(table.scale[axis]));
+    // max returns the second operand for NaN
+    coordinate = _mm256_min_ps(_mm256_max_ps(coordinate, _mm256_setzero_ps()), _mm256_set1_ps(table.maxCoordinate));
+    index = _mm256_min_epi32(_mm256_cvttps_epi32(coordinate), _mm256_set1_epi32(static_cast<int>(table.maxCoordinate) - 1));
+    fraction = _mm256_sub_ps(coordinate, _mm256_cvtepi32_ps(index));
+}
+
+
+X86_KERNEL static inline __m256 _gather_x86(const float* fn_nonnull entries, __m256i index, int offset) {
+    return _mm256_i32gather_ps(entries, _mm256_add_epi32(index, _mm256_set1_epi32(offset)), 4);
+}
+
+
+X86_KERNEL static inline __m256 _lerp_x86(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+
+X86_KERNEL static void _lookupTrilinear_x86(const LookupTable& table, float* fn_nonnull red, float* fn_nonnull green, float* fn_nonnull blue, long count) {
+    // Tables have at most 256^3 entries, so indices fit into 32 bits
+    auto sr = static_cast<int>(table.redStride);
+    auto sg = static_cast<int>(table.greenStride);
+    auto sb = static_cast<int>(table.blueStride);
+    
+    long i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ir, ig, ib;
+        __m256 fr, fg, fb;
+        _locate_x86(table, 0, _mm256_loadu_ps(red + i), ir, fr);
+        _locate_x86(table, 1, _mm256_loadu_ps(green + i), ig, fg);
+        _locate_x86(table, 2, _mm256_loadu_ps(blue + i), ib, fb);
+        
+        auto base = _mm256_add_epi32(_mm256_mullo_epi32(ir, _mm256_set1_epi32(sr)),
+                                     _mm256_add_epi32(_mm256_mullo_epi32(ig, _mm256_set1_epi32(sg)),
+                                                      _mm256_mullo_epi32(ib, _mm256_set1_epi32(sb))));
+        
+        __m256 result[3];
+        for (auto channel = 0; channel < 3; channel++) {
+            auto c00 = _lerp_x86(_gather_x86(table.entries, base, channel), _gather_x86(table.entries, base, sr + channel), fr);
+            auto c10 = _lerp_x86(_gather_x86(table.entries, base, sg + channel), _gather_x86(table.entries, base, sr + sg + channel), fr);
+            auto c01 = _lerp_x86(_gather_x86(table.entries, base, sb + channel), _gather_x86(table.entries, base, sr + sb + channel), fr);
+            auto c11 = _lerp_x86(_gather_x86(table.entries, base, sg + sb + channel), _gather_x86(table.entries, base, sr + sg + sb + channel), fr);
+            result[channel] = _lerp_x86(_lerp_x86(c00, c10, fg), _lerp_x86(c01, c11, fg), fb);
+        }
+        
+        _mm256_storeu_ps(red + i, result[0]);
+        _mm256_storeu_ps(green + i, result[1]);
+        _mm256_storeu_ps(blue + i, result[2]);
+    }
+    
+    _lookupTrilinearScalar(table, red + i, green + i, blue + i, count - i);
+}
+
+
+X86_KERNEL static void _lookupTetrahedral_x86(const LookupTable& table, float* fn_nonnull red, float* fn_nonnull green, float* fn_nonnull blue, long count) {
+    auto sr = _mm256_set1_epi32(static_cast<int>(table.redStride));
+    auto sg = _mm256_set1_epi32(static_cast<int>(table.greenStride));
+    auto sb = _mm256_set1_epi32(static_cast<int>(table.blueStride));
+    auto diagonal = _mm256_add_epi32(sr, _mm256_add_epi32(sg, sb));
+    auto one = _mm256_set1_ps(1);
+    
+    long i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ir, ig, ib;
+        __m256 fr, fg, fb;
+        _locate_x86(table, 0, _mm256_loadu_ps(red + i), ir, fr);
+        _locate_x86(table, 1, _mm256_loadu_ps(green + i), ig, fg);
+        _locate_x86(table, 2, _mm256_loadu_ps(blue + i), ib, fb);
+        
+        // Same axis order as the scalar kernel, selected with masks
+        auto redIsMax = _mm256_and_ps(_mm256_cmp_ps(fr, fg, _CMP_GE_OQ), _mm256_cmp_ps(fr, fb, _CMP_GE_OQ));
+        auto greenIsMax = _mm256_andnot_ps(redIsMax, _mm256_cmp_ps(fg, fb, _CMP_GE_OQ));
+        auto firstStep = _mm256_blendv_epi8(_mm256_blendv_epi8(sb, sg, _mm256_castps_si256(greenIsMax)), sr, _mm256_castps_si256(redIsMax));
+        
+        auto blueIsMin = _mm256_and_ps(_mm256_cmp_ps(fb, fg, _CMP_LE_OQ), _mm256_cmp_ps(fb, fr, _CMP_LE_OQ));
+        auto greenIsMin = _mm256_andnot_ps(blueIsMin, _mm256_cmp_ps(fg, fr, _CMP_LE_OQ));
+        auto skippedStep = _mm256_blendv_epi8(_mm256_blendv_epi8(sr, sg, _mm256_castps_si256(greenIsMin)), sb, _mm256_castps_si256(blueIsMin));
+        auto secondStep = _mm256_sub_epi32(diagonal, skippedStep);
+        
+        auto maxFraction = _mm256_max_ps(fr, _mm256_max_ps(fg, fb));
+        auto minFraction = _mm256_min_ps(fr, _mm256_min_ps(fg, fb));
+        auto midFraction = _mm256_sub_ps(_mm256_add_ps(fr, _mm256_add_ps(fg, fb)), _mm256_add_ps(maxFraction, minFraction));
+        
+        auto w0 = _mm256_sub_ps(one, maxFraction);
+        auto w1 = _mm256_sub_ps(maxFraction, midFraction);
+        auto w2 = _mm256_sub_ps(midFraction, minFraction);
+        
+        auto c0 = _mm256_add_epi32(_mm256_mullo_epi32(ir, sr), _mm256_add_epi32(_mm256_mullo_epi32(ig, sg), _mm256_mullo_epi32(ib, sb)));
+        auto c1 = _mm256_add_epi32(c0, firstStep);
+        auto c2 = _mm256_add_epi32(c0, secondStep);
+        auto c3 = _mm256_add_epi32(c0, diagonal);
+        
+        __m256 result[3];
+        for (auto channel = 0; channel < 3; channel++) {
+            auto sum = _mm256_mul_ps(_gather_x86(table.entries, c0, channel), w0);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_gather_x86(table.entries, c1, channel), w1));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_gather_x86(table.entries, c2, channel), w2));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_gather_x86(table.entries, c3, channel), minFraction));
+            result[channel] = sum;
+        }
+        
+        _mm256_storeu_ps(red + i, result[0]);
+        _mm256_storeu_ps(green + i, result[1]);
+        _mm256_storeu_ps(blue + i, result[2]);
+    }
+    
+    _lookupTetrahedralScalar(table, red + i, green + i, blue + i, count - i);
+}
+
+
+static bool _checkX86KernelsSupported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+
+// MARK: - Dispatch
+
+struct LookupKernels {
+    LookupKernel fn_nonnull trilinear;
+    LookupKernel fn_nonnull tetrahedral;
+};
+
+
+// NEON has no gather instructions, so arm64 uses scalar kernels
+static LookupKernels _createKernels() {
+    auto kernels = LookupKernels {
+        .trilinear = _lookupTrilinearScalar,
+        .tetrahedral = _lookupTetrahedralScalar
+    };
+    
+#if USE_X86_KERNELS
+    if (_checkX86KernelsSupported()) {
+        kernels.trilinear = _lookupTrilinear_x86;
+        kernels.tetrahedral = _lookupTetrahedral_x86;
+    }
+#endif
+    
+    return kernels;
+}
+
+
+void ColorLUT::_apply(float* fn_nonnull values, long numPixels, long numComponents, ColorLUTInterpolation interpolation) const {
+    static const auto kernels = _createKernels();
+    auto lookup = interpolation == ColorLUTInterpolation::tetrahedral ? kernels.tetrahedral : kernels.trilinear;
+    
+    auto table = LookupTable {
+        .entries = _entries.data(),
+        .redStride = 3,
+        .greenStride = _size * 3,
+        .blueStride = _size * _size * 3,
+        .offset = { _domainMin[0], _domainMin[1], _domainMin[2] },
+        .scale = {
+            (_size - 1) / (_domainMax[0] - _domainMin[0]),
+            (_size - 1) / (_domainMax[1] - _domainMin[1]),
+            (_size - 1) / (_domainMax[2] - _domainMin[2])
+        },
+        .maxCoordinate = static_cast<float>(_size - 1)
+    };
+    
+    // Kernels work on planar values
+    float red[_blockLength];
+    float green[_blockLength];
+    float blue[_blockLength];
+    for (long first = 0; first < numPixels; first += _blockLength) {
+        auto count = std::min(_blockLength, numPixels - first);
+        auto pixels = values + first * numComponents;
+        
+        for (long i = 0; i < count; i++) {
+            red[i] = pixels[i * numComponents + 0];
+            green[i] = pixels[i * numComponents + 1];
+            blue[i] = pixels[i * numComponents + 2];
+        }
+        
+        lookup(table, red, green, blue, count);
+        
+        for (long i = 0; i < count; i++) {
+            pixels[i * numComponents + 0] = red[i];
+            pixels[i * numComponents + 1] = green[i];
+            pixels[i * numComponents + 2] = blue[i];
+        }
+    }
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(ColorLUT)
@@ -0,0 +1,184 @@
+//
+//  ColorProfiles.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include "ColorProfiles.hpp"
+#include <mutex>
+#include <string_view>
+
+
+struct SharedColorProfile {
+    ColorProfileDescription description;
+    
+    /// Hash of ICC data, so lookups compare bytes only for likely matches.
+    size_t iccDataHash;
+    
+    LCMSColorProfile* fn_nonnull profile;
+};
+
+
+static std::mutex _sharedColorProfilesMutex;
+static std::vector<SharedColorProfile> _sharedColorProfiles;
+
+
+static size_t _hashICCData(const std::vector<char>& iccData) {
+    return std::hash<std::string_view>()(std::string_view(iccData.data(), iccData.size()));
+}
+
+
+/// Must be called with locked mutex.
+static LCMSColorProfile* fn_nullable _findSharedColorProfile(const ColorProfileDescription& description, size_t iccDataHash) {
+    for (auto& shared: _sharedColorProfiles) {
+        if (shared.description.origin == description.origin &&
+            shared.description.linear == description.linear &&
+            shared.iccDataHash == iccDataHash &&
+            shared.description.iccData == description.iccData) {
+            return LCMSColorProfileRetain(shared.profile);
+        }
+    }
+    return nullptr;
+}
+
+
+/// Must be called with locked mutex.
+static const SharedColorProfile* fn_nullable _findSharedColorProfile(LCMSColorProfile* fn_nonnull profile) {
+    for (auto& shared: _sharedColorProfiles) {
+        if (shared.profile == profile) {
+            return &shared;
+        }
+    }
+    return nullptr;
+}
+
+
+static LCMSColorProfile* fn_nullable _createBaseColorProfile(const ColorProfileDescription& description) {
+    switch (description.origin) {
+        case ColorProfileOrigin::sRGB: return LCMSColorProfile::createSRGB();
+        case ColorProfileOrigin::rec709: return LCMSColorProfile::createRec709();
+        case ColorProfileOrigin::iccData:
+            if (description.iccData.empty()) {
+                return nullptr;
+            }
+            return LCMSColorProfile::create(description.iccData.data(), static_cast<long>(description.iccData.size()));
+    }
+    return nullptr;
+}
+
+
+LCMSColorProfile* fn_nullable createSharedColorProfile(const ColorProfileDescription& description) {
+    auto iccDataHash = _hashICCData(description.iccData);
+    
+    std::lock_guard lock(_sharedColorProfilesMutex);
+    if (auto profile = _findSharedColorProfile(description, iccDataHash)) {
+        return profile;
+    }
+    
+    auto profile = _createBaseColorProfile(description);
+    if (profile && description.linear) {
+        auto linearProfile = profile->checkIsLinear() ? LCMSColorProfileRetain(profile) : profile->createLinear();
+        LCMSColorProfileRelease(profile);
+        profile = linearProfile;
+    }
+    if (profile == nullptr) {
+        return nullptr;
+    }
+    
+    _sharedColorProfiles.push_back(SharedColorProfile {
+        .description = description,
+        .iccDataHash = iccDataHash,
+        .profile = LCMSColorProfileRetain(profile)
+    });
+    return profile;
+}
+
+
+LCMSColorProfile* fn_nullable createSharedColorProfile(const void* fn_nonnull iccData, long iccDataLength) {
+    auto bytes = reinterpret_cast<const char*>(iccData);
+    auto description = ColorProfileDescription {
+        .origin = ColorProfileOrigin::iccData,
+        .linear = false,
+        .iccData = std::vector<char>(bytes, bytes + iccDataLength)
+    };
+    return createSharedColorProfile(description);
+}
+
+
+LCMSColorProfile* fn_nonnull createSharedSRGBColorProfile() {
+    auto description = ColorProfileDescription {
+        .origin = ColorProfileOrigin::sRGB,
+        .linear = false,
+        .iccData = {}
+    };
+    return createSharedColorProfile(description);
+}
+
+
+LCMSColorProfile* fn_nonnull createSharedRec709ColorProfile() {
+    auto description = ColorProfileDescription {
+        .origin = ColorProfileOrigin::rec709,
+        .linear = false,
+        .iccData = {}
+    };
+    return createSharedColorProfile(description);
+}
+
+
+LCMSColorProfile* fn_nullable createSharedLinearColorProfile(LCMSColorProfile* fn_nonnull profile) {
+    auto description = ColorProfileDescription();
+    if (describeSharedColorProfile(profile, description) == false) {
+        return profile->createLinear();
+    }
+    
+    description.linear = true;
+    return createSharedColorProfile(description);
+}
+
+
+bool describeSharedColorProfile(LCMSColorProfile* fn_nonnull profile, ColorProfileDescription& description) {
+    std::lock_guard lock(_sharedColorProfilesMutex);
+    auto shared = _findSharedColorProfile(profile);
+    if (shared == nullptr) {
+        return false;
+    }
+    
+    description = shared->description;
+    return true;
+}
+
+
+bool getSharedColorProfileHash(LCMSColorProfile* fn_nonnull profile, size_t& hash) {
+    std::lock_guard lock(_sharedColorProfilesMutex);
+    auto shared = _findSharedColorProfile(profile);
+    if (shared == nullptr) {
+        return false;
+    }
+    
+    auto originHash = static_cast<size_t>(shared->description.origin) * 2 + (shared->description.linear ? 1 : 0);
+    hash = shared->iccDataHash ^ (originHash + 0x9e3779b97f4a7c15ull + (shared->iccDataHash << 6) + (shared->iccDataHash >> 2));
+    return true;
+}
+
+
+bool checkIsSRGBTransferConversion(LCMSColorProfile* fn_nonnull sourceProfile, LCMSColorProfile* fn_nonnull destinationProfile, bool& toLinear) {
+    // Don't copy descriptions, ICC data may be large
+    std::lock_guard lock(_sharedColorProfilesMutex);
+    auto source = _findSharedColorProfile(sourceProfile);
+    auto destination = _findSharedColorProfile(destinationProfile);
+    if (source == nullptr || destination == nullptr) {
+        return false;
+    }
+    
+    if (source->description.origin != ColorProfileOrigin::sRGB || destination->description.origin != ColorProfileOrigin::sRGB) {
+        return false;
+    }
+    
+    if (source->description.linear == destination->description.linear) {
+        return false;
+    }
+    
+    toLinear = destination->description.linear;
+    return true;
+}
@@ -0,0 +1,62 @@
+//
+//  ColorProfiles.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <LCMS2C/LCMS2C.hpp>
+#include <vector>
+
+
+/// Origin of a shared colour profile.
+enum class ColorProfileOrigin: uint32_t {
+    sRGB = 1,
+    rec709 = 2,
+    iccData = 3
+};
+
+
+/// Everything needed to recreate a shared colour profile, for example after reading an image from disk.
+struct ColorProfileDescription {
+    ColorProfileOrigin origin;
+    
+    /// The profile is a linear version of the origin profile.
+    bool linear;
+    
+    /// ICC profile data if origin is ``ColorProfileOrigin/iccData``.
+    std::vector<char> iccData;
+};
+
+
+// Shared colour profiles are created once per unique origin and kept alive for the lifetime of the process, so their origin can be looked up later. LCMSColorProfile does not expose its ICC data.
+// All functions return retained profiles and are thread-safe.
+
+LCMSColorProfile* fn_nullable createSharedColorProfile(const void* fn_nonnull iccData, long iccDataLength);
+LCMSColorProfile* fn_nonnull createSharedSRGBColorProfile();
+LCMSColorProfile* fn_nonnull createSharedRec709ColorProfile();
+
+/// Returns a shared linear version of the profile. If the profile is not shared, the returned profile is not shared either.
+LCMSColorProfile* fn_nullable createSharedLinearColorProfile(LCMSColorProfile* fn_nonnull profile);
+
+/// Recreates a shared profile from its description.
+LCMSColorProfile* fn_nullable createSharedColorProfile(const ColorProfileDescription& description);
+
+/// Looks up the description of a shared profile.
+///
+/// - Returns: `false` if the profile was not created using shared profile functions.
+bool describeSharedColorProfile(LCMSColorProfile* fn_nonnull profile, ColorProfileDescription& description);
+
+/// Computes a hash of the shared profile's origin, so equal profiles get equal hashes even after the profile pointer is reused.
+///
+/// - Returns: `false` if the profile was not created using shared profile functions.
+bool getSharedColorProfileHash(LCMSColorProfile* fn_nonnull profile, size_t& hash);
+
+
+/// Checks if converting between two profiles only applies the sRGB transfer function, so no LCMS transform has to be built.
+///
+/// - Returns: `true` if one profile is the shared sRGB profile and the other one is its shared linear version. `toLinear` is set to `true` if the destination profile is linear.
+bool checkIsSRGBTransferConversion(LCMSColorProfile* fn_nonnull sourceProfile, LCMSColorProfile* fn_nonnull destinationProfile, bool& toLinear);
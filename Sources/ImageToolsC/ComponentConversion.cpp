@@ -0,0 +1,242 @@
+//
+//  ComponentConversion.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include "ComponentConversion.hpp"
+#include "PixelComponents.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define USE_X86_KERNELS 1
+#else
+#define USE_X86_KERNELS 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_KERNELS 1
+#else
+#define USE_NEON_KERNELS 0
+#endif
+
+
+static constexpr long _numComponentTypes = 5;
+
+
+// MARK: - Scalar kernels
+
+// Vector kernels process the tail with these, so both produce identical results. Like the vector min and max, _fromFloat converts NaN to 0
+template <typename SourceType, typename DestinationType>
+static void _convertScalar(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+    _convertComponents<SourceType, DestinationType>(source, destination, count);
+}
+
+
+// MARK: - x86 kernels
+
+#if USE_X86_KERNELS
+
+#define X86_KERNEL __attribute__((target("avx2,f16c")))
+
+
+X86_KERNEL static inline __m256 _loadUInt8_x86(const uint8_t* fn_nonnull source) {
+    auto integers = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)));
+    return _mm256_div_ps(_mm256_cvtepi32_ps(integers), _mm256_set1_ps(255.0f));
+}
+
+
+X86_KERNEL static inline void _storeUInt8_x86(uint8_t* fn_nonnull destination, __m256 values) {
+    // Same as _fromFloat<uint8_t> - clamp and round
+    auto scaled = _mm256_mul_ps(values, _mm256_set1_ps(255.0f));
+    auto clamped = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    auto integers = _mm256_cvttps_epi32(_mm256_add_ps(clamped, _mm256_set1_ps(0.5f)));
+    auto words = _mm_packus_epi32(_mm256_castsi256_si128(integers), _mm256_extracti128_si256(integers, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), _mm_packus_epi16(words, words));
+}
+
+
+X86_KERNEL static inline __m256 _loadFloat16_x86(const _Float16* fn_nonnull source) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+}
+
+
+X86_KERNEL static inline void _storeFloat16_x86(_Float16* fn_nonnull destination, __m256 values) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+}
+
+
+X86_KERNEL static inline __m256 _load_x86(const uint8_t* fn_nonnull source) { return _loadUInt8_x86(source); }
+X86_KERNEL static inline __m256 _load_x86(const _Float16* fn_nonnull source) { return _loadFloat16_x86(source); }
+X86_KERNEL static inline __m256 _load_x86(const float* fn_nonnull source) { return _mm256_loadu_ps(source); }
+
+X86_KERNEL static inline void _store_x86(uint8_t* fn_nonnull destination, __m256 values) { _storeUInt8_x86(destination, values); }
+X86_KERNEL static inline void _store_x86(_Float16* fn_nonnull destination, __m256 values) { _storeFloat16_x86(destination, values); }
+X86_KERNEL static inline void _store_x86(float* fn_nonnull destination, __m256 values) { _mm256_storeu_ps(destination, values); }
+
+
+template <typename SourceType, typename DestinationType>
+X86_KERNEL static void _convert_x86(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+    auto src = reinterpret_cast<const SourceType*>(source);
+    auto dst = reinterpret_cast<DestinationType*>(destination);
+    
+    // Eight components at a time. Each block is loaded before it's stored, so narrowing conversions can run in place
+    long index = 0;
+    for (; index + 8 <= count; index += 8) {
+        _store_x86(dst + index, _load_x86(src + index));
+    }
+    
+    _convertScalar<SourceType, DestinationType>(reinterpret_cast<const char*>(src + index), reinterpret_cast<char*>(dst + index), count - index);
+}
+
+
+static bool _checkX86KernelsSupported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+}
+
+#endif
+
+
+// MARK: - NEON kernels
+
+#if USE_NEON_KERNELS
+
+static inline float32x4x2_t _loadUInt8_neon(const uint8_t* fn_nonnull source) {
+    auto words = vmovl_u8(vld1_u8(source));
+    auto scale = vdupq_n_f32(255.0f);
+    return {
+        vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), scale),
+        vdivq_f32(vcvtq_f32_u32(vmovl_high_u16(words)), scale)
+    };
+}
+
+
+static inline void _storeUInt8_neon(uint8_t* fn_nonnull destination, float32x4x2_t values) {
+    // Same as _fromFloat<uint8_t> - clamp and round
+    auto scale = vdupq_n_f32(255.0f);
+    auto zero = vdupq_n_f32(0.0f);
+    auto half = vdupq_n_f32(0.5f);
+    auto low = vcvtq_u32_f32(vaddq_f32(vminq_f32(vmaxq_f32(vmulq_f32(values.val[0], scale), zero), scale), half));
+    auto high = vcvtq_u32_f32(vaddq_f32(vminq_f32(vmaxq_f32(vmulq_f32(values.val[1], scale), zero), scale), half));
+    vst1_u8(destination, vmovn_u16(vcombine_u16(vmovn_u32(low), vmovn_u32(high))));
+}
+
+
+static inline float32x4x2_t _loadFloat16_neon(const _Float16* fn_nonnull source) {
+    auto halves = vld1q_f16(reinterpret_cast<const float16_t*>(source));
+    return { vcvt_f32_f16(vget_low_f16(halves)), vcvt_high_f32_f16(halves) };
+}
+
+
+static inline void _storeFloat16_neon(_Float16* fn_nonnull destination, float32x4x2_t values) {
+    vst1q_f16(reinterpret_cast<float16_t*>(destination), vcvt_high_f16_f32(vcvt_f16_f32(values.val[0]), values.val[1]));
+}
+
+
+static inline float32x4x2_t _load_neon(const uint8_t* fn_nonnull source) { return _loadUInt8_neon(source); }
+static inline float32x4x2_t _load_neon(const _Float16* fn_nonnull source) { return _loadFloat16_neon(source); }
+static inline float32x4x2_t _load_neon(const float* fn_nonnull source) { return { vld1q_f32(source), vld1q_f32(source + 4) }; }
+
+static inline void _store_neon(uint8_t* fn_nonnull destination, float32x4x2_t values) { _storeUInt8_neon(destination, values); }
+static inline void _store_neon(_Float16* fn_nonnull destination, float32x4x2_t values) { _storeFloat16_neon(destination, values); }
+static inline void _store_neon(float* fn_nonnull destination, float32x4x2_t values) { vst1q_f32(destination, values.val[0]); vst1q_f32(destination + 4, values.val[1]); }
+
+
+template <typename SourceType, typename DestinationType>
+static void _convert_neon(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+    auto src = reinterpret_cast<const SourceType*>(source);
+    auto dst = reinterpret_cast<DestinationType*>(destination);
+    
+    // Eight components at a time. Each block is loaded before it's stored, so narrowing conversions can run in place
+    long index = 0;
+    for (; index + 8 <= count; index += 8) {
+        _store_neon(dst + index, _load_neon(src + index));
+    }
+    
+    _convertScalar<SourceType, DestinationType>(reinterpret_cast<const char*>(src + index), reinterpret_cast<char*>(dst + index), count - index);
+}
+
+#endif
+
+
+// MARK: - Dispatch
+
+struct ComponentConversionKernels {
+    ComponentConversionKernel fn_nonnull kernels[_numComponentTypes][_numComponentTypes];
+};
+
+
+template <typename SourceType>
+static void _fillScalarKernels(ComponentConversionKernels& table, PixelComponentType sourceType) {
+    auto& kernels = table.kernels[static_cast<long>(sourceType)];
+    kernels[static_cast<long>(PixelComponentType::uint8)] = _convertScalar<SourceType, uint8_t>;
+    kernels[static_cast<long>(PixelComponentType::uint16)] = _convertScalar<SourceType, uint16_t>;
+    kernels[static_cast<long>(PixelComponentType::uint32)] = _convertScalar<SourceType, uint32_t>;
+    kernels[static_cast<long>(PixelComponentType::float16)] = _convertScalar<SourceType, _Float16>;
+    kernels[static_cast<long>(PixelComponentType::float32)] = _convertScalar<SourceType, float>;
+}
+
+
+template <template <typename, typename> class Kernel>
+static void _fillVectorKernels(ComponentConversionKernels& table) {
+    auto set = [&](PixelComponentType sourceType, PixelComponentType destinationType, ComponentConversionKernel kernel) {
+        table.kernels[static_cast<long>(sourceType)][static_cast<long>(destinationType)] = kernel;
+    };
+    set(PixelComponentType::uint8, PixelComponentType::float16, Kernel<uint8_t, _Float16>::convert);
+    set(PixelComponentType::uint8, PixelComponentType::float32, Kernel<uint8_t, float>::convert);
+    set(PixelComponentType::float16, PixelComponentType::uint8, Kernel<_Float16, uint8_t>::convert);
+    set(PixelComponentType::float16, PixelComponentType::float32, Kernel<_Float16, float>::convert);
+    set(PixelComponentType::float32, PixelComponentType::uint8, Kernel<float, uint8_t>::convert);
+    set(PixelComponentType::float32, PixelComponentType::float16, Kernel<float, _Float16>::convert);
+}
+
+
+#if USE_X86_KERNELS
+template <typename SourceType, typename DestinationType>
+struct X86Kernel {
+    static void convert(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+        _convert_x86<SourceType, DestinationType>(source, destination, count);
+    }
+};
+#endif
+
+
+#if USE_NEON_KERNELS
+template <typename SourceType, typename DestinationType>
+struct NEONKernel {
+    static void convert(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+        _convert_neon<SourceType, DestinationType>(source, destination, count);
+    }
+};
+#endif
+
+
+static ComponentConversionKernels _createKernels() {
+    ComponentConversionKernels table;
+    _fillScalarKernels<uint8_t>(table, PixelComponentType::uint8);
+    _fillScalarKernels<uint16_t>(table, PixelComponentType::uint16);
+    _fillScalarKernels<uint32_t>(table, PixelComponentType::uint32);
+    _fillScalarKernels<_Float16>(table, PixelComponentType::float16);
+    _fillScalarKernels<float>(table, PixelComponentType::float32);
+    
+#if USE_X86_KERNELS
+    if (_checkX86KernelsSupported()) {
+        _fillVectorKernels<X86Kernel>(table);
+    }
+#endif
+
+#if USE_NEON_KERNELS
+    _fillVectorKernels<NEONKernel>(table);
+#endif
+    
+    return table;
+}
+
+
+ComponentConversionKernel fn_nonnull getComponentConversionKernel(PixelComponentType sourceType, PixelComponentType destinationType) {
+    static const auto table = _createKernels();
+    return table.kernels[static_cast<long>(sourceType)][static_cast<long>(destinationType)];
+}
@@ -0,0 +1,24 @@
+//
+//  ComponentConversion.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+
+
+/// Converts a run of components.
+///
+/// Source and destination may point to the same memory if the destination component is not larger than the source one.
+typedef void (* ComponentConversionKernel)(const char* fn_nonnull source, char* fn_nonnull destination, long count);
+
+
+// Kernels are selected once per process depending on what the CPU supports - F16C and AVX2 on x86, NEON on arm64 - and fall back to scalar loops.
+// The function is thread-safe.
+
+/// Returns the fastest kernel converting components of the source type to the destination type.
+ComponentConversionKernel fn_nonnull getComponentConversionKernel(PixelComponentType sourceType, PixelComponentType destinationType);
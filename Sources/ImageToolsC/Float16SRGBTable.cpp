@@ -0,0 +1,33 @@
+//
+//  Float16SRGBTable.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include "Float16SRGBTable.hpp"
+#include "UInt8SRGBTable.hpp"
+#include "Threading.hpp"
+
+
+static Float16SRGBTable* fn_nonnull _createFloat16SRGBTable() {
+    auto table = new Float16SRGBTable;
+    
+    // 128 blocks of 512 values, every block computes its own entries
+    CONCURRENT_LOOP_START(0, 128, block) {
+        for (auto index = block * 512; index < (block + 1) * 512; index++) {
+            auto value = std::bit_cast<_Float16>(static_cast<uint16_t>(index));
+            table->linear[index] = static_cast<_Float16>(fromSRGBToLinear(static_cast<float>(value)));
+            table->srgb[index] = static_cast<_Float16>(fromLinearToSRGB(static_cast<float>(value)));
+        }
+    } CONCURRENT_LOOP_END
+    
+    return table;
+}
+
+
+const Float16SRGBTable& getFloat16SRGBTable() {
+    // Never released, lives as long as the process like uint8Table
+    static auto table = _createFloat16SRGBTable();
+    return *table;
+}
@@ -0,0 +1,59 @@
+//
+//  Float16SRGBTable.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <bit>
+
+
+/// `float16` value tables. Half floats have only 65536 bit patterns, so every conversion is a single lookup.
+///
+/// Indices are bit patterns of source values. Entries are computed using ``fromSRGBToLinear`` and ``fromLinearToSRGB``, so lookups produce exactly the same results.
+struct Float16SRGBTable {
+    /// Source values are in `sRGB` space.
+    _Float16 linear[65536];
+    
+    /// Source values are in `linear` space.
+    _Float16 srgb[65536];
+};
+
+
+/// Returns the table, computing it on first use. Thread-safe.
+const Float16SRGBTable& getFloat16SRGBTable();
+
+
+/// Replaces `float16` values with their table entries, leaving the alpha component untouched if `numColorComponents` is smaller than `numComponents`.
+static inline void applyFloat16SRGBTable(const _Float16* fn_nonnull table, _Float16* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    auto lookup = [table](_Float16 value) { return table[std::bit_cast<uint16_t>(value)]; };
+    
+    if (numColorComponents == numComponents) {
+        auto count = numPixels * numComponents;
+        long index = 0;
+        for (; index + 4 <= count; index += 4) {
+            auto v0 = lookup(values[index + 0]);
+            auto v1 = lookup(values[index + 1]);
+            auto v2 = lookup(values[index + 2]);
+            auto v3 = lookup(values[index + 3]);
+            values[index + 0] = v0;
+            values[index + 1] = v1;
+            values[index + 2] = v2;
+            values[index + 3] = v3;
+        }
+        for (; index < count; index++) {
+            values[index] = lookup(values[index]);
+        }
+        return;
+    }
+    
+    for (long index = 0; index < numPixels; index++) {
+        for (auto i = 0; i < numColorComponents; i++) {
+            values[i] = lookup(values[i]);
+        }
+        values += numComponents;
+    }
+}
@@ -0,0 +1,195 @@
+//
+//  ImageAllocator.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImageAllocator.hpp>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+
+/// Smaller buffers are cheap to allocate and are not pooled.
+static constexpr long _minPooledSize = 1024 * 1024;
+
+
+/// Stored in front of every allocated buffer.
+struct AllocationHeader {
+    /// Size of the buffer without the header. Rounded up to the size class for pooled buffers.
+    long size;
+    
+    /// The buffer is allocated from a custom arena.
+    bool custom;
+    ImageAllocatorArena arena;
+};
+
+static_assert(sizeof(AllocationHeader) <= IMAGE_ALLOCATOR_ALIGNMENT, "Allocation header must fit into alignment");
+
+
+struct AllocatorState {
+    std::mutex mutex;
+    bool hasArena = false;
+    ImageAllocatorArena arena {};
+    long maxPooledSize = 256l * 1024 * 1024;
+    long pooledSize = 0;
+    
+    /// Released buffers by size class.
+    std::unordered_map<long, std::vector<AllocationHeader*>> pool;
+};
+
+
+static AllocatorState& _getState() {
+    static AllocatorState state;
+    return state;
+}
+
+
+static long _getSizeClass(long size) {
+    if (size < _minPooledSize) {
+        return size;
+    }
+    
+    // Four classes per power of two waste at most a quarter of a buffer
+    long power = _minPooledSize;
+    while (power * 2 <= size) {
+        power *= 2;
+    }
+    auto step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+
+static AllocationHeader* fn_nonnull _allocateBuffer(long size, const ImageAllocatorArena* fn_nullable arena) {
+    auto totalSize = size + IMAGE_ALLOCATOR_ALIGNMENT;
+    void* memory = nullptr;
+    if (arena) {
+        memory = arena->allocate(arena->userInfo, totalSize, IMAGE_ALLOCATOR_ALIGNMENT);
+    }
+    
+    auto custom = memory != nullptr;
+    if (memory == nullptr) {
+        memory = ::operator new(static_cast<size_t>(totalSize), std::align_val_t(IMAGE_ALLOCATOR_ALIGNMENT));
+    }
+    
+    return new (memory) AllocationHeader {
+        .size = size,
+        .custom = custom,
+        .arena = custom ? *arena : ImageAllocatorArena {}
+    };
+}
+
+
+static void _releaseBuffer(AllocationHeader* fn_nonnull header) {
+    auto totalSize = header->size + IMAGE_ALLOCATOR_ALIGNMENT;
+    if (header->custom) {
+        auto arena = header->arena;
+        arena.deallocate(arena.userInfo, header, totalSize, IMAGE_ALLOCATOR_ALIGNMENT);
+    }
+    else {
+        ::operator delete(header, std::align_val_t(IMAGE_ALLOCATOR_ALIGNMENT));
+    }
+}
+
+
+char* fn_nonnull ImageAllocator::allocate(long size) {
+    size = _getSizeClass(std::max(1l, size));
+    
+    auto& state = _getState();
+    AllocationHeader* header = nullptr;
+    auto hasArena = false;
+    auto arena = ImageAllocatorArena {};
+    {
+        std::lock_guard lock(state.mutex);
+        if (size >= _minPooledSize) {
+            auto entry = state.pool.find(size);
+            if (entry != state.pool.end() && entry->second.empty() == false) {
+                header = entry->second.back();
+                entry->second.pop_back();
+                state.pooledSize -= size;
+            }
+        }
+        hasArena = state.hasArena;
+        arena = state.arena;
+    }
+    
+    if (header == nullptr) {
+        header = _allocateBuffer(size, hasArena ? &arena : nullptr);
+    }
+    
+    return reinterpret_cast<char*>(header) + IMAGE_ALLOCATOR_ALIGNMENT;
+}
+
+
+void ImageAllocator::deallocate(char* fn_nullable memory) {
+    if (memory == nullptr) {
+        return;
+    }
+    
+    auto header = reinterpret_cast<AllocationHeader*>(memory - IMAGE_ALLOCATOR_ALIGNMENT);
+    if (header->size >= _minPooledSize) {
+        auto& state = _getState();
+        std::lock_guard lock(state.mutex);
+        if (state.pooledSize + header->size <= state.maxPooledSize) {
+            state.pool[header->size].push_back(header);
+            state.pooledSize += header->size;
+            return;
+        }
+    }
+    
+    _releaseBuffer(header);
+}
+
+
+void ImageAllocator::setArena(const ImageAllocatorArena* fn_nullable arena) {
+    {
+        auto& state = _getState();
+        std::lock_guard lock(state.mutex);
+        state.hasArena = arena != nullptr;
+        state.arena = arena ? *arena : ImageAllocatorArena {};
+    }
+    
+    trim();
+}
+
+
+void ImageAllocator::setMaxPooledSize(long size) {
+    auto trimPool = false;
+    {
+        auto& state = _getState();
+        std::lock_guard lock(state.mutex);
+        state.maxPooledSize = std::max(0l, size);
+        trimPool = state.pooledSize > state.maxPooledSize;
+    }
+    
+    if (trimPool) {
+        trim();
+    }
+}
+
+
+long ImageAllocator::getPooledSize() {
+    auto& state = _getState();
+    std::lock_guard lock(state.mutex);
+    return state.pooledSize;
+}
+
+
+void ImageAllocator::trim() {
+    // Release buffers outside of the lock, arenas may be slow
+    std::unordered_map<long, std::vector<AllocationHeader*>> pool;
+    {
+        auto& state = _getState();
+        std::lock_guard lock(state.mutex);
+        std::swap(pool, state.pool);
+        state.pooledSize = 0;
+    }
+    
+    for (auto& entry: pool) {
+        for (auto header: entry.second) {
+            _releaseBuffer(header);
+        }
+    }
+}
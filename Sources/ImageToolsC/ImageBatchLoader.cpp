@@ -0,0 +1,292 @@
+//
+//  ImageBatchLoader.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImageBatchLoader.hpp>
+#include "Threading.hpp"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+
+ImageBatchLoader::ImageBatchLoader(long ioConcurrency, long decodeConcurrency, long maxInFlightBytes):
+_referenceCounter(1),
+_ioConcurrency(ioConcurrency),
+_decodeConcurrency(decodeConcurrency),
+_maxInFlightBytes(maxInFlightBytes),
+_items() {
+    //
+}
+
+
+ImageBatchLoader::~ImageBatchLoader() {
+    //
+}
+
+
+ImageBatchLoader* fn_nonnull ImageBatchLoader::create(long ioConcurrency, long decodeConcurrency, long maxInFlightBytes) {
+    auto numCores = std::max(1l, static_cast<long>(std::thread::hardware_concurrency()));
+    if (ioConcurrency <= 0) {
+        // Reading files is mostly waiting, a few threads are enough to keep decoders busy
+        ioConcurrency = std::min(4l, numCores);
+    }
+    if (decodeConcurrency <= 0) {
+        decodeConcurrency = numCores;
+    }
+    maxInFlightBytes = std::max(0l, maxInFlightBytes);
+    
+    return new ImageBatchLoader(ioConcurrency, decodeConcurrency, maxInFlightBytes);
+}
+
+
+long ImageBatchLoader::addPath(const char* fn_nonnull path fn_noescape) {
+    _items.push_back(_Item {
+        .usePath = true,
+        .path = path,
+        .buffer = nullptr,
+        .bufferSize = 0,
+        .contents = std::vector<char>()
+    });
+    return static_cast<long>(_items.size()) - 1;
+}
+
+
+long ImageBatchLoader::addBuffer(const void* fn_nonnull buffer, long bufferSize, bool copy) {
+    auto bytes = reinterpret_cast<const char*>(buffer);
+    _items.push_back(_Item {
+        .usePath = false,
+        .path = std::string(),
+        .buffer = copy ? nullptr : buffer,
+        .bufferSize = bufferSize,
+        .contents = copy ? std::vector<char>(bytes, bytes + std::max(0l, bufferSize)) : std::vector<char>()
+    });
+    return static_cast<long>(_items.size()) - 1;
+}
+
+
+void ImageBatchLoader::removeAll() {
+    _items.clear();
+}
+
+
+static bool _readFile(const char* fn_nonnull path, std::vector<char>& contents, ImageToolsError& error) {
+    auto file = fopen(path, "rb");
+    if (file == nullptr) {
+        error.set(ImageToolsErrorCode::other, "Could not open file");
+        return false;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    auto size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        error.set(ImageToolsErrorCode::other, "File is empty");
+        return false;
+    }
+    
+    contents.resize(size);
+    auto numRead = fread(contents.data(), 1, size, file);
+    fclose(file);
+    if (static_cast<long>(numRead) != size) {
+        error.set(ImageToolsErrorCode::other, "Could not read file");
+        return false;
+    }
+    
+    return true;
+}
+
+
+bool ImageBatchLoader::load(LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, void* fn_nullable userInfo, ImageBatchLoaderCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape) {
+    auto numItems = static_cast<long>(_items.size());
+    if (numItems == 0) {
+        return true;
+    }
+    
+    // Read file that waits to be decoded
+    struct EncodedItem {
+        long index;
+        std::vector<char> contents;
+        const void* fn_nullable buffer;
+        long bufferSize;
+        bool failed;
+        ImageToolsError error;
+    };
+    
+    // Decoded image that waits to be passed to the callback
+    struct LoadedItem {
+        long index;
+        ImageContainer* fn_nullable image;
+        long size;
+        ImageToolsError error;
+    };
+    
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<EncodedItem> encodedItems;
+    std::deque<LoadedItem> loadedItems;
+    long nextIndex = 0;
+    long numFinishedIOThreads = 0;
+    long inFlightBytes = 0;
+    bool cancelled = false;
+    
+    auto maxInFlightBytes = _maxInFlightBytes > 0 ? _maxInFlightBytes : std::numeric_limits<long>::max();
+    auto ioConcurrency = std::min(_ioConcurrency, numItems);
+    auto decodeConcurrency = std::min(_decodeConcurrency, numItems);
+    
+    // Only wait for memory to be released if something is in flight, otherwise a single huge image would block forever
+    auto hasMemoryForNextItem = [&]() {
+        return inFlightBytes < maxInFlightBytes || inFlightBytes == 0;
+    };
+    
+    // I/O
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < ioConcurrency; i++) {
+        threads.emplace_back([&]() {
+            while (true) {
+                long index = 0;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(lock, [&]() { return cancelled || nextIndex >= numItems || hasMemoryForNextItem(); });
+                    if (cancelled || nextIndex >= numItems) {
+                        break;
+                    }
+                    index = nextIndex;
+                    nextIndex += 1;
+                }
+                
+                auto& item = _items[index];
+                auto encodedItem = EncodedItem {
+                    .index = index,
+                    .contents = std::vector<char>(),
+                    .buffer = item.buffer ? item.buffer : item.contents.data(),
+                    .bufferSize = item.bufferSize,
+                    .failed = false,
+                    .error = ImageToolsError()
+                };
+                if (item.usePath) {
+                    encodedItem.failed = _readFile(item.path.c_str(), encodedItem.contents, encodedItem.error) == false;
+                    encodedItem.buffer = encodedItem.contents.data();
+                    encodedItem.bufferSize = static_cast<long>(encodedItem.contents.size());
+                }
+                else if (encodedItem.bufferSize <= 0) {
+                    encodedItem.failed = true;
+                    encodedItem.error.set(ImageToolsErrorCode::other, "Buffer is empty");
+                }
+                
+                {
+                    std::lock_guard lock(mutex);
+                    inFlightBytes += encodedItem.contents.size();
+                    encodedItems.push_back(std::move(encodedItem));
+                }
+                condition.notify_all();
+            }
+            
+            {
+                std::lock_guard lock(mutex);
+                numFinishedIOThreads += 1;
+            }
+            condition.notify_all();
+        });
+    }
+    
+    // Decode
+    for (auto i = 0; i < decodeConcurrency; i++) {
+        threads.emplace_back([&]() {
+            // Decode threads already keep all cores busy
+            auto serialLoops = SerialLoopScope();
+            
+            while (true) {
+                EncodedItem encodedItem;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(lock, [&]() {
+                        if (cancelled) {
+                            return true;
+                        }
+                        if (encodedItems.empty()) {
+                            return numFinishedIOThreads == ioConcurrency;
+                        }
+                        // Don't decode more while decoded images pile up in front of the callback
+                        return hasMemoryForNextItem() || loadedItems.empty();
+                    });
+                    if (cancelled || encodedItems.empty()) {
+                        break;
+                    }
+                    encodedItem = std::move(encodedItems.front());
+                    encodedItems.pop_front();
+                }
+                
+                auto loadedItem = LoadedItem {
+                    .index = encodedItem.index,
+                    .image = nullptr,
+                    .size = 0,
+                    .error = encodedItem.error
+                };
+                if (encodedItem.failed == false) {
+                    loadedItem.image = ImageContainer::load(encodedItem.buffer, encodedItem.bufferSize, assumedColorProfile, assumeSRGB, &loadedItem.error);
+                    if (loadedItem.image) {
+                        loadedItem.size = loadedItem.image->getContentsSize();
+                    }
+                }
+                
+                {
+                    std::lock_guard lock(mutex);
+                    inFlightBytes -= encodedItem.contents.size();
+                    inFlightBytes += loadedItem.size;
+                    loadedItems.push_back(loadedItem);
+                }
+                condition.notify_all();
+            }
+        });
+    }
+    
+    // Pass results to the callback in completion order
+    for (auto numDelivered = 0; numDelivered < numItems; numDelivered++) {
+        LoadedItem loadedItem;
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&]() { return loadedItems.empty() == false; });
+            loadedItem = loadedItems.front();
+            loadedItems.pop_front();
+        }
+        
+        auto cancel = callback(userInfo, loadedItem.index, loadedItem.image, loadedItem.image ? nullptr : &loadedItem.error);
+        ImageContainerRelease(loadedItem.image);
+        
+        {
+            std::lock_guard lock(mutex);
+            inFlightBytes -= loadedItem.size;
+            cancelled = cancel;
+        }
+        condition.notify_all();
+        
+        if (cancel) {
+            break;
+        }
+    }
+    
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    
+    // Release images loaded after cancellation
+    for (auto& loadedItem: loadedItems) {
+        ImageContainerRelease(loadedItem.image);
+    }
+    
+    if (cancelled) {
+        if (error) {
+            error->set(ImageToolsErrorCode::taskCancelled);
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(ImageBatchLoader)
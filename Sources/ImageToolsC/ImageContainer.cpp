@@ -12,7 +12,19 @@
 #include <LCMS2C/LCMS2C.hpp>
 #include "Threading.hpp"
 #include "UInt8SRGBTable.hpp"
+#include "PixelComponents.hpp"
+#include "ComponentConversion.hpp"
+#include "Float16SRGBTable.hpp"
+#include "SRGBTransfer.hpp"
+#include "ColorProfiles.hpp"
+#include "ToneMapping.hpp"
+#include "Lanczos.hpp"
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <thread>
 
 #include "stb/stb_image.h"
 #include "tinyexr/tinyexr.h"
@@ -63,6 +75,22 @@ static inline ImagePixel _getPixel_general(long x, long y, long z, long width, l
             break;
         }
             
+        case PixelComponentType::uint16: {
+            auto uint16Pixel = reinterpret_cast<uint16_t*>(contents) + index;
+            for (auto i = 0; i < numComponents; i++) {
+                pixel.contents[i] = _toFloat(uint16Pixel[i]);
+            }
+            break;
+        }
+            
+        case PixelComponentType::uint32: {
+            auto uint32Pixel = reinterpret_cast<uint32_t*>(contents) + index;
+            for (auto i = 0; i < numComponents; i++) {
+                pixel.contents[i] = _toFloat(uint32Pixel[i]);
+            }
+            break;
+        }
+            
         case PixelComponentType::float16: {
             auto float16Pixel = reinterpret_cast<_Float16*>(contents) + index;
             for (auto i = 0; i < numComponents; i++) {
@@ -136,6 +164,32 @@ static inline ImagePixel _getPixel_float32(long x, long y, long z, long width, l
 }
 
 
+template <long numComponents>
+static inline ImagePixel _getPixel_uint16(long x, long y, long z, long width, long height, long depth, char* fn_nonnull contents) {
+    auto pixel = ImagePixel();
+    
+    clamp_xyz(x, width, y, height, z, depth);
+    
+    auto index = (z * width * height + y * width + x) * numComponents;
+    
+    auto uint16Pixel = reinterpret_cast<uint16_t*>(contents) + index;
+    if constexpr (numComponents >= 1) {
+        pixel.contents[0] = _toFloat(uint16Pixel[0]);
+    }
+    if constexpr (numComponents >= 2) {
+        pixel.contents[1] = _toFloat(uint16Pixel[1]);
+    }
+    if constexpr (numComponents >= 3) {
+        pixel.contents[2] = _toFloat(uint16Pixel[2]);
+    }
+    if constexpr (numComponents >= 4) {
+        pixel.contents[3] = _toFloat(uint16Pixel[3]);
+    }
+    
+    return pixel;
+}
+
+
 // MARK: - SetPixel
 
 static inline void _setPixel_general(ImagePixel pixel, long x, long y, long z, long width, long height, long depth, char* fn_nonnull contents, long numComponents, PixelComponentType componentType) {
@@ -154,6 +208,22 @@ static inline void _setPixel_general(ImagePixel pixel, long x, long y, long z, l
             break;
         }
             
+        case PixelComponentType::uint16: {
+            auto uint16Pixel = reinterpret_cast<uint16_t*>(contents) + index;
+            for (auto i = 0; i < numComponents; i++) {
+                uint16Pixel[i] = _fromFloat<uint16_t>(pixel.contents[i]);
+            }
+            break;
+        }
+            
+        case PixelComponentType::uint32: {
+            auto uint32Pixel = reinterpret_cast<uint32_t*>(contents) + index;
+            for (auto i = 0; i < numComponents; i++) {
+                uint32Pixel[i] = _fromFloat<uint32_t>(pixel.contents[i]);
+            }
+            break;
+        }
+            
         case PixelComponentType::float16: {
             auto float16Pixel = reinterpret_cast<_Float16*>(contents) + index;
             for (auto i = 0; i < numComponents; i++) {
@@ -221,48 +291,78 @@ static inline void _setPixel_float32(ImagePixel pixel, long x, long y, long z, l
 }
 
 
-static inline bool _convertColorProfile(LCMSColorProfile* fn_nullable colorProfile, LCMSColorProfile* fn_nullable sourceColorProfile, long width, long height, char* fn_nonnull contents, ImagePixelFormat pixelFormat, bool hdr) {
-    // TODO: Create a noncopyable struct that stores LCMSImage with referenced image data to avoid unnecessary data copy
-    // TODO: For instance, struct EphemeralLCMSImage { /* ... */ };
-    // Create an image for colour conversion
-    auto cmsImage = LCMSImage::createBorrowing(contents,
-                                               width, height,
-                                               pixelFormat.numComponents, pixelFormat.getComponentSize(),
-                                               hdr,
-                                               sourceColorProfile);
-    if (cmsImage == nullptr) {
-        return false;
-    }
-    
-    // Convert colour profile
-    auto converted = cmsImage->convertColorProfile(colorProfile);
-    if (converted == false) {
-        LCMSImageRelease(cmsImage);
-        return false;
+template <long numComponents>
+static inline void _setPixel_uint16(ImagePixel pixel, long x, long y, long z, long width, long height, long depth, char* fn_nonnull contents) {
+    if ((x < 0 || x >= width) || (y < 0 || y >= height) || (z < 0 || z >= depth)) {
+        return;
     }
     
-    // Clean up
-    LCMSImageRelease(cmsImage);
+    auto index = (z * width * height + y * width + x) * numComponents;
     
-    // Success
-    return true;
+    auto uint16Pixel = reinterpret_cast<uint16_t*>(contents) + index;
+    if constexpr (numComponents >= 1) {
+        uint16Pixel[0] = _fromFloat<uint16_t>(pixel.contents[0]);
+    }
+    if constexpr (numComponents >= 2) {
+        uint16Pixel[1] = _fromFloat<uint16_t>(pixel.contents[1]);
+    }
+    if constexpr (numComponents >= 3) {
+        uint16Pixel[2] = _fromFloat<uint16_t>(pixel.contents[2]);
+    }
+    if constexpr (numComponents >= 4) {
+        uint16Pixel[3] = _fromFloat<uint16_t>(pixel.contents[3]);
+    }
 }
 
 
-// MARK: - Lanczos
+/// Minimum number of pixels converted by one band. Every band builds its own LCMS transform, so small images are converted in one go.
+static constexpr long _minColorConversionBandPixels = 64 * 1024;
 
-static inline float _sinc_float32(float x) {
-    if (x == 0.0) return 1.0;
-    x *= M_PI;
-    return sin(x) / x;
-}
 
-static inline float _lanczos_float32(float x, float a) {
-    if (fabs(x) >= a) return 0.0;
-    return _sinc_float32(x) * _sinc_float32(x / a);
+static inline bool _convertColorProfile(LCMSColorProfile* fn_nullable colorProfile, LCMSColorProfile* fn_nullable sourceColorProfile, long width, long height, long depth, char* fn_nonnull contents, ImagePixelFormat pixelFormat, bool hdr) {
+    // Contents are packed, so slices of 3D textures continue each other as rows of one tall image
+    auto numRows = height * depth;
+    auto bytesPerRow = width * pixelFormat.getSize();
+    
+    // LCMSImage builds its transform inside, so every band converts its rows with its own transform
+    auto numCores = std::max(1l, static_cast<long>(std::thread::hardware_concurrency()));
+    auto numBands = std::clamp(width * numRows / _minColorConversionBandPixels, 1l, std::min(numCores, numRows));
+    auto rowsPerBand = (numRows + numBands - 1) / numBands;
+    numBands = (numRows + rowsPerBand - 1) / rowsPerBand;
+    
+    std::atomic<bool> success = true;
+    CONCURRENT_LOOP_START(0, numBands, band) {
+        auto firstRow = band * rowsPerBand;
+        auto bandRows = std::min(rowsPerBand, numRows - firstRow);
+        
+        // TODO: Create a noncopyable struct that stores LCMSImage with referenced image data to avoid unnecessary data copy
+        // TODO: For instance, struct EphemeralLCMSImage { /* ... */ };
+        // Create an image for colour conversion
+        auto cmsImage = LCMSImage::createBorrowing(contents + firstRow * bytesPerRow,
+                                                   width, bandRows,
+                                                   pixelFormat.numComponents, pixelFormat.getComponentSize(),
+                                                   hdr,
+                                                   sourceColorProfile);
+        if (cmsImage == nullptr) {
+            success = false;
+        }
+        // Convert colour profile
+        else {
+            if (cmsImage->convertColorProfile(colorProfile) == false) {
+                success = false;
+            }
+            
+            // Clean up
+            LCMSImageRelease(cmsImage);
+        }
+    } CONCURRENT_LOOP_END
+    
+    return success;
 }
 
 
+// MARK: - Lanczos
+
 static inline _Float16 _sinc_float16(_Float16 x) {
     if (x == 0.0) return 1.0;
     x *= M_PI;
@@ -327,6 +427,23 @@ static inline ImagePixel _sampleLanczosX_float32(float x, float y, float z, floa
     return sum / totalWeight;
 }
 
+template<long numComponents>
+static inline ImagePixel _sampleLanczosX_uint16(float x, float y, float z, float a, long width, long height, long depth, char* fn_nonnull contents, bool renormalize) {
+    long left = floor(x - a + 1);
+    long right = floor(x + a);
+    auto sum = ImagePixel();
+    float totalWeight = 0.0;
+    for (auto i = left; i <= right; ++i) {
+        auto w = _lanczos_float32(x - i, a);
+        sum += _getPixel_uint16<numComponents>(i, y, z, width, height, depth, contents) * w;
+        totalWeight += w;
+    }
+    if (renormalize) {
+        return (sum / totalWeight).normalized();
+    }
+    return sum / totalWeight;
+}
+
 
 // MARK: - Lanczos Y
 
@@ -380,6 +497,23 @@ static inline ImagePixel _sampleLanczosY_float32(float x, float y, float z, floa
     return sum / totalWeight;
 }
 
+template<long numComponents>
+static inline ImagePixel _sampleLanczosY_uint16(float x, float y, float z, float a, long width, long height, long depth, char* fn_nonnull contents, bool renormalize) {
+    long left = floor(y - a + 1);
+    long right = floor(y + a);
+    auto sum = ImagePixel();
+    float totalWeight = 0.0;
+    for (auto i = left; i <= right; ++i) {
+        auto w = _lanczos_float32(y - i, a);
+        sum += _getPixel_uint16<numComponents>(x, i, z, width, height, depth, contents) * w;
+        totalWeight += w;
+    }
+    if (renormalize) {
+        return (sum / totalWeight).normalized();
+    }
+    return sum / totalWeight;
+}
+
 
 // MARK: - Lanczos Z
 
@@ -440,10 +574,165 @@ struct PixelInfo {
 };
 
 
+// MARK: - Decode window
+
+/// Part of a decoded image that is extracted into an ``ImageContainer`` according to ``ImageLoadOptions``.
+struct DecodeWindow {
+    long x;
+    long y;
+    long width;
+    long height;
+    long factor;
+    
+    long outputWidth;
+    long outputHeight;
+    
+    DecodeWindow(const ImageLoadOptions& options, long sourceWidth, long sourceHeight) {
+        factor = options.reductionFactor;
+        x = options.regionX;
+        y = options.regionY;
+        width = options.regionWidth > 0 ? options.regionWidth : sourceWidth - x;
+        height = options.regionHeight > 0 ? options.regionHeight : sourceHeight - y;
+        
+        outputWidth = (width + factor - 1) / factor;
+        outputHeight = (height + factor - 1) / factor;
+    }
+    
+    /// Checks if the region lies inside of the image.
+    bool validate(long sourceWidth, long sourceHeight, ImageToolsError* fn_nullable error fn_noescape) const {
+        if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > sourceWidth || y + height > sourceHeight) {
+            ImageToolsError::set(error, "Region is outside of the image");
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool coversWholeImage(long sourceWidth, long sourceHeight) const {
+        return factor == 1 && x == 0 && y == 0 && width == sourceWidth && height == sourceHeight;
+    }
+};
+
+
+/// Copies the decode window of a decoded image into the destination buffer.
+///
+/// Every `factor x factor` block of source pixels is averaged. Rows and columns outside of the window are never touched.
+///
+/// - Parameter numColorComponents: Number of leading components converted with `readColor` and `writeColor`, the remaining ones are converted with `read` and `write`.
+/// - Parameter read: Converts a source component to `float`.
+/// - Parameter write: Converts an averaged `float` value to a destination component.
+template <typename SourceType, typename DestinationType, typename ColorReader, typename ColorWriter, typename Reader, typename Writer>
+static void _extractDecodeWindow(const DecodeWindow& window, const SourceType* fn_nonnull source, long sourceWidth, long sourcePixelStride, DestinationType* fn_nonnull destination, long numComponents, long numColorComponents, ColorReader readColor, ColorWriter writeColor, Reader read, Writer write) {
+    auto factor = window.factor;
+    CONCURRENT_LOOP_START(0, window.outputHeight, outputY) {
+        auto top = window.y + outputY * factor;
+        auto bottom = std::min(top + factor, window.y + window.height);
+        auto dst = destination + outputY * window.outputWidth * numComponents;
+        
+        for (long outputX = 0; outputX < window.outputWidth; outputX++) {
+            auto left = window.x + outputX * factor;
+            auto right = std::min(left + factor, window.x + window.width);
+            
+            // Sum up the block
+            float sum[4] = { 0, 0, 0, 0 };
+            for (auto y = top; y < bottom; y++) {
+                auto src = source + (y * sourceWidth + left) * sourcePixelStride;
+                for (auto x = left; x < right; x++) {
+                    for (auto i = 0; i < numComponents; i++) {
+                        sum[i] += i < numColorComponents ? readColor(src[i]) : read(src[i]);
+                    }
+                    src += sourcePixelStride;
+                }
+            }
+            
+            // Write the average
+            auto count = static_cast<float>((bottom - top) * (right - left));
+            for (auto i = 0; i < numComponents; i++) {
+                dst[i] = i < numColorComponents ? writeColor(sum[i] / count) : write(sum[i] / count);
+            }
+            dst += numComponents;
+        }
+    } CONCURRENT_LOOP_END
+}
+
+
+/// Copies the decode window, converting all components the same way.
+template <typename SourceType, typename DestinationType, typename Reader, typename Writer>
+static void _extractDecodeWindow(const DecodeWindow& window, const SourceType* fn_nonnull source, long sourceWidth, long sourcePixelStride, DestinationType* fn_nonnull destination, long numComponents, Reader read, Writer write) {
+    _extractDecodeWindow(window, source, sourceWidth, sourcePixelStride, destination, numComponents, 0, read, write, read, write);
+}
+
+
+/// Extracts the decode window of an image whose components are already stored in the destination format.
+///
+/// Colour components of `uint8` and `uint16` images in the sRGB space are averaged in the linear space.
+static void _extractDecodeWindow(const DecodeWindow& window, const char* fn_nonnull source, long sourceWidth, char* fn_nonnull destination, ImagePixelFormat pixelFormat, bool sRGB) {
+    auto numComponents = pixelFormat.numComponents;
+    auto numColorComponents = pixelFormat.hasAlpha ? numComponents - 1 : numComponents;
+    switch (pixelFormat.componentType) {
+        case PixelComponentType::uint8:
+            if (sRGB) {
+                _extractDecodeWindow(window, reinterpret_cast<const uint8_t*>(source), sourceWidth, numComponents,
+                                     reinterpret_cast<uint8_t*>(destination), numComponents, numColorComponents,
+                                     [](uint8_t value) { return uint8Table[value].fp32Linear; },
+                                     [](float value) { return _fromFloat<uint8_t>(fastLinearToSRGB(value)); },
+                                     [](uint8_t value) { return static_cast<float>(value); },
+                                     [](float value) { return static_cast<uint8_t>(value + 0.5f); });
+                break;
+            }
+            _extractDecodeWindow(window, reinterpret_cast<const uint8_t*>(source), sourceWidth, numComponents,
+                                 reinterpret_cast<uint8_t*>(destination), numComponents,
+                                 [](uint8_t value) { return static_cast<float>(value); },
+                                 [](float value) { return static_cast<uint8_t>(value + 0.5f); });
+            break;
+            
+        case PixelComponentType::uint16:
+            if (sRGB) {
+                _extractDecodeWindow(window, reinterpret_cast<const uint16_t*>(source), sourceWidth, numComponents,
+                                     reinterpret_cast<uint16_t*>(destination), numComponents, numColorComponents,
+                                     [](uint16_t value) { return fastSRGBToLinear(_toFloat(value)); },
+                                     [](float value) { return _fromFloat<uint16_t>(fastLinearToSRGB(value)); },
+                                     [](uint16_t value) { return static_cast<float>(value); },
+                                     [](float value) { return static_cast<uint16_t>(value + 0.5f); });
+                break;
+            }
+            _extractDecodeWindow(window, reinterpret_cast<const uint16_t*>(source), sourceWidth, numComponents,
+                                 reinterpret_cast<uint16_t*>(destination), numComponents,
+                                 [](uint16_t value) { return static_cast<float>(value); },
+                                 [](float value) { return static_cast<uint16_t>(value + 0.5f); });
+            break;
+            
+        case PixelComponentType::uint32:
+            // Normalize values, float can't hold every 32-bit integer
+            _extractDecodeWindow(window, reinterpret_cast<const uint32_t*>(source), sourceWidth, numComponents,
+                                 reinterpret_cast<uint32_t*>(destination), numComponents,
+                                 [](uint32_t value) { return _toFloat(value); },
+                                 [](float value) { return _fromFloat<uint32_t>(value); });
+            break;
+            
+        case PixelComponentType::float16:
+            _extractDecodeWindow(window, reinterpret_cast<const _Float16*>(source), sourceWidth, numComponents,
+                                 reinterpret_cast<_Float16*>(destination), numComponents,
+                                 [](_Float16 value) { return static_cast<float>(value); },
+                                 [](float value) { return static_cast<_Float16>(value); });
+            break;
+            
+        case PixelComponentType::float32:
+            _extractDecodeWindow(window, reinterpret_cast<const float*>(source), sourceWidth, numComponents,
+                                 reinterpret_cast<float*>(destination), numComponents,
+                                 [](float value) { return value; },
+                                 [](float value) { return value; });
+            break;
+    }
+}
+
+
 long getPixelComponentTypeSize(PixelComponentType type) {
     long sizes[] = {
         1,
         2,
+        4,
+        2,
         4
     };
     
@@ -485,6 +774,25 @@ bool ImagePixelFormat::operator == (const ImagePixelFormat& other) const {
 }
 
 
+// MARK: - ImageLoadOptions
+
+ImageLoadOptions::ImageLoadOptions():
+ImageLoadOptions(0, 0, 0, 0, 1) { }
+
+
+ImageLoadOptions::ImageLoadOptions(long regionX, long regionY, long regionWidth, long regionHeight, long reductionFactor):
+regionX(regionX),
+regionY(regionY),
+regionWidth(regionWidth),
+regionHeight(regionHeight),
+reductionFactor(reductionFactor) { }
+
+
+ImageLoadOptions ImageLoadOptions::reduced(long reductionFactor) {
+    return ImageLoadOptions(0, 0, 0, 0, reductionFactor);
+}
+
+
 // MARK: - ImageContainerCollection
 
 ImageContainerCollection::ImageContainerCollection():
@@ -528,6 +836,31 @@ ImageContainer* fn_nonnull ImageContainerCollection::get(long index) const SWIFT
 
 // MARK: - ImageContainer
 
+/// Encoded image waiting to be decoded.
+struct ImageContainer::_LazySource {
+    bool usePath;
+    std::string path;
+    std::vector<char> buffer;
+    LCMSColorProfile* fn_nullable assumedColorProfile;
+    bool assumeSRGB;
+    
+    /// Reason why decoding failed. The code is `unknown` until then.
+    ImageToolsError decodeError;
+    
+    _LazySource(bool usePath, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB):
+    usePath(usePath),
+    path(),
+    buffer(),
+    assumedColorProfile(LCMSColorProfileRetain(assumedColorProfile)),
+    assumeSRGB(assumeSRGB),
+    decodeError() { }
+    
+    ~_LazySource() {
+        LCMSColorProfileRelease(assumedColorProfile);
+    }
+};
+
+
 ImageContainer::ImageContainer(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, char* fn_nonnull contents, long width, long height, long depth):
 _referenceCounter(1),
 _pixelFormat(pixelFormat),
@@ -537,127 +870,539 @@ _hdr(hdr),
 _contents(contents),
 _width(width),
 _height(height),
-_depth(depth) {
+_depth(depth),
+_bytesPerRow(width * pixelFormat.getSize()),
+_bytesPerSlice(width * height * pixelFormat.getSize()),
+_contentsRelease(nullptr),
+_contentsReleaseUserInfo(nullptr),
+_lazySource(nullptr),
+_decoded(true),
+_decodeMutex() {
+    //
+}
+
+
+ImageContainer::ImageContainer(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, _LazySource* fn_nonnull lazySource, long width, long height):
+_referenceCounter(1),
+_pixelFormat(pixelFormat),
+_colorProfile(colorProfile),
+_sRGB(sRGB),
+_hdr(hdr),
+_contents(nullptr),
+_width(width),
+_height(height),
+_depth(1),
+_bytesPerRow(width * pixelFormat.getSize()),
+_bytesPerSlice(width * height * pixelFormat.getSize()),
+_contentsRelease(nullptr),
+_contentsReleaseUserInfo(nullptr),
+_lazySource(lazySource),
+_decoded(false),
+_decodeMutex() {
     //
 }
 
 
 ImageContainer::~ImageContainer() {
     if (_contents) {
-        delete [] _contents;
+        _releaseContents({ _contents, _contentsRelease, _contentsReleaseUserInfo });
     }
     
+    delete _lazySource;
+    
     LCMSColorProfileRelease(_colorProfile);
     
     //printf("Byeee\n");
 }
 
 
-ImageContainer* fn_nonnull ImageContainer::create(const char* fn_nonnull contents, long width, long height, ImagePixelFormat pixelFormat) SWIFT_RETURNS_RETAINED {
-    auto size = width * height * pixelFormat.getSize();
-    auto buffer = new char[size];
-    std::memcpy(buffer, contents, size);
+// MARK: - Contents storage
+
+/// Contents stored in a memory-mapped file.
+struct FileStorage {
+    int fileDescriptor;
+    void* fn_nonnull address;
+    size_t size;
     
-    return new ImageContainer(pixelFormat,
-                              nullptr, false, false,
-                              buffer, width, height, 1);
-}
+    /// Directory for temporary files of derived contents.
+    std::string directory;
+};
 
 
-ImageContainer* fn_nonnull ImageContainer::create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth) {
-    width = std::max(1l, width);
-    height = std::max(1l, height);
-    depth = std::max(1l, depth);
-    auto contents = new char [width * height * depth * pixelFormat.getSize()];
-    return new ImageContainer(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, contents, width, height, depth);
+static void _releaseFileStorage(void* fn_nullable userInfo, char* fn_nonnull contents) {
+    auto storage = reinterpret_cast<FileStorage*>(userInfo);
+    munmap(storage->address, storage->size);
+    close(storage->fileDescriptor);
+    delete storage;
 }
 
 
-ImageContainer* fn_nonnull ImageContainer::createRGBA8Unorm(long width, long height) {
-    auto pixelFormat = ImagePixelFormat::rgba8Unorm;
-    auto contentsSize = width * height * 4;
-    auto contents = reinterpret_cast<char*>(std::malloc(contentsSize));
-    std::memset(contents, 0xFF, contentsSize);
+static std::string _getTemporaryDirectory() {
+    auto directory = getenv("TMPDIR");
+    if (directory == nullptr || directory[0] == 0) {
+        return "/tmp";
+    }
     
-    return new ImageContainer(pixelFormat, nullptr, true, false, contents, width, height, 1);
+    return directory;
 }
 
 
-static const char* fn_nonnull _getName(const char* fn_nonnull path) {
-    auto lastOccurance = -1;
-    auto index = 0;
-    auto size = strnlen(path, 10000);
-    while (index + 1 < size) {
-        if (path[index] == '/') {
-            lastOccurance = index;
-        }
-        
-        index += 1;
+static bool _mapFileStorage(FileStorage* fn_nonnull storage, size_t size) {
+    if (ftruncate(storage->fileDescriptor, static_cast<off_t>(size)) != 0) {
+        return false;
     }
     
-    return path + lastOccurance + 1;
+    // Shared mapping lets the system write pages back to the file instead of swap
+    auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, storage->fileDescriptor, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    
+    // Processing functions go through contents row by row
+    madvise(address, size, MADV_SEQUENTIAL);
+    
+    storage->address = address;
+    storage->size = size;
+    return true;
 }
 
 
-ImageContainer* fn_nullable ImageContainer::_tryLoadTGA(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED {
-    auto error = TGAError();
-    
-    auto tgaSource = info.usePath ? TGASource(info.path) : TGASource(info.buffer, info.bufferSize);
-    
-    auto isTGA = TGAImage::isTGA(tgaSource, &error);
-    if (isTGA == false) {
-        // TODO: Describe error
-        return nullptr;
+/// Changes size of the mapped file. The old mapping is released only after the new one succeeds, so contents stay accessible on failure.
+static bool _remapFileStorage(FileStorage* fn_nonnull storage, size_t size) {
+    // Grow the file before mapping, shrink it after unmapping
+    auto grow = size > storage->size;
+    if (grow && ftruncate(storage->fileDescriptor, static_cast<off_t>(size)) != 0) {
+        return false;
     }
     
-    auto tga = TGAImage::load(tgaSource, &error);
-    if (tga == nullptr) {
-        // TODO: Describe error
-        return nullptr;
+    auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, storage->fileDescriptor, 0);
+    if (address == MAP_FAILED) {
+        if (grow) {
+            ftruncate(storage->fileDescriptor, static_cast<off_t>(storage->size));
+        }
+        return false;
     }
+    madvise(address, size, MADV_SEQUENTIAL);
     
-    auto numComponents = tga->getNumComponents();
-    auto pixelFormat = ImagePixelFormat(PixelComponentType::uint8, numComponents);
-    // Assume sRGB colour space
-    auto sRGB = true;
-    auto hdr = false;
-    auto contentsSize = tga->getSize();
-    auto contents = reinterpret_cast<char*>(std::malloc(contentsSize));
-    std::memcpy(contents, tga->getContents(), contentsSize);
-    auto width = tga->getWidth();
-    auto height = tga->getHeight();
-    TGAImageRelease(tga);
+    munmap(storage->address, storage->size);
+    if (grow == false) {
+        // A file that could not be shrunk only keeps unused bytes at the end
+        ftruncate(storage->fileDescriptor, static_cast<off_t>(size));
+    }
     
-    // Extract TGA image contents
-    return new ImageContainer(pixelFormat, nullptr, sRGB, hdr, contents, width, height, 1);
+    storage->address = address;
+    storage->size = size;
+    return true;
 }
 
 
-ImageContainer* fn_nullable ImageContainer::_tryLoadJPEG(const _LoadInfo& info fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB) SWIFT_RETURNS_RETAINED {
-    auto isJPEG = info.usePath ? checkIfJPEG(info.path) : checkIfJPEG(info.buffer, info.bufferSize);
-    if (isJPEG == false) {
+/// Creates a file storage. If path is `nullptr`, an unnamed temporary file is created in the directory.
+static FileStorage* fn_nullable _createFileStorage(const char* fn_nullable path, const std::string& directory, long size, ImageToolsError* fn_nullable error) {
+    int fileDescriptor = -1;
+    if (path) {
+        fileDescriptor = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    else {
+        auto temporaryPath = directory + "/ImageTools-XXXXXX";
+        fileDescriptor = mkstemp(temporaryPath.data());
+        if (fileDescriptor >= 0) {
+            // The file is deleted as soon as the descriptor is closed
+            unlink(temporaryPath.c_str());
+        }
+    }
+    if (fileDescriptor < 0) {
+        ImageToolsError::set(error, "Could not create file for image contents");
         return nullptr;
     }
     
-    auto jpeg = info.usePath ? JPEGImage::load(info.path) : JPEGImage::load(info.buffer, info.bufferSize);
-    if (jpeg == nullptr) {
+    auto storage = new FileStorage {
+        .fileDescriptor = fileDescriptor,
+        .address = nullptr,
+        .size = 0,
+        .directory = directory
+    };
+    if (_mapFileStorage(storage, static_cast<size_t>(size)) == false) {
+        close(fileDescriptor);
+        delete storage;
+        ImageToolsError::set(error, "Could not map file for image contents");
         return nullptr;
     }
     
-    // Extract jpeg image contents
-    auto width = jpeg->getWidth();
-    auto height = jpeg->getHeight();
-    auto componentType = PixelComponentType::uint8;
-    if (jpeg->getNumComponentBytes() == 2) {
-        componentType = PixelComponentType::float16;
+    return storage;
+}
+
+
+/// Directory for temporary files next to the file.
+static std::string _getDirectory(const char* fn_nonnull path) {
+    auto string = std::string(path);
+    auto separator = string.find_last_of('/');
+    if (separator == std::string::npos) {
+        return ".";
     }
-    else if (jpeg->getNumComponentBytes() == 4) {
-        componentType = PixelComponentType::float32;
+    if (separator == 0) {
+        return "/";
     }
-    auto pixelFormat = ImagePixelFormat(componentType, jpeg->getNumComponents());
+    
+    return string.substr(0, separator);
+}
+
+
+ImageContainer::_Contents ImageContainer::_allocateContents(long size) {
+    if (_contentsRelease == _releaseFileStorage) {
+        auto directory = reinterpret_cast<FileStorage*>(_contentsReleaseUserInfo)->directory;
+        if (auto storage = _createFileStorage(nullptr, directory, size, nullptr)) {
+            return { reinterpret_cast<char*>(storage->address), _releaseFileStorage, storage };
+        }
+        
+        // Still try to process the image in memory
+    }
+    
+    return { ImageAllocator::allocate(size), nullptr, nullptr };
+}
+
+
+void ImageContainer::_releaseContents(const _Contents& contents) {
+    if (contents.release) {
+        contents.release(contents.releaseUserInfo, contents.contents);
+    }
+    else {
+        ImageAllocator::deallocate(contents.contents);
+    }
+}
+
+
+void ImageContainer::_replaceContents(const _Contents& contents) {
+    _releaseContents({ _contents, _contentsRelease, _contentsReleaseUserInfo });
+    _contents = contents.contents;
+    _contentsRelease = contents.release;
+    _contentsReleaseUserInfo = contents.releaseUserInfo;
+}
+
+
+void ImageContainer::_resizeContents(long oldSize, long newSize) {
+    if (oldSize == newSize) {
+        return;
+    }
+    
+    // Resize the file in place, its contents are preserved
+    if (_contentsRelease == _releaseFileStorage) {
+        auto storage = reinterpret_cast<FileStorage*>(_contentsReleaseUserInfo);
+        if (_remapFileStorage(storage, static_cast<size_t>(newSize))) {
+            _contents = reinterpret_cast<char*>(storage->address);
+            return;
+        }
+        
+        // Old contents are still mapped, copy them to memory
+        auto contents = _Contents { ImageAllocator::allocate(newSize), nullptr, nullptr };
+        std::memcpy(contents.contents, _contents, std::min(oldSize, newSize));
+        _replaceContents(contents);
+        return;
+    }
+    
+    auto contents = _allocateContents(newSize);
+    std::memcpy(contents.contents, _contents, std::min(oldSize, newSize));
+    _replaceContents(contents);
+}
+
+
+void ImageContainer::_setBytesPerRow(long bytesPerRow, long bytesPerSlice) {
+    _bytesPerRow = std::max(bytesPerRow, _width * _pixelFormat.getSize());
+    _bytesPerSlice = std::max(bytesPerSlice, _bytesPerRow * _height);
+}
+
+
+void ImageContainer::_pack() {
+    // Slices can be padded even if rows aren't
+    if (getIsPacked()) {
+        return;
+    }
+    
+    auto rowSize = _width * _pixelFormat.getSize();
+    
+    // Rows only move towards the beginning of contents, so they can be moved in place
+    auto oldSize = getContentsSize();
+    for (auto z = 0; z < _depth; z++) {
+        for (auto y = 0; y < _height; y++) {
+            std::memmove(_contents + (z * _height + y) * rowSize, _getRow(y, z), rowSize);
+        }
+    }
+    
+    _setBytesPerRow(0);
+    _resizeContents(oldSize, getContentsSize());
+}
+
+
+void ImageContainer::_copyContents(ImageContainer* fn_nonnull destination) {
+    if (getIsPacked() && destination->getIsPacked()) {
+        std::memcpy(destination->_contents, _contents, getContentsSize());
+        return;
+    }
+    
+    auto rowSize = _width * _pixelFormat.getSize();
+    for (auto z = 0; z < _depth; z++) {
+        for (auto y = 0; y < _height; y++) {
+            std::memcpy(destination->_getRow(y, z), _getRow(y, z), rowSize);
+        }
+    }
+}
+
+
+/// Number of pixels in runs of tightly packed contents. Large enough to amortize scheduling, small enough to balance threads.
+static constexpr long _pixelRunLength = 16 * 1024;
+
+
+long ImageContainer::_getNumPixelRuns() {
+    if (getIsPacked()) {
+        return (_width * _height * _depth + _pixelRunLength - 1) / _pixelRunLength;
+    }
+    
+    return _height * _depth;
+}
+
+
+char* fn_nonnull ImageContainer::_getPixelRun(long index, long* fn_nonnull numPixels) {
+    if (getIsPacked()) {
+        *numPixels = std::min(_pixelRunLength, _width * _height * _depth - index * _pixelRunLength);
+        return _contents + index * _pixelRunLength * _pixelFormat.getSize();
+    }
+    
+    *numPixels = _width;
+    return _getRow(index % _height, index / _height);
+}
+
+
+long ImageContainer::getAlignedBytesPerRow(long width, ImagePixelFormat pixelFormat) {
+    constexpr long alignment = IMAGE_CONTAINER_CONTENTS_ALIGNMENT;
+    auto rowSize = std::max(1l, width) * pixelFormat.getSize();
+    return (rowSize + alignment - 1) / alignment * alignment;
+}
+
+
+bool ImageContainer::_checkIsUniquelyReferenced() {
+    if (_referenceCounter.load(std::memory_order_acquire) != 1) {
+        return false;
+    }
+    
+    return _contentsRelease == nullptr || _contentsRelease == _releaseFileStorage;
+}
+
+
+bool ImageContainer::getIsFileBacked() {
+    return _contentsRelease == _releaseFileStorage;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::createFileBacked(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    depth = std::max(1l, depth);
+    
+    auto directory = path ? _getDirectory(path) : _getTemporaryDirectory();
+    auto storage = _createFileStorage(path, directory, width * height * depth * pixelFormat.getSize(), error);
+    if (storage == nullptr) {
+        return nullptr;
+    }
+    
+    auto image = new ImageContainer(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, reinterpret_cast<char*>(storage->address), width, height, depth);
+    image->_contentsRelease = _releaseFileStorage;
+    image->_contentsReleaseUserInfo = storage;
+    return image;
+}
+
+
+// MARK: - Creating
+
+ImageContainer* fn_nonnull ImageContainer::create(const char* fn_nonnull contents, long width, long height, ImagePixelFormat pixelFormat) SWIFT_RETURNS_RETAINED {
+    auto size = width * height * pixelFormat.getSize();
+    auto buffer = ImageAllocator::allocate(size);
+    std::memcpy(buffer, contents, size);
+    
+    return new ImageContainer(pixelFormat,
+                              nullptr, false, false,
+                              buffer, width, height, 1);
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    depth = std::max(1l, depth);
+    auto contents = ImageAllocator::allocate(width * height * depth * pixelFormat.getSize());
+    return new ImageContainer(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, contents, width, height, depth);
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, long bytesPerRow) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    depth = std::max(1l, depth);
+    bytesPerRow = std::max(bytesPerRow, width * pixelFormat.getSize());
+    auto contents = ImageAllocator::allocate(bytesPerRow * height * depth);
+    auto image = new ImageContainer(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, contents, width, height, depth);
+    image->_setBytesPerRow(bytesPerRow);
+    return image;
+}
+
+
+static void _keepBorrowedContents(void* fn_nullable userInfo, char* fn_nonnull contents) {
+    // Contents are owned by the caller
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::createBorrowing(char* fn_nonnull contents, ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, long bytesPerRow, long bytesPerSlice, void* fn_nullable userInfo, ImageContentsReleaseCallback fn_nullable release) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    depth = std::max(1l, depth);
+    auto image = new ImageContainer(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, contents, width, height, depth);
+    image->_contentsRelease = release ? release : _keepBorrowedContents;
+    image->_contentsReleaseUserInfo = userInfo;
+    image->_setBytesPerRow(bytesPerRow, bytesPerSlice);
+    return image;
+}
+
+
+static void _releaseViewParent(void* fn_nullable userInfo, char* fn_nonnull contents) {
+    ImageContainerRelease(reinterpret_cast<ImageContainer*>(userInfo));
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::createView(long x, long y, long z, long width, long height, long depth) {
+    _ensureDecoded();
+    
+    x = std::clamp(x, 0l, _width - 1);
+    y = std::clamp(y, 0l, _height - 1);
+    z = std::clamp(z, 0l, _depth - 1);
+    width = std::clamp(width, 1l, _width - x);
+    height = std::clamp(height, 1l, _height - y);
+    depth = std::clamp(depth, 1l, _depth - z);
+    
+    auto contents = _getRow(y, z) + x * _pixelFormat.getSize();
+    auto view = new ImageContainer(_pixelFormat, LCMSColorProfileRetain(_colorProfile), _sRGB, _hdr, contents, width, height, depth);
+    view->_contentsRelease = _releaseViewParent;
+    view->_contentsReleaseUserInfo = ImageContainerRetain(this);
+    // Flat views with full rows are tightly packed
+    view->_setBytesPerRow(_bytesPerRow, depth > 1 ? _bytesPerSlice : 0);
+    return view;
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::createSliceView(long z) {
+    return createView(0, 0, z, _width, _height, 1);
+}
+
+
+bool ImageContainer::getIsView() {
+    return _contentsRelease == _releaseViewParent;
+}
+
+
+ImageContainer* fn_nonnull ImageContainer::createRGBA8Unorm(long width, long height) {
+    auto pixelFormat = ImagePixelFormat::rgba8Unorm;
+    auto contentsSize = width * height * 4;
+    auto contents = ImageAllocator::allocate(contentsSize);
+    std::memset(contents, 0xFF, contentsSize);
+    
+    return new ImageContainer(pixelFormat, nullptr, true, false, contents, width, height, 1);
+}
+
+
+static const char* fn_nonnull _getName(const char* fn_nonnull path) {
+    auto lastOccurance = -1;
+    auto index = 0;
+    auto size = strnlen(path, 10000);
+    while (index + 1 < size) {
+        if (path[index] == '/') {
+            lastOccurance = index;
+        }
+        
+        index += 1;
+    }
+    
+    return path + lastOccurance + 1;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::_tryLoadTGA(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto tgaError = TGAError();
+    
+    auto tgaSource = info.usePath ? TGASource(info.path) : TGASource(info.buffer, info.bufferSize);
+    
+    auto isTGA = TGAImage::isTGA(tgaSource, &tgaError);
+    if (isTGA == false) {
+        // TODO: Describe error
+        return nullptr;
+    }
+    
+    auto tga = TGAImage::load(tgaSource, &tgaError);
+    if (tga == nullptr) {
+        // TODO: Describe error
+        return nullptr;
+    }
+    
+    auto numComponents = tga->getNumComponents();
+    auto pixelFormat = ImagePixelFormat(PixelComponentType::uint8, numComponents);
+    // Assume sRGB colour space
+    auto sRGB = true;
+    auto hdr = false;
+    auto window = DecodeWindow(info.options, tga->getWidth(), tga->getHeight());
+    if (window.validate(tga->getWidth(), tga->getHeight(), error) == false) {
+        TGAImageRelease(tga);
+        return nullptr;
+    }
+    auto width = window.outputWidth;
+    auto height = window.outputHeight;
+    auto contentsSize = width * height * pixelFormat.getSize();
+    auto contents = ImageAllocator::allocate(contentsSize);
+    if (window.coversWholeImage(tga->getWidth(), tga->getHeight())) {
+        std::memcpy(contents, tga->getContents(), contentsSize);
+    }
+    else {
+        // Skip rows and columns outside of the requested region
+        _extractDecodeWindow(window, reinterpret_cast<const char*>(tga->getContents()), tga->getWidth(), contents, pixelFormat, sRGB);
+    }
+    TGAImageRelease(tga);
+    
+    // Extract TGA image contents
+    return new ImageContainer(pixelFormat, nullptr, sRGB, hdr, contents, width, height, 1);
+}
+
+
+ImageContainer* fn_nullable ImageContainer::_tryLoadJPEG(const _LoadInfo& info fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto isJPEG = info.usePath ? checkIfJPEG(info.path) : checkIfJPEG(info.buffer, info.bufferSize);
+    if (isJPEG == false) {
+        return nullptr;
+    }
+    
+    auto jpeg = info.usePath ? JPEGImage::load(info.path) : JPEGImage::load(info.buffer, info.bufferSize);
+    if (jpeg == nullptr) {
+        return nullptr;
+    }
+    
+    // Extract jpeg image contents
+    auto window = DecodeWindow(info.options, jpeg->getWidth(), jpeg->getHeight());
+    if (window.validate(jpeg->getWidth(), jpeg->getHeight(), error) == false) {
+        JPEGImageRelease(jpeg);
+        return nullptr;
+    }
+    auto width = window.outputWidth;
+    auto height = window.outputHeight;
+    auto componentType = PixelComponentType::uint8;
+    if (jpeg->getNumComponentBytes() == 2) {
+        componentType = PixelComponentType::float16;
+    }
+    else if (jpeg->getNumComponentBytes() == 4) {
+        componentType = PixelComponentType::float32;
+    }
+    auto pixelFormat = ImagePixelFormat(componentType, jpeg->getNumComponents());
     auto contentsSize = width * height * pixelFormat.getSize();
-    auto contents = new char [contentsSize];
-    std::memcpy(contents, jpeg->getContents(), contentsSize);
+    auto contents = ImageAllocator::allocate(contentsSize);
+    if (window.coversWholeImage(jpeg->getWidth(), jpeg->getHeight())) {
+        std::memcpy(contents, jpeg->getContents(), contentsSize);
+    }
+    else {
+        // JPEGImage always decodes at full size, so crop and reduce while copying
+        _extractDecodeWindow(window, reinterpret_cast<const char*>(jpeg->getContents()), jpeg->getWidth(), contents, pixelFormat, assumeSRGB);
+    }
     auto image = new ImageContainer(pixelFormat, LCMSColorProfileRetain(assumedColorProfile), assumeSRGB, false, contents, width, height, 1);
     
     // Clean up
@@ -667,7 +1412,7 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadJPEG(const _LoadInfo& info f
 }
 
 
-ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED {
+ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
     auto isPng = info.usePath ? PNGImage::checkIfPNG(info.path) : PNGImage::checkIfPNG(info.buffer, info.bufferSize);
     if (isPng == false) {
         return nullptr;
@@ -678,6 +1423,11 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn
         return nullptr;
     }
     
+    auto window = DecodeWindow(info.options, png->getWidth(), png->getHeight());
+    if (window.validate(png->getWidth(), png->getHeight(), error) == false) {
+        PNGImageRelease(png);
+        return nullptr;
+    }
     
     auto sRGB = png->getIsSRGB();
     
@@ -698,7 +1448,7 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn
             break;
             
         case 2:
-            pixelComponentType = PixelComponentType::float16;
+            pixelComponentType = PixelComponentType::uint16;
             break;
             
         default:
@@ -713,7 +1463,7 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn
     LCMSColorProfile* fn_nullable colorProfile = nullptr;
     long iccProfileDataLength = png->getICCPDataLength();
     if (iccProfileDataLength) {
-        colorProfile = LCMSColorProfile::create(png->getICCPData(), iccProfileDataLength);
+        colorProfile = createSharedColorProfile(png->getICCPData(), iccProfileDataLength);
         
         // Check the sRGB setting
         auto colorProfileIsSRGB = colorProfile->checkIsSRGB();
@@ -736,45 +1486,34 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn
     }
     
     
-    // Copy and convert image data
-    auto width = png->getWidth();
-    auto height = png->getHeight();
+    // Copy and convert image data, skipping rows and columns outside of the requested region
+    auto width = window.outputWidth;
+    auto height = window.outputHeight;
     auto depth = 1;
-    auto contents = reinterpret_cast<char*>(std::malloc(width * height * numComponents * componentSize));
-    auto uint8Contents = reinterpret_cast<uint8_t*>(contents);
-    auto uint16Contents = reinterpret_cast<_Float16*>(contents);
-    std::memset(contents, 0xff, width * height * numComponents * componentSize);
+    auto contents = ImageAllocator::allocate(width * height * numComponents * componentSize);
     
     auto pngContents = png->getContents();
-    auto pngUint8Contents = reinterpret_cast<const uint8_t*>(pngContents);
-    auto pngUint16Contents = reinterpret_cast<const PixelInfo<uint16_t, float>*>(pngContents);
-    
-    for (auto y = 0; y < height; y++) {
-        for (auto x = 0; x < width; x++) {
-            auto index = (y * width + x) * numComponents;
-            switch (componentSize) {
-                case 1: {
-                    auto color = uint8Contents + index;
-                    auto pngColor = pngUint8Contents + index;
-                    for (auto i = 0; i < numComponents; i++) {
-                        color[i] = pngColor[i];
-                    }
-                    break;
-                }
-                    
-                case 2: {
-                    auto color = uint16Contents + index;
-                    auto pngColor = pngUint16Contents + index;
-                    for (auto i = 0; i < numComponents; i++) {
-                        color[i] = pngColor[i].convert(false);
-                    }
-                    break;
-                }
-                    
-                default:
-                    break;
-            }
+    switch (componentSize) {
+        case 1:
+            _extractDecodeWindow(window, reinterpret_cast<const char*>(pngContents), png->getWidth(), contents, pixelFormat, sRGB);
+            break;
+            
+        case 2:
+        {
+            // Average colour components in the linear space
+            auto numColorComponents = sRGB ? (pixelFormat.hasAlpha ? numComponents - 1 : numComponents) : 0;
+            auto read = [](const PixelInfo<uint16_t, float>& value) { return value.convert(false); };
+            auto write = [](float value) { return _fromFloat<uint16_t>(value); };
+            _extractDecodeWindow(window, reinterpret_cast<const PixelInfo<uint16_t, float>*>(pngContents), png->getWidth(), numComponents,
+                                 reinterpret_cast<uint16_t*>(contents), numComponents, numColorComponents,
+                                 [](const PixelInfo<uint16_t, float>& value) { return fastSRGBToLinear(value.convert(false)); },
+                                 [](float value) { return _fromFloat<uint16_t>(fastLinearToSRGB(value)); },
+                                 read, write);
+            break;
         }
+            
+        default:
+            break;
     }
     
     // Clean up
@@ -784,7 +1523,7 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadPNG(const _LoadInfo& info fn
 }
 
 
-ImageContainer* fn_nullable ImageContainer::_tryLoadOpenEXR(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED {
+ImageContainer* fn_nullable ImageContainer::_tryLoadOpenEXR(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
     auto path = info.path;
     auto buffer = reinterpret_cast<const unsigned char*>(info.buffer);
     auto bufferSize = info.bufferSize;
@@ -831,26 +1570,27 @@ ImageContainer* fn_nullable ImageContainer::_tryLoadOpenEXR(const _LoadInfo& inf
         return nullptr;
     }
     
-    // Cast image data to float16
-    //auto imageContents = new _Float16[width * height * header.num_channels];
-    //auto contents = reinterpret_cast<char*>(imageContents);
-    auto contents = new char[width * height * header.num_channels * sizeof(_Float16)];
-    auto imageContents = reinterpret_cast<_Float16*>(contents);
-    for (auto y = 0; y < height; y++) {
-        for (auto x = 0; x < width; x++) {
-            for (auto i = 0; i < header.num_channels; i++) {
-                auto source = (y * width + x) * 4 + i;
-                auto destination = (y * width + x) * header.num_channels + i;
-                imageContents[destination] = exrContents[source];
-            }
-        }
+    // Cast image data within the requested region to float16
+    auto window = DecodeWindow(info.options, width, height);
+    if (window.validate(width, height, error) == false) {
+        std::free(exrContents);
+        FreeEXRHeader(&header);
+        return nullptr;
     }
+    auto numChannels = std::min(header.num_channels, 4);
+    auto contents = ImageAllocator::allocate(window.outputWidth * window.outputHeight * numChannels * sizeof(_Float16));
+    _extractDecodeWindow(window, exrContents, width, 4,
+                         reinterpret_cast<_Float16*>(contents), numChannels,
+                         [](float value) { return value; },
+                         [](float value) { return static_cast<_Float16>(value); });
+    width = static_cast<int>(window.outputWidth);
+    height = static_cast<int>(window.outputHeight);
     
     // Create image container
-    auto pixelFormat = ImagePixelFormat(PixelComponentType::float16, header.num_channels);
+    auto pixelFormat = ImagePixelFormat(PixelComponentType::float16, numChannels);
     
     // Assume Rec. 709 color profile
-    auto rec709 = LCMSColorProfile::createRec709();
+    auto rec709 = createSharedRec709ColorProfile();
     
     // Create container
     auto container = new ImageContainer(pixelFormat, rec709, false, true, contents, width, height, depth);
@@ -867,29 +1607,74 @@ ImageContainer* fn_nullable ImageContainer::_load(const _LoadInfo& info fn_noesc
     // Get image name
     auto imageName = info.usePath ? _getName(info.path) : "-mem-";
     
-    // Try to load as a TGA image
-    { if (auto tga = _tryLoadTGA(info)) {
-        printf("Image \"%s\" is loaded using FastTGA - %ld bytes per component\n", imageName, tga->_pixelFormat.getComponentSize());
-        return tga;
-    } }
+    // Check options before decoding anything
+    auto& options = info.options;
+    if (options.reductionFactor != 1 && options.reductionFactor != 2 && options.reductionFactor != 4 && options.reductionFactor != 8) {
+        ImageToolsError::set(error, "Reduction factor has to be 1, 2, 4 or 8");
+        return nullptr;
+    }
+    if (options.regionX < 0 || options.regionY < 0 || options.regionWidth < 0 || options.regionHeight < 0) {
+        ImageToolsError::set(error, "Region is outside of the image");
+        return nullptr;
+    }
     
-    // Try to load as a JPEG image
-    { if (auto jpeg = _tryLoadJPEG(info, assumedColorProfile, assumeSRGB)) {
-        printf("Image \"%s\" is loaded using JPEGTurbo - %ld bytes per component\n", imageName, jpeg->_pixelFormat.getComponentSize());
-        return jpeg;
+    // Loaders set the error only if they recognized the format but could not load the image
+    auto loadError = ImageToolsError();
+    auto checkFailed = [&]() {
+        if (loadError._code == ImageToolsErrorCode::unknown) {
+            return false;
+        }
+        
+        if (error) {
+            *error = loadError;
+        }
+        return true;
+    };
+    
+    // Try to load as a native ImageTools image
+    { if (auto native = _tryLoadNative(info, &loadError)) {
+        printf("Image \"%s\" is loaded from the native format - %ld bytes per component\n", imageName, native->_pixelFormat.getComponentSize());
+        return native;
+    } }
+    if (checkFailed()) {
+        return nullptr;
+    }
+    
+    // Try to load as a TGA image
+    { if (auto tga = _tryLoadTGA(info, &loadError)) {
+        printf("Image \"%s\" is loaded using FastTGA - %ld bytes per component\n", imageName, tga->_pixelFormat.getComponentSize());
+        return tga;
     } }
+    if (checkFailed()) {
+        return nullptr;
+    }
+    
+    // Try to load as a JPEG image
+    { if (auto jpeg = _tryLoadJPEG(info, assumedColorProfile, assumeSRGB, &loadError)) {
+        printf("Image \"%s\" is loaded using JPEGTurbo - %ld bytes per component\n", imageName, jpeg->_pixelFormat.getComponentSize());
+        return jpeg;
+    } }
+    if (checkFailed()) {
+        return nullptr;
+    }
     
     // Try to load as a PNG image
-    { if (auto png = _tryLoadPNG(info)) {
+    { if (auto png = _tryLoadPNG(info, &loadError)) {
         printf("Image \"%s\" is loaded using LibPNG - %ld bytes per component\n", imageName, png->_pixelFormat.getComponentSize());
         return png;
     } }
+    if (checkFailed()) {
+        return nullptr;
+    }
     
     // Try to load as an OpenEXR image
-    { if (auto exr = _tryLoadOpenEXR(info)) {
+    { if (auto exr = _tryLoadOpenEXR(info, &loadError)) {
         printf("Image \"%s\" is loaded using tinyexr - %ld bytes per component\n", imageName, exr->_pixelFormat.getComponentSize());
         return exr;
     } }
+    if (checkFailed()) {
+        return nullptr;
+    }
     
     // Fallback to stb image
     
@@ -921,80 +1706,773 @@ ImageContainer* fn_nullable ImageContainer::_load(const _LoadInfo& info fn_noesc
         is16Bit = true;
     }
     
+    // 16-bit integer images are loaded as they are, everything else goes through float
+    auto isUInt16 = is16Bit && isHdr == false;
     int width = 0;
     int height = 0;
     int numComponents = 0;
-    float* components = nullptr;
-    if (info.usePath) {
+    void* components = nullptr;
+    if (isUInt16) {
+        components = info.usePath ? stbi_load_16(info.path, &width, &height, &numComponents, 0) : stbi_load_16_from_memory(stbiBuffer, stbiBufferSize, &width, &height, &numComponents, 0);
+    }
+    else if (info.usePath) {
         components = stbi_loadf(info.path, &width, &height, &numComponents, 0);
     }
-    else {
-        components = stbi_loadf_from_memory(stbiBuffer, stbiBufferSize, &width, &height, &numComponents, 0);
+    else {
+        components = stbi_loadf_from_memory(stbiBuffer, stbiBufferSize, &width, &height, &numComponents, 0);
+    }
+    if (components == nullptr) {
+        auto reason = stbi_failure_reason();
+        if (reason) {
+            ImageToolsError::set(error, reason);
+        }
+        else {
+            ImageToolsError::set(error, "Could not open image for some unknown reason");
+        }
+        return nullptr;
+    }
+    
+    auto componentType = isUInt16 ? PixelComponentType::uint16 : is16Bit ? PixelComponentType::float16 : PixelComponentType::uint8;
+    auto pixelFormat = ImagePixelFormat(componentType, numComponents);
+    
+    // Copy pixel information within the requested region
+    auto window = DecodeWindow(info.options, width, height);
+    if (window.validate(width, height, error) == false) {
+        stbi_image_free(components);
+        return nullptr;
+    }
+    auto contentsSize = window.outputWidth * window.outputHeight * pixelFormat.getSize();
+    auto contents = ImageAllocator::allocate(contentsSize);
+    auto read = [](float value) { return value; };
+    if (isUInt16) {
+        _extractDecodeWindow(window, reinterpret_cast<const char*>(components), width, contents, pixelFormat, sRGB);
+    }
+    else if (is16Bit) {
+        _extractDecodeWindow(window, reinterpret_cast<const float*>(components), width, numComponents,
+                             reinterpret_cast<_Float16*>(contents), numComponents,
+                             read, [](float value) { return static_cast<_Float16>(value); });
+    }
+    else {
+        _extractDecodeWindow(window, reinterpret_cast<const float*>(components), width, numComponents,
+                             reinterpret_cast<unsigned char*>(contents), numComponents,
+                             read, [](float value) { return static_cast<unsigned char>(255.0f * value); });
+    }
+    width = static_cast<int>(window.outputWidth);
+    height = static_cast<int>(window.outputHeight);
+    
+    
+    stbi_image_free(components);
+    
+    // Take the assumed colour profile if specified, since stb_image does not provide it
+    LCMSColorProfile* fn_nullable colorProfile = LCMSColorProfileRetain(assumedColorProfile);
+    
+    printf("Image \"%s\" is loaded using stb_image - %ld bytes per component\n", imageName, pixelFormat.getComponentSize());
+    return new ImageContainer(pixelFormat, colorProfile, sRGB, isHdr, contents, width, height, 1);
+}
+
+
+ImageContainer* fn_nullable ImageContainer::load(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto info = _LoadInfo {
+        .usePath = true,
+        .path = path
+    };
+    return _load(info, assumedColorProfile, assumeSRGB, error);
+}
+
+
+ImageContainer* fn_nullable ImageContainer::load(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto info = _LoadInfo {
+        .usePath = false,
+        .buffer = buffer,
+        .bufferSize = bufferSize
+    };
+    return _load(info, assumedColorProfile, assumeSRGB, error);
+}
+
+
+ImageContainer* fn_nullable ImageContainer::load(const char* fn_nonnull path fn_noescape, ImageLoadOptions options, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto info = _LoadInfo {
+        .usePath = true,
+        .path = path,
+        .options = options
+    };
+    return _load(info, assumedColorProfile, assumeSRGB, error);
+}
+
+
+ImageContainer* fn_nullable ImageContainer::load(const void* fn_nonnull buffer fn_noescape, long bufferSize, ImageLoadOptions options, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto info = _LoadInfo {
+        .usePath = false,
+        .buffer = buffer,
+        .bufferSize = bufferSize,
+        .options = options
+    };
+    return _load(info, assumedColorProfile, assumeSRGB, error);
+}
+
+
+// MARK: - Native format
+
+static constexpr char _nativeFileMagic[8] = { 'I', 'T', 'I', 'M', 'A', 'G', 'E', 0 };
+static constexpr uint32_t _nativeFileVersion = 1;
+static constexpr uint32_t _nativeFileByteOrderMark = 0x01020304;
+
+/// Contents are aligned to the largest page size of supported platforms, so a mapped file can be used without copying.
+static constexpr uint64_t _nativeFileContentsAlignment = 16384;
+
+
+/// Header of a native image file, followed by ICC data, padding and raw contents.
+struct NativeImageFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint32_t componentType;
+    uint32_t numComponents;
+    uint32_t hasAlpha;
+    uint32_t flags;
+    uint32_t profileOrigin;
+    uint32_t iccDataSize;
+    uint64_t width;
+    uint64_t height;
+    uint64_t depth;
+    uint64_t contentsOffset;
+    uint64_t contentsSize;
+};
+
+
+enum NativeImageFileFlags: uint32_t {
+    nativeImageFileSRGB = 1 << 0,
+    nativeImageFileHDR = 1 << 1,
+    nativeImageFileHasProfile = 1 << 2,
+    nativeImageFileLinearProfile = 1 << 3
+};
+
+
+/// Properties of a native image parsed from its header.
+struct NativeImageInfo {
+    ImagePixelFormat pixelFormat = ImagePixelFormat::rgba8Unorm;
+    LCMSColorProfile* fn_nullable colorProfile = nullptr;
+    bool sRGB = false;
+    bool hdr = false;
+    long width = 0;
+    long height = 0;
+    long depth = 0;
+    long contentsOffset = 0;
+};
+
+
+static bool _checkIfNativeImage(const void* fn_nonnull data, long size) {
+    return size >= static_cast<long>(sizeof(NativeImageFileHeader)) && std::memcmp(data, _nativeFileMagic, sizeof(_nativeFileMagic)) == 0;
+}
+
+
+static bool _checkIfNativeImage(const char* fn_nonnull path) {
+    char magic[sizeof(_nativeFileMagic)];
+    auto file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    auto numRead = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return numRead == sizeof(magic) && std::memcmp(magic, _nativeFileMagic, sizeof(magic)) == 0;
+}
+
+
+/// Parses a native image header. The returned colour profile is retained.
+static bool _parseNativeImage(const void* fn_nonnull data, long size, NativeImageInfo& info, ImageToolsError* fn_nullable error) {
+    NativeImageFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.version != _nativeFileVersion || header.byteOrderMark != _nativeFileByteOrderMark) {
+        ImageToolsError::set(error, "Unsupported native image version or byte order");
+        return false;
+    }
+    
+    if (header.componentType > static_cast<uint32_t>(PixelComponentType::uint32) ||
+        header.numComponents < 1 || header.numComponents > 4 ||
+        header.width == 0 || header.height == 0 || header.depth == 0) {
+        ImageToolsError::set(error, "Invalid native image header");
+        return false;
+    }
+    
+    auto pixelFormat = ImagePixelFormat(static_cast<PixelComponentType>(header.componentType), header.numComponents, header.hasAlpha != 0);
+    auto contentsSize = header.width * header.height * header.depth * pixelFormat.getSize();
+    if (contentsSize != header.contentsSize ||
+        header.contentsOffset < sizeof(header) + header.iccDataSize ||
+        header.contentsOffset + header.contentsSize > static_cast<uint64_t>(size)) {
+        ImageToolsError::set(error, "Native image file is truncated or corrupted");
+        return false;
+    }
+    
+    // Recreate colour profile
+    LCMSColorProfile* colorProfile = nullptr;
+    if (header.flags & nativeImageFileHasProfile) {
+        auto iccData = reinterpret_cast<const char*>(data) + sizeof(header);
+        auto description = ColorProfileDescription {
+            .origin = static_cast<ColorProfileOrigin>(header.profileOrigin),
+            .linear = (header.flags & nativeImageFileLinearProfile) != 0,
+            .iccData = std::vector<char>(iccData, iccData + header.iccDataSize)
+        };
+        colorProfile = createSharedColorProfile(description);
+        if (colorProfile == nullptr) {
+            ImageToolsError::set(error, "Could not create colour profile of the native image");
+            return false;
+        }
+    }
+    
+    info = NativeImageInfo {
+        .pixelFormat = pixelFormat,
+        .colorProfile = colorProfile,
+        .sRGB = (header.flags & nativeImageFileSRGB) != 0,
+        .hdr = (header.flags & nativeImageFileHDR) != 0,
+        .width = static_cast<long>(header.width),
+        .height = static_cast<long>(header.height),
+        .depth = static_cast<long>(header.depth),
+        .contentsOffset = static_cast<long>(header.contentsOffset)
+    };
+    return true;
+}
+
+
+struct NativeImageMapping {
+    void* fn_nonnull address;
+    size_t size;
+};
+
+
+bool ImageContainer::save(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    _ensureDecoded();
+    
+    auto header = NativeImageFileHeader {
+        .magic = {},
+        .version = _nativeFileVersion,
+        .byteOrderMark = _nativeFileByteOrderMark,
+        .componentType = static_cast<uint32_t>(_pixelFormat.componentType),
+        .numComponents = static_cast<uint32_t>(_pixelFormat.numComponents),
+        .hasAlpha = _pixelFormat.hasAlpha ? 1u : 0u,
+        .flags = 0,
+        .profileOrigin = 0,
+        .iccDataSize = 0,
+        .width = static_cast<uint64_t>(_width),
+        .height = static_cast<uint64_t>(_height),
+        .depth = static_cast<uint64_t>(_depth),
+        .contentsOffset = 0,
+        .contentsSize = static_cast<uint64_t>(_width * _height * _depth * _pixelFormat.getSize())
+    };
+    std::memcpy(header.magic, _nativeFileMagic, sizeof(_nativeFileMagic));
+    if (_sRGB) {
+        header.flags |= nativeImageFileSRGB;
+    }
+    if (_hdr) {
+        header.flags |= nativeImageFileHDR;
+    }
+    
+    auto description = ColorProfileDescription();
+    if (_colorProfile) {
+        if (describeSharedColorProfile(_colorProfile, description) == false) {
+            ImageToolsError::set(error, "Colour profile of the image can't be saved");
+            return false;
+        }
+        
+        header.flags |= nativeImageFileHasProfile;
+        if (description.linear) {
+            header.flags |= nativeImageFileLinearProfile;
+        }
+        header.profileOrigin = static_cast<uint32_t>(description.origin);
+        header.iccDataSize = static_cast<uint32_t>(description.iccData.size());
+    }
+    
+    auto headerEnd = sizeof(header) + header.iccDataSize;
+    header.contentsOffset = (headerEnd + _nativeFileContentsAlignment - 1) / _nativeFileContentsAlignment * _nativeFileContentsAlignment;
+    
+    auto file = fopen(path, "wb");
+    if (file == nullptr) {
+        ImageToolsError::set(error, "Could not create file");
+        return false;
+    }
+    
+    std::vector<char> padding(header.contentsOffset - headerEnd, 0);
+    auto success = fwrite(&header, sizeof(header), 1, file) == 1;
+    success = success && (description.iccData.empty() || fwrite(description.iccData.data(), description.iccData.size(), 1, file) == 1);
+    success = success && (padding.empty() || fwrite(padding.data(), padding.size(), 1, file) == 1);
+    if (getIsPacked()) {
+        success = success && fwrite(_contents, 1, header.contentsSize, file) == header.contentsSize;
+    }
+    else {
+        // The native format stores tightly packed rows
+        auto rowSize = static_cast<size_t>(_width * _pixelFormat.getSize());
+        for (auto z = 0; z < _depth && success; z++) {
+            for (auto y = 0; y < _height && success; y++) {
+                success = fwrite(_getRow(y, z), 1, rowSize, file) == rowSize;
+            }
+        }
+    }
+    success = (fclose(file) == 0) && success;
+    if (success == false) {
+        ImageToolsError::set(error, "Could not write file");
+        return false;
+    }
+    
+    return true;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::open(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    auto fileDescriptor = ::open(path, O_RDONLY);
+    if (fileDescriptor < 0) {
+        ImageToolsError::set(error, "Could not open file");
+        return nullptr;
+    }
+    
+    struct stat attributes;
+    if (fstat(fileDescriptor, &attributes) != 0 || attributes.st_size < static_cast<off_t>(sizeof(NativeImageFileHeader))) {
+        close(fileDescriptor);
+        ImageToolsError::set(error, "File is not a native image");
+        return nullptr;
+    }
+    
+    // The mapping stays valid after the file is closed. Private writable mapping lets editors modify pixels - modified pages are copied and never written back
+    auto size = static_cast<size_t>(attributes.st_size);
+    auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (address == MAP_FAILED) {
+        ImageToolsError::set(error, "Could not map file into memory");
+        return nullptr;
+    }
+    
+    auto info = NativeImageInfo();
+    if (_checkIfNativeImage(address, size) == false) {
+        munmap(address, size);
+        ImageToolsError::set(error, "File is not a native image");
+        return nullptr;
+    }
+    if (_parseNativeImage(address, size, info, error) == false) {
+        munmap(address, size);
+        return nullptr;
+    }
+    
+    // Pixels are usually processed from top to bottom
+    madvise(address, size, MADV_SEQUENTIAL);
+    
+    auto contents = reinterpret_cast<char*>(address) + info.contentsOffset;
+    auto image = new ImageContainer(info.pixelFormat, info.colorProfile, info.sRGB, info.hdr, contents, info.width, info.height, info.depth);
+    image->_contentsReleaseUserInfo = new NativeImageMapping {
+        .address = address,
+        .size = size
+    };
+    image->_contentsRelease = [](void* fn_nullable userInfo, char* fn_nonnull contents) {
+        auto mapping = reinterpret_cast<NativeImageMapping*>(userInfo);
+        munmap(mapping->address, mapping->size);
+        delete mapping;
+    };
+    return image;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::_tryLoadNative(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    // Check the magic first to not produce errors for other formats
+    auto isNative = info.usePath ? _checkIfNativeImage(info.path) : _checkIfNativeImage(info.buffer, info.bufferSize);
+    if (isNative == false) {
+        return nullptr;
+    }
+    
+    auto image = info.usePath ? open(info.path, error) : nullptr;
+    if (info.usePath == false) {
+        auto nativeInfo = NativeImageInfo();
+        if (_parseNativeImage(info.buffer, info.bufferSize, nativeInfo, error) == false) {
+            return nullptr;
+        }
+        
+        auto contents = reinterpret_cast<const char*>(info.buffer) + nativeInfo.contentsOffset;
+        auto contentsSize = nativeInfo.width * nativeInfo.height * nativeInfo.depth * nativeInfo.pixelFormat.getSize();
+        auto contentsCopy = ImageAllocator::allocate(contentsSize);
+        std::memcpy(contentsCopy, contents, contentsSize);
+        image = new ImageContainer(nativeInfo.pixelFormat, nativeInfo.colorProfile, nativeInfo.sRGB, nativeInfo.hdr, contentsCopy, nativeInfo.width, nativeInfo.height, nativeInfo.depth);
+    }
+    if (image == nullptr) {
+        return nullptr;
+    }
+    
+    // Apply the decode window to every slice, native contents are tightly packed
+    auto window = DecodeWindow(info.options, image->_width, image->_height);
+    if (window.validate(image->_width, image->_height, error) == false) {
+        ImageContainerRelease(image);
+        return nullptr;
+    }
+    if (window.coversWholeImage(image->_width, image->_height) == false) {
+        auto pixelSize = image->_pixelFormat.getSize();
+        auto sourceSliceSize = image->_width * image->_height * pixelSize;
+        auto sliceSize = window.outputWidth * window.outputHeight * pixelSize;
+        auto contents = ImageAllocator::allocate(sliceSize * image->_depth);
+        auto sRGB = image->_sRGB && image->_hdr == false;
+        for (long z = 0; z < image->_depth; z++) {
+            _extractDecodeWindow(window, image->_contents + z * sourceSliceSize, image->_width, contents + z * sliceSize, image->_pixelFormat, sRGB);
+        }
+        auto croppedImage = new ImageContainer(image->_pixelFormat, LCMSColorProfileRetain(image->_colorProfile), image->_sRGB, image->_hdr, contents, window.outputWidth, window.outputHeight, image->_depth);
+        ImageContainerRelease(image);
+        image = croppedImage;
+    }
+    
+    return image;
+}
+
+
+// MARK: - Lazy loading
+
+/// Reads parts of an image file or buffer without loading the whole image.
+struct _HeaderReader {
+    FILE* fn_nullable file = nullptr;
+    const unsigned char* fn_nullable buffer = nullptr;
+    long bufferSize = 0;
+    
+    _HeaderReader(const char* fn_nonnull path) {
+        file = fopen(path, "rb");
+    }
+    
+    _HeaderReader(const void* fn_nonnull buffer, long bufferSize):
+    buffer(reinterpret_cast<const unsigned char*>(buffer)),
+    bufferSize(bufferSize) { }
+    
+    ~_HeaderReader() {
+        if (file) {
+            fclose(file);
+        }
+    }
+    
+    bool read(long offset, void* fn_nonnull destination, long size) {
+        if (offset < 0 || size < 0) {
+            return false;
+        }
+        
+        if (file) {
+            return fseek(file, offset, SEEK_SET) == 0 && fread(destination, 1, size, file) == static_cast<size_t>(size);
+        }
+        
+        if (buffer == nullptr || offset > bufferSize || size > bufferSize - offset) {
+            return false;
+        }
+        std::memcpy(destination, buffer + offset, size);
+        return true;
+    }
+};
+
+
+static uint32_t _readBigEndian32(const unsigned char* fn_nonnull bytes) {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+
+static uint16_t _readBigEndian16(const unsigned char* fn_nonnull bytes) {
+    return static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+
+/// Parses the IHDR chunk and looks for a tRNS chunk before image data. Produces the same pixel format as ``ImageContainer::_tryLoadPNG``.
+static bool _probePNG(_HeaderReader& reader, ImagePixelFormat* fn_nonnull pixelFormat, long* fn_nonnull width, long* fn_nonnull height) {
+    // Signature, IHDR length and type, IHDR data
+    unsigned char header[8 + 8 + 13];
+    if (reader.read(0, header, sizeof(header)) == false || std::memcmp(header + 12, "IHDR", 4) != 0) {
+        return false;
+    }
+    
+    auto pngWidth = _readBigEndian32(header + 16);
+    auto pngHeight = _readBigEndian32(header + 20);
+    auto bitDepth = header[24];
+    auto colorType = header[25];
+    
+    // LibPNG expands palettes to RGB and transparency to an alpha channel, bit depth is kept otherwise
+    long numComponents = 0;
+    auto expandsToUInt8 = false;
+    switch (colorType) {
+        case 0: numComponents = 1; break; // Grey
+        case 2: numComponents = 3; break; // RGB
+        case 3: numComponents = 3; expandsToUInt8 = true; break; // Palette
+        case 4: numComponents = 2; break; // Grey and alpha
+        case 6: numComponents = 4; break; // RGBA
+        default: return false;
+    }
+    
+    // _tryLoadPNG doesn't load other bit depths
+    if (expandsToUInt8 == false && bitDepth != 8 && bitDepth != 16) {
+        return false;
+    }
+    
+    // Look for transparency of images without an alpha channel
+    if (colorType == 0 || colorType == 2 || colorType == 3) {
+        long offset = 8;
+        while (true) {
+            unsigned char chunk[8];
+            if (reader.read(offset, chunk, sizeof(chunk)) == false) {
+                return false;
+            }
+            
+            if (std::memcmp(chunk + 4, "IDAT", 4) == 0 || std::memcmp(chunk + 4, "IEND", 4) == 0) {
+                break;
+            }
+            
+            if (std::memcmp(chunk + 4, "tRNS", 4) == 0) {
+                numComponents += 1;
+                break;
+            }
+            
+            // Length, type, data and CRC
+            offset += 8 + static_cast<long>(_readBigEndian32(chunk)) + 4;
+        }
+    }
+    
+    auto componentType = (expandsToUInt8 == false && bitDepth == 16) ? PixelComponentType::uint16 : PixelComponentType::uint8;
+    *pixelFormat = ImagePixelFormat(componentType, numComponents);
+    *width = pngWidth;
+    *height = pngHeight;
+    return pngWidth > 0 && pngHeight > 0;
+}
+
+
+/// Looks for the start of frame marker. Produces the same pixel format as ``ImageContainer::_tryLoadJPEG``.
+static bool _probeJPEG(_HeaderReader& reader, ImagePixelFormat* fn_nonnull pixelFormat, long* fn_nonnull width, long* fn_nonnull height) {
+    unsigned char marker[4];
+    if (reader.read(0, marker, 2) == false || marker[0] != 0xFF || marker[1] != 0xD8) {
+        return false;
+    }
+    
+    long offset = 2;
+    while (true) {
+        if (reader.read(offset, marker, sizeof(marker)) == false || marker[0] != 0xFF) {
+            return false;
+        }
+        
+        // Fill bytes
+        if (marker[1] == 0xFF) {
+            offset += 1;
+            continue;
+        }
+        
+        // Markers without a segment
+        auto type = marker[1];
+        if (type == 0x01 || (type >= 0xD0 && type <= 0xD7)) {
+            offset += 2;
+            continue;
+        }
+        
+        // End of image or start of scan before a frame header
+        if (type == 0xD9 || type == 0xDA) {
+            return false;
+        }
+        
+        // SOF0-SOF15 except DHT, JPG and DAC
+        if (type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC) {
+            // Precision, height, width and number of components
+            unsigned char frame[6];
+            if (reader.read(offset + 4, frame, sizeof(frame)) == false) {
+                return false;
+            }
+            
+            // JPEGTurbo decodes 8-bit greyscale and colour images into 1 and 3 components, anything else is checked by decoding
+            auto precision = frame[0];
+            auto numComponents = frame[5];
+            if (precision != 8 || (numComponents != 1 && numComponents != 3)) {
+                return false;
+            }
+            
+            *pixelFormat = ImagePixelFormat(PixelComponentType::uint8, numComponents);
+            *width = _readBigEndian16(frame + 3);
+            *height = _readBigEndian16(frame + 1);
+            return *width > 0 && *height > 0;
+        }
+        
+        offset += 2 + _readBigEndian16(marker + 2);
+    }
+}
+
+
+bool ImageContainer::_probe(const _LoadInfo& info fn_noescape, ImagePixelFormat* fn_nonnull pixelFormat, long* fn_nonnull width, long* fn_nonnull height, bool* fn_nonnull hdr) {
+    auto path = info.path;
+    auto buffer = reinterpret_cast<const unsigned char*>(info.buffer);
+    auto bufferSize = info.bufferSize;
+    
+    // Formats are checked in the same order as in _load. Native images are mapped without decoding, FastTGA decodes whole images
+    auto isNative = info.usePath ? _checkIfNativeImage(path) : _checkIfNativeImage(info.buffer, bufferSize);
+    if (isNative) {
+        return false;
+    }
+    
+    auto tgaError = TGAError();
+    auto tgaSource = info.usePath ? TGASource(path) : TGASource(info.buffer, bufferSize);
+    if (TGAImage::isTGA(tgaSource, &tgaError)) {
+        return false;
     }
-    if (components == nullptr) {
-        auto reason = stbi_failure_reason();
-        if (reason) {
-            ImageToolsError::set(error, reason);
-        }
-        else {
-            ImageToolsError::set(error, "Could not open image for some unknown reason");
-        }
-        return nullptr;
+    
+    auto isJPEG = info.usePath ? checkIfJPEG(path) : checkIfJPEG(info.buffer, bufferSize);
+    if (isJPEG) {
+        auto reader = info.usePath ? _HeaderReader(path) : _HeaderReader(info.buffer, bufferSize);
+        *hdr = false;
+        return _probeJPEG(reader, pixelFormat, width, height);
     }
     
-    auto pixelFormat = ImagePixelFormat(is16Bit ? PixelComponentType::float16 : PixelComponentType::uint8, numComponents);
+    auto isPNG = info.usePath ? PNGImage::checkIfPNG(path) : PNGImage::checkIfPNG(info.buffer, bufferSize);
+    if (isPNG) {
+        auto reader = info.usePath ? _HeaderReader(path) : _HeaderReader(info.buffer, bufferSize);
+        *hdr = false;
+        return _probePNG(reader, pixelFormat, width, height);
+    }
     
-    // Copy pixel information
-    auto contentsSize = width * height * numComponents * (is16Bit ? 2 : 1);
-    auto contents = reinterpret_cast<char*>(std::malloc(contentsSize));
-    std::memset(contents, 0xff, contentsSize);
-    auto ucharComponents = reinterpret_cast<unsigned char*>(contents);
-    auto halfComponents = reinterpret_cast<_Float16*>(contents);
-    for (auto y = 0; y < height; y++) {
-        for (auto x = 0; x < width; x++) {
-            auto index = (y * width + x) * numComponents;
-            auto rgba = components + index;
-            
-            for (auto i = 0; i < numComponents; i++) {
-                auto value = rgba[i];
-                //value = pow(value, 1 / 2.2);
-                if (is16Bit) {
-                    halfComponents[index + i] = static_cast<_Float16>(value);
-                }
-                else {
-                    ucharComponents[index + i] = static_cast<unsigned char>(255.0f * value);
-                }
+    // OpenEXR header contains everything needed
+    auto isEXRResult = info.usePath ? IsEXR(path) : IsEXRFromMemory(buffer, bufferSize);
+    if (isEXRResult == TINYEXR_SUCCESS) {
+        EXRVersion version;
+        auto result = info.usePath ? ParseEXRVersionFromFile(&version, path) : ParseEXRVersionFromMemory(&version, buffer, bufferSize);
+        if (result != TINYEXR_SUCCESS) {
+            return false;
+        }
+        
+        EXRHeader header;
+        const char* err = nullptr;
+        result = info.usePath ? ParseEXRHeaderFromFile(&header, &version, path, &err) : ParseEXRHeaderFromMemory(&header, &version, buffer, bufferSize, &err);
+        if (result != TINYEXR_SUCCESS) {
+            if (err) {
+                FreeEXRErrorMessage(err);
             }
+            return false;
         }
+        
+        // Same as in _tryLoadOpenEXR
+        *pixelFormat = ImagePixelFormat(PixelComponentType::float16, std::min(header.num_channels, 4));
+        *width = header.data_window.max_x - header.data_window.min_x + 1;
+        *height = header.data_window.max_y - header.data_window.min_y + 1;
+        *hdr = true;
+        FreeEXRHeader(&header);
+        return true;
     }
     
+    // Everything else is decoded by stb_image
+    auto stbiBuffer = reinterpret_cast<const stbi_uc*>(info.buffer);
+    auto stbiBufferSize = static_cast<int>(info.bufferSize);
+    int stbiWidth = 0;
+    int stbiHeight = 0;
+    int numComponents = 0;
+    auto result = info.usePath ? stbi_info(path, &stbiWidth, &stbiHeight, &numComponents) : stbi_info_from_memory(stbiBuffer, stbiBufferSize, &stbiWidth, &stbiHeight, &numComponents);
+    if (result == 0 || numComponents < 1 || numComponents > 4) {
+        return false;
+    }
     
-    stbi_image_free(components);
+    auto is16Bit = info.usePath ? stbi_is_16_bit(path) : stbi_is_16_bit_from_memory(stbiBuffer, stbiBufferSize);
+    auto isHdr = info.usePath ? stbi_is_hdr(path) : stbi_is_hdr_from_memory(stbiBuffer, stbiBufferSize);
     
-    // Take the assumed colour profile if specified, since stb_image does not provide it
-    LCMSColorProfile* fn_nullable colorProfile = LCMSColorProfileRetain(assumedColorProfile);
+    // Same as in _load
+    *pixelFormat = ImagePixelFormat(isHdr ? PixelComponentType::float16 : is16Bit ? PixelComponentType::uint16 : PixelComponentType::uint8, numComponents);
+    *width = stbiWidth;
+    *height = stbiHeight;
+    *hdr = isHdr;
+    return true;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::_loadLazily(const _LoadInfo& info fn_noescape, _LazySource* fn_nonnull lazySource, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto pixelFormat = ImagePixelFormat::rgba8Unorm;
+    long width = 0;
+    long height = 0;
+    bool hdr = false;
+    if (_probe(info, &pixelFormat, &width, &height, &hdr) == false) {
+        // The header can't be parsed without decoding, so decode right away
+        auto image = _load(info, lazySource->assumedColorProfile, lazySource->assumeSRGB, error);
+        delete lazySource;
+        return image;
+    }
     
-    printf("Image \"%s\" is loaded using stb_image - %ld bytes per component\n", imageName, pixelFormat.getComponentSize());
-    return new ImageContainer(pixelFormat, colorProfile, sRGB, isHdr, contents, width, height, 1);
+    // Colour information is refined once the image is decoded
+    auto sRGB = hdr ? false : lazySource->assumeSRGB;
+    return new ImageContainer(pixelFormat, LCMSColorProfileRetain(lazySource->assumedColorProfile), sRGB, hdr, lazySource, width, height);
 }
 
 
-ImageContainer* fn_nullable ImageContainer::load(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+ImageContainer* fn_nullable ImageContainer::loadLazily(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto lazySource = new _LazySource(true, assumedColorProfile, assumeSRGB);
+    lazySource->path = path;
+    
     auto info = _LoadInfo {
         .usePath = true,
-        .path = path
+        .path = lazySource->path.c_str()
     };
-    return _load(info, assumedColorProfile, assumeSRGB, error);
+    return _loadLazily(info, lazySource, error);
 }
 
 
-ImageContainer* fn_nullable ImageContainer::load(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+ImageContainer* fn_nullable ImageContainer::loadLazily(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED {
+    auto lazySource = new _LazySource(false, assumedColorProfile, assumeSRGB);
+    auto bytes = reinterpret_cast<const char*>(buffer);
+    lazySource->buffer.assign(bytes, bytes + bufferSize);
+    
     auto info = _LoadInfo {
         .usePath = false,
-        .buffer = buffer,
+        .buffer = lazySource->buffer.data(),
         .bufferSize = bufferSize
     };
-    return _load(info, assumedColorProfile, assumeSRGB, error);
+    return _loadLazily(info, lazySource, error);
+}
+
+
+bool ImageContainer::_decode(ImageToolsError* fn_nullable error fn_noescape) {
+    std::lock_guard lock(_decodeMutex);
+    
+    // Another thread has already tried to decode the image
+    if (_decoded.load(std::memory_order_relaxed)) {
+        if (_lazySource && error) {
+            *error = _lazySource->decodeError;
+        }
+        return _lazySource == nullptr;
+    }
+    
+    auto source = _lazySource;
+    auto info = source->usePath ? _LoadInfo { .usePath = true, .path = source->path.c_str() }
+                                : _LoadInfo { .usePath = false, .buffer = source->buffer.data(), .bufferSize = static_cast<long>(source->buffer.size()) };
+    auto image = _load(info, source->assumedColorProfile, source->assumeSRGB, &source->decodeError);
+    
+    // The header is parsed by the same decoder, so a mismatch means the file has changed or is broken
+    if (image && (image->_width != _width || image->_height != _height || image->_depth != _depth || !(image->_pixelFormat == _pixelFormat))) {
+        source->decodeError.set(ImageToolsErrorCode::other, "Decoded image does not match the image header");
+        ImageContainerRelease(image);
+        image = nullptr;
+    }
+    
+    auto success = image != nullptr;
+    if (image) {
+        std::swap(_contents, image->_contents);
+        std::swap(_contentsRelease, image->_contentsRelease);
+        std::swap(_contentsReleaseUserInfo, image->_contentsReleaseUserInfo);
+        std::swap(_bytesPerRow, image->_bytesPerRow);
+        std::swap(_bytesPerSlice, image->_bytesPerSlice);
+        std::swap(_colorProfile, image->_colorProfile);
+        _sRGB = image->_sRGB;
+        _hdr = image->_hdr;
+        ImageContainerRelease(image);
+        
+        delete _lazySource;
+        _lazySource = nullptr;
+    }
+    else {
+        // Keep the error for decode and give accessors valid contents
+        if (source->decodeError._code == ImageToolsErrorCode::unknown) {
+            source->decodeError.set(ImageToolsErrorCode::other, "Could not decode image");
+        }
+        auto contentsSize = getContentsSize();
+        _contents = ImageAllocator::allocate(contentsSize);
+        std::memset(_contents, 0, contentsSize);
+    }
+    _decoded.store(true, std::memory_order_release);
+    
+    if (success == false && error) {
+        *error = source->decodeError;
+    }
+    return success;
+}
+
+
+bool ImageContainer::decode(ImageToolsError* fn_nullable error fn_noescape) {
+    if (_decoded.load(std::memory_order_acquire) && _lazySource == nullptr) {
+        return true;
+    }
+    
+    // Decodes or reports the error of a failed attempt
+    return _decode(error);
 }
 
 
@@ -1023,7 +2501,34 @@ bool ImageContainer::_convertColorProfile(LCMSColorProfile* fn_nullable colorPro
         return true;
     }
     
-    ::_convertColorProfile(colorProfile, _colorProfile, _width, _height, _contents, _pixelFormat, _hdr);
+    if (colorProfile) {
+        auto sourceProfile = _colorProfile ? LCMSColorProfileRetain(_colorProfile) : (_sRGB ? createSharedSRGBColorProfile() : nullptr);
+        
+        // Conversions between sRGB and linear sRGB only apply the transfer function, which is much cheaper than building an LCMS transform
+        auto toLinear = false;
+        if (sourceProfile && checkIsSRGBTransferConversion(sourceProfile, colorProfile, toLinear)) {
+            LCMSColorProfileRelease(sourceProfile);
+            _applyTransferFunction(toLinear, true);
+            _assignColorProfile(colorProfile);
+            return true;
+        }
+        LCMSColorProfileRelease(sourceProfile);
+    }
+    
+    // LCMS only understands 8-bit integer and floating point components, convert other integers through float32
+    auto componentType = _pixelFormat.componentType;
+    auto promote = componentType == PixelComponentType::uint16 || componentType == PixelComponentType::uint32;
+    if (promote) {
+        _setComponentType(PixelComponentType::float32);
+    }
+    
+    // LCMS expects tightly packed pixels
+    _pack();
+    ::_convertColorProfile(colorProfile, _colorProfile, _width, _height, _depth, _contents, _pixelFormat, _hdr);
+    
+    if (promote) {
+        _setComponentType(componentType);
+    }
     
     // Apply colour profile
     _assignColorProfile(colorProfile);
@@ -1034,153 +2539,43 @@ bool ImageContainer::_convertColorProfile(LCMSColorProfile* fn_nullable colorPro
 
 
 void ImageContainer::_setComponentType(PixelComponentType componentType) {
-    // Calculate size for the new buffer
-    //auto sourcePixelSize = _pixelFormat.getSize();
-    auto destinationPixelSize = _pixelFormat.numComponents * getPixelComponentTypeSize(componentType);
-    auto newSize = _width * _height * _depth * destinationPixelSize;
-    auto newContents = reinterpret_cast<char*>(std::malloc(newSize));
-    //memset(newContents, 0xFF, newSize);
-    
-    union Content {
-        char* contents;
-        uint8_t* uint8;
-        _Float16* float16;
-        float* float32;
-    };
-    Content src = { .contents = _contents };
-    Content dst = { .contents = newContents };
-    
-    if (_pixelFormat.componentType == PixelComponentType::uint8 && componentType == PixelComponentType::float16) {
-        // uint8 to float16
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.uint8 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.float16 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    *dstValue = uint8Table[*srcValue].fp16Value;
-                    //*dstValue = static_cast<_Float16>(*srcValue) / 255;
-                    srcValue += 1;
-                    dstValue += 1;
-                }
-            } CONCURRENT_LOOP_END
-        }
-    }
-    else if (_pixelFormat.componentType == PixelComponentType::uint8 && componentType == PixelComponentType::float32) {
-        // uint8 to float32
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.uint8 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.float32 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    *dstValue = uint8Table[*srcValue].fp32Value;
-                    //*dstValue = static_cast<float>(*srcValue) / 255;
-                    srcValue += 1;
-                    dstValue += 1;
-                }
-            } CONCURRENT_LOOP_END
-        }
-    }
-    
-    
-    else if (_pixelFormat.componentType == PixelComponentType::float16 && componentType == PixelComponentType::uint8) {
-        // float16 to uint8
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.float16 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.uint8 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    constexpr auto _min = static_cast<_Float16>(0);
-                    constexpr auto _max = static_cast<_Float16>(255);
-                    auto value = std::clamp(*srcValue * _max, _min, _max);
-                    *dstValue = static_cast<uint8_t>(value);
-                    //const auto fpMax = static_cast<_Float16>(255);
-                    //auto value = std::min(fpMax, static_cast<_Float16>(*srcValue * 255));
-                    //*dstValue = static_cast<uint8_t>(std::max(static_cast<_Float16>(0), value));
-                    srcValue += 1;
-                    dstValue += 1;
-                }
-            } CONCURRENT_LOOP_END
-        }
-    }
-    else if (_pixelFormat.componentType == PixelComponentType::float16 && componentType == PixelComponentType::float32) {
-        // float16 to float32
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.float16 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.float32 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    *dstValue = static_cast<float>(*srcValue);
-                    srcValue += 1;
-                    dstValue += 1;
-                }
-            } CONCURRENT_LOOP_END
-        }
+    if (_pixelFormat.componentType == componentType) {
+        return;
     }
     
+    auto convert = getComponentConversionKernel(_pixelFormat.componentType, componentType);
+    auto numValues = _width * _pixelFormat.numComponents;
     
-    else if (_pixelFormat.componentType == PixelComponentType::float32 && componentType == PixelComponentType::uint8) {
-        // float16 to uint8
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.float32 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.uint8 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    auto value = std::clamp(*srcValue * 255.0f, 0.0f, 255.0f);
-                    *dstValue = static_cast<uint8_t>(value);
-                    //auto value = std::min(255.0f, *srcValue * 255.0f);
-                    //*dstValue = static_cast<uint8_t>(std::max(0.0f, value));
-                    //*dstValue = static_cast<uint8_t>(std::min(255.0f, *srcValue * 255.0f));
-                    srcValue += 1;
-                    dstValue += 1;
-                }
-            } CONCURRENT_LOOP_END
-        }
-    }
-    else if (_pixelFormat.componentType == PixelComponentType::float32 && componentType == PixelComponentType::float16) {
-        // float16 to float32
-        for (auto z = 0; z < _depth; z++) {
+    // Narrowing conversions of file contents run in place - every row shrinks within its own bytes, then rows are moved together and the file is truncated. Heap contents can't shrink without a copy, so they are converted into a new buffer below
+    if (getPixelComponentTypeSize(componentType) <= _pixelFormat.getComponentSize() && _contentsRelease == _releaseFileStorage) {
+        for (long z = 0; z < _depth; z++) {
             CONCURRENT_LOOP_START(0, _height, y) {
-                auto srcValue = src.float32 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto dstValue = dst.float16 + (z * _width * _height + y * _width) * _pixelFormat.numComponents;
-                auto numValues = _width * _pixelFormat.numComponents;
-                for (auto x = 0; x < numValues; x++) {
-                    *dstValue = static_cast<_Float16>(*srcValue);
-                    srcValue += 1;
-                    dstValue += 1;
-                }
+                auto row = _getRow(y, z);
+                convert(row, row, numValues);
             } CONCURRENT_LOOP_END
         }
+        
+        _pixelFormat.componentType = componentType;
+        _setBytesPerRow(_bytesPerRow, _bytesPerSlice);
+        _pack();
+        return;
     }
     
+    // Calculate size for the new buffer
+    auto destinationRowSize = numValues * getPixelComponentTypeSize(componentType);
+    auto newBuffer = _allocateContents(destinationRowSize * _height * _depth);
+    auto newContents = newBuffer.contents;
     
-    else {
-        // General case
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                for (auto x = 0; x < _width; x++) {
-                    // Read pixel as float32
-                    auto pixel = _getPixel_general(x, y, z,
-                                                   _width, _height, _depth,
-                                                   _contents, _pixelFormat.numComponents, _pixelFormat.componentType);
-                    
-                    // Write pixel in target pixel format
-                    _setPixel_general(pixel, x, y, z,
-                                      _width, _height, _depth,
-                                      newContents, _pixelFormat.numComponents, componentType);
-                }
-            } CONCURRENT_LOOP_END
-        }
+    for (long z = 0; z < _depth; z++) {
+        CONCURRENT_LOOP_START(0, _height, y) {
+            convert(_getRow(y, z), newContents + (z * _height + y) * destinationRowSize, numValues);
+        } CONCURRENT_LOOP_END
     }
     
-    // Apply changes
+    // Apply changes, the new buffer has tightly packed rows
     _pixelFormat.componentType = componentType;
-    std::free(_contents);
-    _contents = newContents;
+    _replaceContents(newBuffer);
+    _setBytesPerRow(0);
 }
 
 
@@ -1196,13 +2591,17 @@ bool ImageContainer::_setNumComponents(long numComponents, float fill, ImageTool
         return true;
     }
     
+    // Pixels are moved within contents, which is only possible without row padding
+    _pack();
+    
     // Calculate the new size
+    auto oldSize = getContentsSize();
     auto newSize = _width * _height * _depth * numComponents * _pixelFormat.getComponentSize();
     
     // Modify pixel data
     if (numComponents > _pixelFormat.numComponents) {
         // In case of increasing the number of components - reallocate memory first
-        _contents = reinterpret_cast<char*>(std::realloc(_contents, newSize));
+        _resizeContents(oldSize, newSize);
         
         // And then modify pixel data
         for (long z = _depth - 1; z >= 0; z--) {
@@ -1236,11 +2635,12 @@ bool ImageContainer::_setNumComponents(long numComponents, float fill, ImageTool
         }
         
         // And then truncate memory
-        _contents = reinterpret_cast<char*>(std::realloc(_contents, newSize));
+        _resizeContents(oldSize, newSize);
     }
     
     // Apply changes
     _pixelFormat.numComponents = numComponents;
+    _setBytesPerRow(0);
     
     return true;
 }
@@ -1256,8 +2656,17 @@ void ImageContainer::_setPixel(ImagePixel pixel, long x, long y, long z, long nu
 }
 
 
+ImagePixel ImageContainer::_getPixel(long x, long y, long z) {
+    y = std::clamp(y, 0l, _height - 1);
+    z = std::clamp(z, 0l, _depth - 1);
+    return _getPixel_general(x, 0, 0, _width, 1, 1, _getRow(y, z), _pixelFormat.numComponents, _pixelFormat.componentType);
+}
+
+
 void ImageContainer::_setPixel(ImagePixel pixel, long x, long y, long z) {
-    _setPixel_general(pixel, x, y, z, _width, _height, _depth, _contents, _pixelFormat.numComponents, _pixelFormat.componentType);
+    y = std::clamp(y, 0l, _height - 1);
+    z = std::clamp(z, 0l, _depth - 1);
+    _setPixel_general(pixel, x, 0, 0, _width, 1, 1, _getRow(y, z), _pixelFormat.numComponents, _pixelFormat.componentType);
 }
 
 
@@ -1267,6 +2676,8 @@ bool ImageContainer::_setChannel(long channelIndex, ImageContainer* fn_nonnull s
         return true;
     }
     
+    sourceImage->_ensureDecoded();
+    
     // Image sizes are not equal
     if (_width != sourceImage->_width || _height != sourceImage->_height || _depth != sourceImage->_depth) {
         ImageToolsError::set(error, "Image sizes are not equal. Resize the source or destination image first to match the sizes");
@@ -1302,6 +2713,145 @@ bool ImageContainer::_setChannel(long channelIndex, ImageContainer* fn_nonnull s
 }
 
 
+LCMSColorProfile* fn_nullable ImageContainer::_convertToLinearProfile() {
+    LCMSColorProfile* linearProfile = nullptr;
+    if (_colorProfile) {
+        // Check if the colour profile should be converted at all
+        if (_colorProfile->checkIsLinear()) {
+            //printf("Colour profile is already linear\n");
+        }
+        else {
+            linearProfile = createSharedLinearColorProfile(_colorProfile);
+            if (linearProfile == nullptr) {
+                // This should never happen
+                printf("Could not create linear colour profile\n");
+            }
+        }
+    }
+    else if (_sRGB) {
+        auto sRGBProfile = createSharedSRGBColorProfile();
+        linearProfile = createSharedLinearColorProfile(sRGBProfile);
+        if (linearProfile == nullptr) {
+            // This should never happen
+            printf("Could not create linear colour profile\n");
+        }
+        LCMSColorProfileRelease(sRGBProfile);
+    }
+    
+    // Create source image with linear color profile
+    if (linearProfile != nullptr) {
+        //printf("Convert colour profile to linear\n");
+        _convertColorProfile(linearProfile);
+    }
+    
+    return linearProfile;
+}
+
+
+/// Horizontal Lanczos pass over every row of every slice. Destination pixel `x` samples the source at `(targetOrigin + x + 0.5) * scale - 0.5 - sourceOrigin`, so regions of a larger image are resampled in coordinates of the whole image.
+static void _resampleLanczosX(float quality, bool renormalize, float scale, long sourceOrigin, long targetOrigin, long sourceWidth, long width, long height, long depth, char* fn_nonnull sourceContents, char* fn_nonnull destinationContents, long numComponents, PixelComponentType componentType) {
+#define resample_x_func(_type_, _nc_) \
+for (auto z = 0; z < depth; z++) { \
+    CONCURRENT_LOOP_START(0, height, y) { \
+        for (auto x = 0; x < width; x++) { \
+            auto srcX = (targetOrigin + x + 0.5) * scale - 0.5 - sourceOrigin; \
+            auto pixel = _sampleLanczosX_##_type_<_nc_>(srcX, y, z, quality, sourceWidth, height, depth, sourceContents, renormalize); \
+            _setPixel_##_type_<_nc_>(pixel, x, y, z, width, height, depth, destinationContents); \
+        } \
+    } CONCURRENT_LOOP_END \
+}
+    if (componentType == PixelComponentType::float16 && numComponents == 1) { resample_x_func(float16, 1) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 2) { resample_x_func(float16, 2) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 3) { resample_x_func(float16, 3) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 4) { resample_x_func(float16, 4) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 1) { resample_x_func(float32, 1) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 2) { resample_x_func(float32, 2) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 3) { resample_x_func(float32, 3) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 4) { resample_x_func(float32, 4) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 1) { resample_x_func(uint16, 1) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 2) { resample_x_func(uint16, 2) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 3) { resample_x_func(uint16, 3) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 4) { resample_x_func(uint16, 4) }
+    else {
+        for (auto z = 0; z < depth; z++) {
+            CONCURRENT_LOOP_START(0, height, y) {
+                for (auto x = 0; x < width; x++) {
+                    auto srcX = (targetOrigin + x + 0.5) * scale - 0.5 - sourceOrigin;
+                    auto pixel = _sampleLanczosX_general(srcX, y, z, quality, sourceWidth, height, depth, sourceContents, numComponents, componentType, renormalize);
+                    _setPixel_general(pixel, x, y, z, width, height, depth, destinationContents, numComponents, componentType);
+                }
+            } CONCURRENT_LOOP_END
+        }
+    }
+#undef resample_x_func
+}
+
+
+/// Vertical Lanczos pass, see ``_resampleLanczosX``. `rowFinished` is called after every destination row.
+template <typename RowCallback>
+static void _resampleLanczosY(float quality, bool renormalize, float scale, long sourceOrigin, long targetOrigin, long sourceHeight, long width, long height, long depth, char* fn_nonnull sourceContents, char* fn_nonnull destinationContents, long numComponents, PixelComponentType componentType, RowCallback rowFinished) {
+#define resample_y_func(_type_, _nc_) \
+for (auto z = 0; z < depth; z++) { \
+    CONCURRENT_LOOP_START(0, height, y) { \
+        for (auto x = 0; x < width; x++) { \
+            auto srcY = (targetOrigin + y + 0.5) * scale - 0.5 - sourceOrigin; \
+            auto pixel = _sampleLanczosY_##_type_<_nc_>(x, srcY, z, quality, width, sourceHeight, depth, sourceContents, renormalize); \
+            _setPixel_##_type_<_nc_>(pixel, x, y, z, width, height, depth, destinationContents); \
+        } \
+        rowFinished(); \
+    } CONCURRENT_LOOP_END \
+}
+    if (componentType == PixelComponentType::float16 && numComponents == 1) { resample_y_func(float16, 1) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 2) { resample_y_func(float16, 2) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 3) { resample_y_func(float16, 3) }
+    else if (componentType == PixelComponentType::float16 && numComponents == 4) { resample_y_func(float16, 4) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 1) { resample_y_func(float32, 1) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 2) { resample_y_func(float32, 2) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 3) { resample_y_func(float32, 3) }
+    else if (componentType == PixelComponentType::float32 && numComponents == 4) { resample_y_func(float32, 4) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 1) { resample_y_func(uint16, 1) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 2) { resample_y_func(uint16, 2) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 3) { resample_y_func(uint16, 3) }
+    else if (componentType == PixelComponentType::uint16 && numComponents == 4) { resample_y_func(uint16, 4) }
+    else {
+        for (auto z = 0; z < depth; z++) {
+            CONCURRENT_LOOP_START(0, height, y) {
+                for (auto x = 0; x < width; x++) {
+                    auto srcY = (targetOrigin + y + 0.5) * scale - 0.5 - sourceOrigin;
+                    auto pixel = _sampleLanczosY_general(x, srcY, z, quality, width, sourceHeight, depth, sourceContents, numComponents, componentType, renormalize);
+                    _setPixel_general(pixel, x, y, z, width, height, depth, destinationContents, numComponents, componentType);
+                }
+                rowFinished();
+            } CONCURRENT_LOOP_END
+        }
+    }
+#undef resample_y_func
+}
+
+
+void ImageContainer::_resampleRegion(float quality, bool renormalize, long sourceWidth, long sourceHeight, long sourceX, long sourceY, long targetWidth, long targetHeight, long targetX, long targetY, long width, long height) {
+    _pack();
+    auto linearProfile = _convertToLinearProfile();
+    
+    // Same passes as the whole image resampling. Samplers clamp indices to the region, so it has to include the edge where the kernel goes beyond the image
+    auto numComponents = _pixelFormat.numComponents;
+    auto componentType = _pixelFormat.componentType;
+    auto intermediate = _allocateContents(width * _height * _pixelFormat.getSize());
+    auto contents = _allocateContents(width * height * _pixelFormat.getSize());
+    _resampleLanczosX(quality, renormalize, static_cast<float>(sourceWidth) / targetWidth, sourceX, targetX, _width, width, _height, 1, _contents, intermediate.contents, numComponents, componentType);
+    _resampleLanczosY(quality, renormalize, static_cast<float>(sourceHeight) / targetHeight, sourceY, targetY, _height, width, height, 1, intermediate.contents, contents.contents, numComponents, componentType, [] {});
+    _releaseContents(intermediate);
+    
+    _replaceContents(contents);
+    _width = width;
+    _height = height;
+    _setBytesPerRow(0);
+    
+    // Keep the same colour profile as the whole image resampling
+    LCMSColorProfileRelease(linearProfile);
+}
+
+
 void ImageContainer::_resample(ResamplingAlgorithm algorithm, float quality, long width, long height, long depth, bool renormalize, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
     // Correct dimensions if wrong
     width = std::max(1l, width);
@@ -1353,41 +2903,16 @@ void ImageContainer::_resample(ResamplingAlgorithm algorithm, float quality, lon
     auto progressHandler = ProgressHandler {
         .userInfo = userInfo,
         .progressCallback = progressCallback,
-        .numSteps = totalSteps,
-        .currentStep = 0,
-        .stepDistance = totalSteps / 10
-    };
-        
-    // Convert pixels to linear colour profile
-    LCMSColorProfile* linearProfile = nullptr;
-    if (_colorProfile) {
-        // Check if the colour profile should be converted at all
-        if (_colorProfile->checkIsLinear()) {
-            //printf("Colour profile is already linear\n");
-        }
-        else {
-            linearProfile = _colorProfile->createLinear();
-            if (linearProfile == nullptr) {
-                // This should never happen
-                printf("Could not create linear colour profile\n");
-            }
-        }
-    }
-    else if (_sRGB) {
-        auto sRGBProfile = LCMSColorProfile::createSRGB();
-        linearProfile = sRGBProfile->createLinear();
-        if (linearProfile == nullptr) {
-            // This should never happen
-            printf("Could not create linear colour profile\n");
-        }
-        LCMSColorProfileRelease(sRGBProfile);
-    }
+        .numSteps = totalSteps,
+        .currentStep = 0,
+        .stepDistance = totalSteps / 10
+    };
+        
+    // Resampling passes work on tightly packed pixels
+    _pack();
     
-    // Create source image with linear color profile
-    if (linearProfile != nullptr) {
-        //printf("Convert colour profile to linear\n");
-        _convertColorProfile(linearProfile);
-    }
+    // Convert pixels to linear colour profile
+    auto linearProfile = _convertToLinearProfile();
     
     // Calculate intermediate memory
     auto sourceSize = _width * _height * _depth * _pixelFormat.getSize();
@@ -1399,11 +2924,12 @@ void ImageContainer::_resample(ResamplingAlgorithm algorithm, float quality, lon
     // Expand buffer size if needed
     if (temporarySize > sourceSize) {
         currentSize = temporarySize;
-        _contents = reinterpret_cast<char*>(std::realloc(_contents, temporarySize));
+        _resizeContents(sourceSize, temporarySize);
     }
     
     // Intermediate buffer
-    auto tmpBuffer = reinterpret_cast<char*>(std::malloc(intermediateSize));
+    auto intermediateContents = _allocateContents(intermediateSize);
+    auto tmpBuffer = intermediateContents.contents;
     
     // Source and destination contents for resampling passes
     auto sourceContents = _contents;
@@ -1417,96 +2943,17 @@ void ImageContainer::_resample(ResamplingAlgorithm algorithm, float quality, lon
                                static_cast<float>(_depth) / depth);
     
     // Horizontal pass
-#define resample_x_func(_type_, _nc_) \
-for (auto z = 0; z < _depth; z++) { \
-    CONCURRENT_LOOP_START(0, _height, y) { \
-        for (auto x = 0; x < width; x++) { \
-            auto srcX = (x + 0.5) * scale.x - 0.5; \
-            auto pixel = _sampleLanczosX_##_type_<_nc_>(srcX, y, z, quality, _width, _height, _depth, sourceContents, renormalize); \
-            _setPixel_##_type_<_nc_>(pixel, x, y, z, width, _height, _depth, destinationContents); \
-        } \
-    } CONCURRENT_LOOP_END \
-}
-    //for (auto z = 0; z < _depth; z++) {
-    //    CONCURRENT_LOOP_START(0, _height, y) {
-    //        for (auto x = 0; x < width; x++) {
-    //            auto srcX = (x + 0.5) * scale.x - 0.5;
-    //            auto pixel = _sampleLanczosX_float16<4>(srcX, y, z, quality, _width, _height, _depth, sourceContents, renormalize);
-    //            _setPixel_float16<4>(pixel, x, y, z, width, _height, _depth, destinationContents);
-    //        }
-    //    } CONCURRENT_LOOP_END
-    //}
-    if (componentType == PixelComponentType::float16 && numComponents == 1) { resample_x_func(float16, 1) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 2) { resample_x_func(float16, 2) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 3) { resample_x_func(float16, 3) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 4) { resample_x_func(float16, 4) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 1) { resample_x_func(float32, 1) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 2) { resample_x_func(float32, 2) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 3) { resample_x_func(float32, 3) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 4) { resample_x_func(float32, 4) }
-    else {
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, _height, y) {
-                for (auto x = 0; x < width; x++) {
-                    auto srcX = (x + 0.5) * scale.x - 0.5;
-                    auto pixel = _sampleLanczosX_general(srcX, y, z, quality, _width, _height, _depth, sourceContents, numComponents, componentType, renormalize);
-                    _setPixel_general(pixel, x, y, z, width, _height, _depth, destinationContents, numComponents, componentType);
-                }
-            } CONCURRENT_LOOP_END
-        }
-    }
+    _resampleLanczosX(quality, renormalize, scale.x, 0, 0, _width, width, _height, _depth, sourceContents, destinationContents, numComponents, componentType);
     // Prepare source and destination contents for further processing
     std::swap(sourceContents, destinationContents);
-#undef resample_x_func
-    
     
     // Vertical pass
-#define resample_y_func(_type_, _nc_) \
-for (auto z = 0; z < _depth; z++) { \
-    CONCURRENT_LOOP_START(0, height, y) { \
-        for (auto x = 0; x < width; x++) { \
-            auto srcY = (y + 0.5) * scale.y - 0.5; \
-            auto pixel = _sampleLanczosY_##_type_<_nc_>(x, srcY, z, quality, width, _height, _depth, sourceContents, renormalize); \
-            _setPixel_##_type_<_nc_>(pixel, x, y, z, width, height, _depth, destinationContents); \
-        } \
-        progressHandler.notifyProgress(); \
-    } CONCURRENT_LOOP_END \
-}
-    //for (auto z = 0; z < _depth; z++) {
-    //    CONCURRENT_LOOP_START(0, height, y) {
-    //        for (auto x = 0; x < width; x++) {
-    //            auto srcY = (y + 0.5) * scale.y - 0.5;
-    //            auto pixel = _sampleLanczosY_float16<4>(x, srcY, z, quality, width, _height, _depth, sourceContents, renormalize);
-    //            _setPixel_float16<4>(pixel, x, y, z, width, height, _depth, destinationContents);
-    //        }
-    //        // Check cancellation
-    //        progressHandler.notifyProgress();
-    //    } CONCURRENT_LOOP_END
-    //}
-    if (componentType == PixelComponentType::float16 && numComponents == 1) { resample_y_func(float16, 1) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 2) { resample_y_func(float16, 2) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 3) { resample_y_func(float16, 3) }
-    else if (componentType == PixelComponentType::float16 && numComponents == 4) { resample_y_func(float16, 4) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 1) { resample_y_func(float32, 1) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 2) { resample_y_func(float32, 2) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 3) { resample_y_func(float32, 3) }
-    else if (componentType == PixelComponentType::float32 && numComponents == 4) { resample_y_func(float32, 4) }
-    else {
-        for (auto z = 0; z < _depth; z++) {
-            CONCURRENT_LOOP_START(0, height, y) {
-                for (auto x = 0; x < width; x++) {
-                    auto srcY = (y + 0.5) * scale.y - 0.5;
-                    auto pixel = _sampleLanczosY_general(x, srcY, z, quality, width, _height, _depth, sourceContents, numComponents, componentType, renormalize);
-                    _setPixel_general(pixel, x, y, z, width, height, _depth, destinationContents, numComponents, componentType);
-                }
-                // Check cancellation
-                progressHandler.notifyProgress();
-            } CONCURRENT_LOOP_END
-        }
-    }
+    _resampleLanczosY(quality, renormalize, scale.y, 0, 0, _height, width, height, _depth, sourceContents, destinationContents, numComponents, componentType, [&] {
+        // Check cancellation
+        progressHandler.notifyProgress();
+    });
     // Prepare source and destination contents for further processing
     std::swap(sourceContents, destinationContents);
-#undef resample_y_func
     
     
     // Depth pass if needed
@@ -1536,10 +2983,11 @@ for (auto z = 0; z < _depth; z++) { \
     _width = width;
     _height = height;
     _depth = depth;
+    _setBytesPerRow(0);
     
     // Reduce buffer size if needed
     if (targetSize < currentSize) {
-        _contents = reinterpret_cast<char*>(std::realloc(_contents, targetSize));
+        _resizeContents(currentSize, targetSize);
     }
     
     // Convert back colour profile if needed
@@ -1550,7 +2998,7 @@ for (auto z = 0; z < _depth; z++) { \
     }
     
     // Clean up
-    std::free(tmpBuffer);
+    _releaseContents(intermediateContents);
     LCMSColorProfileRelease(linearProfile);
     
     // Notify callback
@@ -1560,145 +3008,128 @@ for (auto z = 0; z < _depth; z++) { \
 }
 
 
-void ImageContainer::_sRGBToLinear(bool preserveAlpha) {
-    LCMSColorProfileRelease(_colorProfile);
-    _colorProfile = nullptr;
-    _sRGB = false;
-    
-    auto numPixels = _width * _height * _depth;
-    auto totalComponents = _width * _height * _depth * _pixelFormat.numComponents;
-    
-    if (_pixelFormat.componentType == PixelComponentType::uint8) {
-        uint8_t* uintData = reinterpret_cast<uint8_t*>(_contents);
-        
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-#if USE_UINT8_TABLE
-                uintData[0] = uint8Table[uintData[0]].linear;
-                uintData[1] = uint8Table[uintData[1]].linear;
-                uintData[2] = uint8Table[uintData[2]].linear;
-#else
-                auto r = static_cast<float>(uintData[0]) / std::numeric_limits<uint8_t>::max();
-                auto g = static_cast<float>(uintData[1]) / std::numeric_limits<uint8_t>::max();
-                auto b = static_cast<float>(uintData[2]) / std::numeric_limits<uint8_t>::max();
-                
-                r = fromSRGBToLinear(r);
-                g = fromSRGBToLinear(g);
-                b = fromSRGBToLinear(b);
-                
-                uintData[0] = static_cast<uint8_t>(std::min(255.0f, r * std::numeric_limits<uint8_t>::max()));
-                uintData[1] = static_cast<uint8_t>(std::min(255.0f, g * std::numeric_limits<uint8_t>::max()));
-                uintData[2] = static_cast<uint8_t>(std::min(255.0f, b * std::numeric_limits<uint8_t>::max()));
-#endif
-                
-                uintData += 4;
-            }
+/// Applies a transfer function to colour components of pixels, leaving the alpha component untouched if `numColorComponents` is smaller than `numComponents`.
+template <typename Type, typename Transfer>
+static inline void _applyTransfer(Type* fn_nonnull values, long numPixels, long numComponents, long numColorComponents, Transfer transfer) {
+    if (numColorComponents == numComponents) {
+        auto count = numPixels * numComponents;
+        long index = 0;
+        for (; index + 4 <= count; index += 4) {
+            auto v0 = transfer(values[index + 0]);
+            auto v1 = transfer(values[index + 1]);
+            auto v2 = transfer(values[index + 2]);
+            auto v3 = transfer(values[index + 3]);
+            values[index + 0] = v0;
+            values[index + 1] = v1;
+            values[index + 2] = v2;
+            values[index + 3] = v3;
         }
-        else {
-            for (auto index = 0; index < totalComponents; index++) {
-#if USE_UINT8_TABLE
-                *uintData = uint8Table[*uintData].linear;
-#else
-                auto c = static_cast<float>(*uintData) / std::numeric_limits<uint8_t>::max();
-                c = fromSRGBToLinear(c);
-                *uintData = static_cast<uint8_t>(std::min(255.0f, c * std::numeric_limits<uint8_t>::max()));
-#endif
-                uintData += 1;
-            }
+        for (; index < count; index++) {
+            values[index] = transfer(values[index]);
         }
-        
         return;
     }
     
-    
-    if (_pixelFormat.componentType == PixelComponentType::float16) {
-        _Float16* halfData = reinterpret_cast<_Float16*>(_contents);
-        
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-                halfData[0] = fromSRGBToLinear(halfData[0]);
-                halfData[1] = fromSRGBToLinear(halfData[1]);
-                halfData[2] = fromSRGBToLinear(halfData[2]);
-                halfData += 4;
-            }
-        }
-        else {
-            for (auto index = 0; index < totalComponents; index++) {
-                *halfData = fromSRGBToLinear(*halfData);
-                halfData += 1;
-            }
+    if (numComponents == 4) {
+        for (long index = 0; index < numPixels; index++) {
+            values[0] = transfer(values[0]);
+            values[1] = transfer(values[1]);
+            values[2] = transfer(values[2]);
+            values += 4;
         }
-        
         return;
     }
     
+    if (numComponents == 2) {
+        for (long index = 0; index < numPixels; index++) {
+            values[0] = transfer(values[0]);
+            values += 2;
+        }
+        return;
+    }
     
-    if (_pixelFormat.componentType == PixelComponentType::float32) {
-        float* floatData = reinterpret_cast<float*>(_contents);
-        
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-                floatData[0] = fromSRGBToLinear(floatData[0]);
-                floatData[1] = fromSRGBToLinear(floatData[1]);
-                floatData[2] = fromSRGBToLinear(floatData[2]);
-                floatData += 4;
-            }
+    for (long index = 0; index < numPixels; index++) {
+        for (auto i = 0; i < numColorComponents; i++) {
+            values[i] = transfer(values[i]);
         }
-        else {
-            for (auto index = 0; index < totalComponents; index++) {
-                *floatData = fromSRGBToLinear(*floatData);
-                floatData += 1;
-            }
+        values += numComponents;
+    }
+}
+
+
+void ImageContainer::_applyTransferFunction(bool toLinear, bool preserveAlpha) {
+    auto componentType = _pixelFormat.componentType;
+    auto numComponents = _pixelFormat.numComponents;
+    auto numColorComponents = (preserveAlpha && _pixelFormat.hasAlpha) ? numComponents - 1 : numComponents;
+    
+    if (componentType == PixelComponentType::uint8) {
+        // Gather a compact table for the direction, pixels are converted with a single lookup
+        uint8_t table[256];
+        for (auto i = 0; i < 256; i++) {
+#if USE_UINT8_TABLE
+            table[i] = toLinear ? uint8Table[i].linear : uint8Table[i].srgb;
+#else
+            auto c = static_cast<float>(i) / std::numeric_limits<uint8_t>::max();
+            c = toLinear ? fromSRGBToLinear(c) : fromLinearToSRGB(c);
+            table[i] = static_cast<uint8_t>(std::min(255.0f, c * std::numeric_limits<uint8_t>::max()));
+#endif
         }
         
+        CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+            long numRunPixels = 0;
+            auto uintData = reinterpret_cast<uint8_t*>(_getPixelRun(run, &numRunPixels));
+            _applyTransfer(uintData, numRunPixels, numComponents, numColorComponents, [&table](uint8_t value) { return table[value]; });
+        } CONCURRENT_LOOP_END
         return;
     }
     
+    if (componentType == PixelComponentType::float16) {
+        // Every half float value is looked up in the table
+        auto table = toLinear ? getFloat16SRGBTable().linear : getFloat16SRGBTable().srgb;
+        CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+            long numRunPixels = 0;
+            auto halfData = reinterpret_cast<_Float16*>(_getPixelRun(run, &numRunPixels));
+            applyFloat16SRGBTable(table, halfData, numRunPixels, numComponents, numColorComponents);
+        } CONCURRENT_LOOP_END
+        return;
+    }
     
-    // General case. This actually should never happen, since every possible component type was processed earlier
-    for (auto z = 0; z < _depth; z++) {
-#if 0
-        struct Context {
-            ImageContainer* imageContainer;
-            long z;
-            bool preserveAlpha;
-        };
-        processConcurrently<Context>({
-            .imageContainer = this,
-            .z = z,
-            .preserveAlpha = preserveAlpha
-        }, 0, _height, [](Context& context, long y) {
-            auto img = context.imageContainer;
-            auto z = context.z;
-            auto preserveAlpha = context.preserveAlpha;
-            auto width = context.imageContainer->_width;
-            
-            for (auto x = 0; x < width; x++) {
-                auto pixel = img->getPixel(x, y, z);
-                pixel.r = fromSRGBToLinear(pixel.r);
-                pixel.g = fromSRGBToLinear(pixel.g);
-                pixel.b = fromSRGBToLinear(pixel.b);
-                if (!preserveAlpha) {
-                    pixel.a = fromSRGBToLinear(pixel.a);
-                }
-                img->_setPixel(pixel, x, y, z);
-            }
-        });
-#else
-        CONCURRENT_LOOP_START(0, _height, y) {
-            for (auto x = 0; x < _width; x++) {
-                auto pixel = getPixel(x, y, z);
-                pixel.r = fromSRGBToLinear(pixel.r);
-                pixel.g = fromSRGBToLinear(pixel.g);
-                pixel.b = fromSRGBToLinear(pixel.b);
-                if (!preserveAlpha) {
-                    pixel.a = fromSRGBToLinear(pixel.a);
-                }
-                _setPixel(pixel, x, y, z);
-            }
+    if (componentType == PixelComponentType::float32) {
+        // Vectorized approximation of the transfer function
+        auto transfer = getSRGBTransferKernel(toLinear);
+        CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+            long numRunPixels = 0;
+            auto floatData = reinterpret_cast<float*>(_getPixelRun(run, &numRunPixels));
+            transfer(floatData, numRunPixels, numComponents, numColorComponents);
         } CONCURRENT_LOOP_END
-#endif
+        return;
     }
+    
+    // 16 and 32-bit integers are converted through float
+    CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+        long numRunPixels = 0;
+        auto runData = _getPixelRun(run, &numRunPixels);
+        auto transfer = [toLinear](float value) { return toLinear ? fromSRGBToLinear(value) : fromLinearToSRGB(value); };
+        if (componentType == PixelComponentType::uint16) {
+            _applyTransfer(reinterpret_cast<uint16_t*>(runData), numRunPixels, numComponents, numColorComponents, [&](uint16_t value) {
+                return _fromFloat<uint16_t>(transfer(_toFloat(value)));
+            });
+        }
+        else {
+            _applyTransfer(reinterpret_cast<uint32_t*>(runData), numRunPixels, numComponents, numColorComponents, [&](uint32_t value) {
+                return _fromFloat<uint32_t>(transfer(_toFloat(value)));
+            });
+        }
+    } CONCURRENT_LOOP_END
+}
+
+
+void ImageContainer::_sRGBToLinear(bool preserveAlpha) {
+    LCMSColorProfileRelease(_colorProfile);
+    _colorProfile = nullptr;
+    _sRGB = false;
+    
+    _applyTransferFunction(true, preserveAlpha);
 }
 
 
@@ -1709,127 +3140,166 @@ void ImageContainer::_linearToSRGB(bool preserveAlpha) {
     
     //printUInt8Table();
     
-    auto numPixels = _width * _height * _depth;
-    auto totalComponents = _width * _height * _depth * _pixelFormat.numComponents;
+    _applyTransferFunction(false, preserveAlpha);
+}
+
+
+/// Number of pixels converted to float at once while applying a lookup table to other component types.
+static constexpr long _colorLUTBlockLength = 256;
+
+
+bool ImageContainer::_applyColorLUT(const ColorLUT* fn_nonnull lut, ColorLUTInterpolation interpolation, bool linearize, ImageToolsError* fn_nullable error fn_noescape) {
+    auto numComponents = _pixelFormat.numComponents;
+    if (numComponents < 3) {
+        ImageToolsError::set(error, "Colour lookup tables need at least 3 components");
+        return false;
+    }
     
-    if (_pixelFormat.componentType == PixelComponentType::uint8) {
-        uint8_t* uintData = reinterpret_cast<uint8_t*>(_contents);
+    auto componentType = _pixelFormat.componentType;
+    auto numColorComponents = _pixelFormat.hasAlpha ? numComponents - 1 : numComponents;
+    auto pixelSize = _pixelFormat.getSize();
+    auto toFloat = getComponentConversionKernel(componentType, PixelComponentType::float32);
+    auto fromFloat = getComponentConversionKernel(PixelComponentType::float32, componentType);
+    auto transfer = getSRGBTransferKernel(true);
+    
+    CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+        long numRunPixels = 0;
+        auto runData = _getPixelRun(run, &numRunPixels);
         
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-#if USE_UINT8_TABLE
-                uintData[0] = uint8Table[uintData[0]].srgb;
-                uintData[1] = uint8Table[uintData[1]].srgb;
-                uintData[2] = uint8Table[uintData[2]].srgb;
-#else
-                auto r = static_cast<float>(uintData[0]) / std::numeric_limits<uint8_t>::max();
-                auto g = static_cast<float>(uintData[1]) / std::numeric_limits<uint8_t>::max();
-                auto b = static_cast<float>(uintData[2]) / std::numeric_limits<uint8_t>::max();
-                
-                r = fromLinearToSRGB(r);
-                g = fromLinearToSRGB(g);
-                b = fromLinearToSRGB(b);
-                
-                uintData[0] = static_cast<uint8_t>(std::min(255.0f, r * std::numeric_limits<uint8_t>::max()));
-                uintData[1] = static_cast<uint8_t>(std::min(255.0f, g * std::numeric_limits<uint8_t>::max()));
-                uintData[2] = static_cast<uint8_t>(std::min(255.0f, b * std::numeric_limits<uint8_t>::max()));
-#endif
-                
-                uintData += 4;
+        if (componentType == PixelComponentType::float32) {
+            auto values = reinterpret_cast<float*>(runData);
+            lut->_apply(values, numRunPixels, numComponents, interpolation);
+            if (linearize) {
+                transfer(values, numRunPixels, numComponents, numColorComponents);
             }
         }
         else {
-            for (auto index = 0; index < totalComponents; index++) {
-#if USE_UINT8_TABLE
-                *uintData = uint8Table[*uintData].srgb;
-#else
-                auto c = static_cast<float>(*uintData) / std::numeric_limits<uint8_t>::max();
-                c = fromLinearToSRGB(c);
-                *uintData = static_cast<uint8_t>(std::min(255.0f, c * std::numeric_limits<uint8_t>::max()));
-#endif
-                uintData += 1;
+            // Other component types are converted through float in small blocks
+            float values[_colorLUTBlockLength * 4];
+            for (long first = 0; first < numRunPixels; first += _colorLUTBlockLength) {
+                auto count = std::min(_colorLUTBlockLength, numRunPixels - first);
+                auto pixels = runData + first * pixelSize;
+                toFloat(pixels, reinterpret_cast<char*>(values), count * numComponents);
+                lut->_apply(values, count, numComponents, interpolation);
+                if (linearize) {
+                    transfer(values, count, numComponents, numColorComponents);
+                }
+                fromFloat(reinterpret_cast<const char*>(values), pixels, count * numComponents);
             }
         }
-        
-        return;
+    } CONCURRENT_LOOP_END
+    
+    if (linearize) {
+        LCMSColorProfileRelease(_colorProfile);
+        _colorProfile = nullptr;
+        _sRGB = false;
     }
     
+    return true;
+}
+
+
+/// Number of pixels tone mapped at once.
+static constexpr long _toneMappingBlockLength = 256;
+
+
+void ImageContainer::_toneMap(ToneMappingOperator toneMappingOperator, float exposure, bool dither) {
+    // Integer pixels are tone mapped through float
+    auto componentType = _pixelFormat.componentType;
+    if (componentType != PixelComponentType::float16 && componentType != PixelComponentType::float32) {
+        _setComponentType(PixelComponentType::float32);
+        componentType = PixelComponentType::float32;
+    }
     
-    if (_pixelFormat.componentType == PixelComponentType::float16) {
-        _Float16* halfData = reinterpret_cast<_Float16*>(_contents);
-        
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-                halfData[0] = fromLinearToSRGB(halfData[0]);
-                halfData[1] = fromLinearToSRGB(halfData[1]);
-                halfData[2] = fromLinearToSRGB(halfData[2]);
-                halfData += 4;
-            }
-        }
-        else {
-            for (auto index = 0; index < totalComponents; index++) {
-                *halfData = fromLinearToSRGB(*halfData);
-                halfData += 1;
-            }
-        }
-        
-        return;
+    // Operators expect linear values with sRGB primaries
+    auto sRGBProfile = createSharedSRGBColorProfile();
+    if (_colorProfile) {
+        auto linearProfile = createSharedLinearColorProfile(sRGBProfile);
+        _convertColorProfile(linearProfile);
+        LCMSColorProfileRelease(linearProfile);
+    }
+    else if (_sRGB) {
+        _applyTransferFunction(true, true);
     }
     
+    // Pixel runs of packed contents map to the same pixels of the packed destination
+    _pack();
     
-    if (_pixelFormat.componentType == PixelComponentType::float32) {
-        float* floatData = reinterpret_cast<float*>(_contents);
+    auto numComponents = _pixelFormat.numComponents;
+    auto numColorComponents = _pixelFormat.hasAlpha ? numComponents - 1 : numComponents;
+    auto pixelSize = _pixelFormat.getSize();
+    auto toFloat = getComponentConversionKernel(componentType, PixelComponentType::float32);
+    auto encode = getSRGBTransferKernel(false);
+    auto exposureScale = exp2f(exposure);
+    
+    auto newBuffer = _allocateContents(_width * _height * _depth * numComponents);
+    auto newContents = reinterpret_cast<uint8_t*>(newBuffer.contents);
+    
+    CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+        long numRunPixels = 0;
+        auto runData = _getPixelRun(run, &numRunPixels);
         
-        if (_pixelFormat.numComponents == 4 && preserveAlpha) {
-            for (auto index = 0; index < numPixels; index++) {
-                floatData[0] = fromLinearToSRGB(floatData[0]);
-                floatData[1] = fromLinearToSRGB(floatData[1]);
-                floatData[2] = fromLinearToSRGB(floatData[2]);
-                floatData += 4;
-            }
-        }
-        else {
-            for (auto index = 0; index < totalComponents; index++) {
-                *floatData = fromLinearToSRGB(*floatData);
-                floatData += 1;
-            }
+        float values[_toneMappingBlockLength * 4];
+        for (long first = 0; first < numRunPixels; first += _toneMappingBlockLength) {
+            auto count = std::min(_toneMappingBlockLength, numRunPixels - first);
+            auto pixelIndex = run * _pixelRunLength + first;
+            toFloat(runData + first * pixelSize, reinterpret_cast<char*>(values), count * numComponents);
+            applyToneMapping(toneMappingOperator, exposureScale, values, count, numComponents, numColorComponents);
+            encode(values, count, numComponents, numColorComponents);
+            quantizeToUInt8(values, newContents + pixelIndex * numComponents, count, numComponents, numColorComponents, dither, pixelIndex);
         }
-        
-        return;
-    }
+    } CONCURRENT_LOOP_END
     
-    // General case. This actually should never happen, since every possible component type was processed earlier
-    for (auto z = 0; z < _depth; z++) {
-        CONCURRENT_LOOP_START(0, _height, y) {
-            for (auto x = 0; x < _width; x++) {
-                auto pixel = getPixel(x, y, z);
-                pixel.r = fromLinearToSRGB(pixel.r);
-                pixel.g = fromLinearToSRGB(pixel.g);
-                pixel.b = fromLinearToSRGB(pixel.b);
-                _setPixel(pixel, x, y, z);
-            }
-        } CONCURRENT_LOOP_END
-    }
+    // Apply changes, the new buffer has tightly packed rows
+    _pixelFormat.componentType = PixelComponentType::uint8;
+    _replaceContents(newBuffer);
+    _setBytesPerRow(0);
+    _assignColorProfile(sRGBProfile);
+    _sRGB = true;
+    _hdr = false;
     
+    LCMSColorProfileRelease(sRGBProfile);
 }
 
 
 ImagePixel ImageContainer::getPixel(long x, long y, long z) {
-    return _getPixel(x, y, z, _pixelFormat.numComponents, _pixelFormat.componentType);
+    _ensureDecoded();
+    return _getPixel(x, y, z);
 }
 
 
 ImageContainer* fn_nonnull ImageContainer::copy() {
+    _ensureDecoded();
+    
     // Copy contents
-    auto contentsCopySize = _width * _height * _depth * _pixelFormat.getSize();
-    auto contentsCopy = reinterpret_cast<char*>(std::malloc(contentsCopySize));
-    std::memcpy(contentsCopy, _contents, contentsCopySize);
+    // Copies of file-backed images are file-backed too, row padding is preserved except for views
+    auto bytesPerRow = getIsView() ? 0 : _bytesPerRow;
+    auto contentsCopySize = std::max(bytesPerRow, _width * _pixelFormat.getSize()) * _height * _depth;
+    auto contentsCopy = _allocateContents(contentsCopySize);
     
     // Retain ICC profile
     auto colorProfile = LCMSColorProfileRetain(_colorProfile);
     
     // Create a new ImageContainer instance
-    return new ImageContainer(_pixelFormat, colorProfile, _sRGB, _hdr, contentsCopy, _width, _height, _depth);
+    auto image = new ImageContainer(_pixelFormat, colorProfile, _sRGB, _hdr, contentsCopy.contents, _width, _height, _depth);
+    image->_contentsRelease = contentsCopy.release;
+    image->_contentsReleaseUserInfo = contentsCopy.releaseUserInfo;
+    image->_setBytesPerRow(bytesPerRow);
+    _copyContents(image);
+    return image;
+}
+
+
+ImageContainer* fn_nullable ImageContainer::copyToFile(const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    _ensureDecoded();
+    
+    auto image = createFileBacked(_pixelFormat, _colorProfile, _sRGB, _hdr, _width, _height, _depth, path, error);
+    if (image == nullptr) {
+        return nullptr;
+    }
+    
+    _copyContents(image);
+    return image;
 }
 
 
@@ -1879,6 +3349,168 @@ long ImageContainer::calculateMipLevelCount() {
 }
 
 
+// MARK: - Statistics
+
+/// Number of pixels converted to float at once while calculating statistics.
+static constexpr long _statisticsBlockLength = 256;
+
+
+/// Partial statistics of one component, merged using Chan's parallel variance algorithm.
+struct ComponentMoments {
+    long count = 0;
+    double mean = 0;
+    
+    /// Sum of squared differences from the mean.
+    double m2 = 0;
+    
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    long numNaNs = 0;
+    long numInfinities = 0;
+    
+    void merge(const ComponentMoments& other) {
+        numNaNs += other.numNaNs;
+        numInfinities += other.numInfinities;
+        if (other.count == 0) {
+            return;
+        }
+        
+        auto total = count + other.count;
+        auto delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * count * other.count / total;
+        count = total;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+
+/// Reduces one component of a block of float pixels. The mean is subtracted per block, so variance stays precise for large images.
+template<bool checkFinite>
+static void _reduceComponent(const float* fn_nonnull values, long numPixels, long numComponents, long component, ComponentMoments& moments, long* fn_nullable histogram, long numBins, float histogramMin, float binScale) {
+    auto block = ComponentMoments();
+    double sum = 0;
+    for (long i = 0; i < numPixels; i++) {
+        auto value = values[i * numComponents + component];
+        if constexpr (checkFinite) {
+            if (std::isnan(value)) {
+                block.numNaNs++;
+                continue;
+            }
+            if (std::isinf(value)) {
+                block.numInfinities++;
+                continue;
+            }
+        }
+        
+        sum += value;
+        block.min = std::min(block.min, value);
+        block.max = std::max(block.max, value);
+        block.count++;
+        
+        if (histogram) {
+            auto bin = std::min(static_cast<float>(numBins - 1), std::max(0.0f, (value - histogramMin) * binScale));
+            histogram[static_cast<long>(bin)]++;
+        }
+    }
+    
+    if (block.count > 0) {
+        block.mean = sum / block.count;
+        for (long i = 0; i < numPixels; i++) {
+            auto value = values[i * numComponents + component];
+            if (checkFinite && std::isfinite(value) == false) {
+                continue;
+            }
+            auto difference = value - block.mean;
+            block.m2 += difference * difference;
+        }
+    }
+    
+    moments.merge(block);
+}
+
+
+bool ImageContainer::calculateStatistics(ImageChannelStatistics* fn_nonnull statistics, long* fn_nullable histograms, long numBins, float histogramMin, float histogramMax, ImageToolsError* fn_nullable error fn_noescape) {
+    if (histograms && numBins < 1) {
+        ImageToolsError::set(error, "Number of histogram bins has to be positive");
+        return false;
+    }
+    if (histograms && (histogramMax > histogramMin) == false) {
+        ImageToolsError::set(error, "Histogram range is empty");
+        return false;
+    }
+    
+    _ensureDecoded();
+    
+    auto numComponents = _pixelFormat.numComponents;
+    auto componentType = _pixelFormat.componentType;
+    auto pixelSize = _pixelFormat.getSize();
+    auto toFloat = getComponentConversionKernel(componentType, PixelComponentType::float32);
+    auto floatingPoint = componentType == PixelComponentType::float16 || componentType == PixelComponentType::float32;
+    auto binScale = histograms ? static_cast<float>(numBins) / (histogramMax - histogramMin) : 0.0f;
+    auto histogramsSize = histograms ? numComponents * numBins : 0;
+    
+    // Runs are reduced independently and merged one at a time
+    std::mutex mutex;
+    ComponentMoments totals[4];
+    std::fill_n(histograms, histogramsSize, 0l);
+    
+    CONCURRENT_LOOP_START(0, _getNumPixelRuns(), run) {
+        long numRunPixels = 0;
+        auto runData = _getPixelRun(run, &numRunPixels);
+        
+        ComponentMoments moments[4];
+        auto runHistograms = std::vector<long>(histogramsSize);
+        float values[_statisticsBlockLength * 4];
+        for (long first = 0; first < numRunPixels; first += _statisticsBlockLength) {
+            auto count = std::min(_statisticsBlockLength, numRunPixels - first);
+            auto blockValues = values;
+            if (componentType == PixelComponentType::float32) {
+                blockValues = reinterpret_cast<float*>(runData + first * pixelSize);
+            }
+            else {
+                toFloat(runData + first * pixelSize, reinterpret_cast<char*>(values), count * numComponents);
+            }
+            
+            for (long component = 0; component < numComponents; component++) {
+                auto histogram = histograms ? runHistograms.data() + component * numBins : nullptr;
+                if (floatingPoint) {
+                    _reduceComponent<true>(blockValues, count, numComponents, component, moments[component], histogram, numBins, histogramMin, binScale);
+                }
+                else {
+                    _reduceComponent<false>(blockValues, count, numComponents, component, moments[component], histogram, numBins, histogramMin, binScale);
+                }
+            }
+        }
+        
+        std::lock_guard lock(mutex);
+        for (long component = 0; component < numComponents; component++) {
+            totals[component].merge(moments[component]);
+        }
+        for (long i = 0; i < histogramsSize; i++) {
+            histograms[i] += runHistograms[i];
+        }
+    } CONCURRENT_LOOP_END
+    
+    for (long component = 0; component < numComponents; component++) {
+        auto& total = totals[component];
+        auto empty = total.count == 0;
+        statistics[component] = ImageChannelStatistics {
+            .numValues = total.count,
+            .min = empty ? 0.0f : total.min,
+            .max = empty ? 0.0f : total.max,
+            .mean = total.mean,
+            .variance = empty ? 0.0 : total.m2 / total.count,
+            .numNaNs = total.numNaNs,
+            .numInfinities = total.numInfinities
+        };
+    }
+    
+    return true;
+}
+
+
 //void ImageContainer::generateCubeMap() {
 //    // https://stackoverflow.com/questions/29678510/convert-21-equirectangular-panorama-to-cube-map
 //}
@@ -1886,15 +3518,25 @@ long ImageContainer::calculateMipLevelCount() {
 
 
 ASTCImage* fn_nullable ImageContainer::createASTCCompressed(ASTCBlockSize blockSize, float quality, bool containsAlpha, bool ldrAlpha, bool normalMap, void* fn_nullable userInfo fn_noescape, ASTCEncoderProgressCallback fn_nullable progressCallback fn_noescape) {
+    _ensureDecoded();
+    
     // Handle errors
     auto error = ASTCError();
     
     // Create an image to compress
     auto integerComponents = _pixelFormat.componentType == PixelComponentType::uint8;
     auto linear = _colorProfile == nullptr && _sRGB == false;
-    auto rawImage = ASTCRawImage::create(_contents, _width, _height, _depth, _pixelFormat.numComponents, _pixelFormat.getComponentSize(), integerComponents, true, linear, _hdr, containsAlpha, ldrAlpha, normalMap, error);
+    // The encoder expects tightly packed pixels with 8-bit integer or floating point components, ASTC keeps less precision than 16-bit integers anyway
+    auto wideIntegers = _pixelFormat.componentType == PixelComponentType::uint16 || _pixelFormat.componentType == PixelComponentType::uint32;
+    auto packedImage = (getIsPacked() && wideIntegers == false) ? ImageContainerRetain(this) : copy();
+    packedImage->_pack();
+    if (wideIntegers) {
+        packedImage->_setComponentType(PixelComponentType::float16);
+    }
+    auto rawImage = ASTCRawImage::create(packedImage->_contents, _width, _height, _depth, _pixelFormat.numComponents, packedImage->_pixelFormat.getComponentSize(), integerComponents, true, linear, _hdr, containsAlpha, ldrAlpha, normalMap, error);
     if (rawImage == nullptr) {
         //printf("Could not create an ASTCRawImage: %s\n", error.getErrorMessage());
+        ImageContainerRelease(packedImage);
         return nullptr;
     }
     
@@ -1903,11 +3545,13 @@ ASTCImage* fn_nullable ImageContainer::createASTCCompressed(ASTCBlockSize blockS
     if (rawImage == nullptr) {
         //printf("Could not compress an ASTCRawImage: %s\n", error.getErrorMessage());
         ASTCRawImageRelease(rawImage);
+        ImageContainerRelease(packedImage);
         return nullptr;
     }
     
     // Clean up
     ASTCRawImageRelease(rawImage);
+    ImageContainerRelease(packedImage);
     
     return astcImage;
 }
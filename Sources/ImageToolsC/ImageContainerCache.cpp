@@ -0,0 +1,196 @@
+//
+//  ImageContainerCache.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImageContainerCache.hpp>
+#include "ColorProfiles.hpp"
+#include <sys/stat.h>
+
+
+ImageContainerCache::ImageContainerCache(long maxBytes):
+_referenceCounter(1),
+_mutex(),
+_condition(),
+_maxBytes(maxBytes),
+_usedBytes(0),
+_recentlyUsed(),
+_entries(),
+_pendingLoads() {
+    //
+}
+
+
+ImageContainerCache::~ImageContainerCache() {
+    for (auto& [key, entry]: _entries) {
+        ImageContainerRelease(entry.image);
+    }
+}
+
+
+ImageContainerCache* fn_nonnull ImageContainerCache::create(long maxBytes) {
+    return new ImageContainerCache(std::max(0l, maxBytes));
+}
+
+
+long ImageContainerCache::getMaxBytes() {
+    std::lock_guard lock(_mutex);
+    return _maxBytes;
+}
+
+
+void ImageContainerCache::setMaxBytes(long maxBytes) {
+    std::lock_guard lock(_mutex);
+    _maxBytes = std::max(0l, maxBytes);
+    _evict(_maxBytes);
+}
+
+
+long ImageContainerCache::getUsedBytes() {
+    std::lock_guard lock(_mutex);
+    return _usedBytes;
+}
+
+
+long ImageContainerCache::getNumImages() {
+    std::lock_guard lock(_mutex);
+    return static_cast<long>(_entries.size());
+}
+
+
+void ImageContainerCache::_evict(long maxBytes) {
+    while (_usedBytes > maxBytes && _recentlyUsed.empty() == false) {
+        auto entry = _entries.find(_recentlyUsed.back());
+        _usedBytes -= entry->second.size;
+        ImageContainerRelease(entry->second.image);
+        _entries.erase(entry);
+        _recentlyUsed.pop_back();
+    }
+}
+
+
+/// Key prefix shared by all images loaded from the path. Paths can't contain null characters.
+static std::string _makePathPrefix(const char* fn_nonnull path) {
+    auto prefix = std::string(path);
+    prefix.push_back('\0');
+    return prefix;
+}
+
+
+ImageContainer* fn_nullable ImageContainerCache::load(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) {
+    // A modified file gets a different key
+    struct stat attributes;
+    if (stat(path, &attributes) != 0) {
+        ImageToolsError::set(error, "Could not read file attributes");
+        return nullptr;
+    }
+    
+    // Profile pointers may be reused after the profile is released, so the key uses the shared profile's origin. Other profiles can't be identified
+    size_t profileHash = 0;
+    if (assumedColorProfile && getSharedColorProfileHash(assumedColorProfile, profileHash) == false) {
+        return ImageContainer::load(path, assumedColorProfile, assumeSRGB, error);
+    }
+    
+#if defined(__APPLE__)
+    auto modificationTime = attributes.st_mtimespec;
+#else
+    auto modificationTime = attributes.st_mtim;
+#endif
+    
+    char suffix[128];
+    snprintf(suffix, sizeof(suffix), "%lld.%09ld:%lld:%d:%d:%zx",
+             static_cast<long long>(modificationTime.tv_sec), static_cast<long>(modificationTime.tv_nsec),
+             static_cast<long long>(attributes.st_size),
+             assumeSRGB ? 1 : 0, assumedColorProfile ? 1 : 0, profileHash);
+    auto key = _makePathPrefix(path) + suffix;
+    
+    std::shared_ptr<_PendingLoad> pendingLoad;
+    {
+        std::unique_lock lock(_mutex);
+        
+        // Cache hit
+        auto entry = _entries.find(key);
+        if (entry != _entries.end()) {
+            _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed, entry->second.position);
+            return ImageContainerRetain(entry->second.image);
+        }
+        
+        // Another thread is already loading the image
+        auto pending = _pendingLoads.find(key);
+        if (pending != _pendingLoads.end()) {
+            auto sharedLoad = pending->second;
+            _condition.wait(lock, [&]() { return sharedLoad->finished; });
+            if (sharedLoad->image == nullptr && error) {
+                *error = sharedLoad->error;
+            }
+            return ImageContainerRetain(sharedLoad->image);
+        }
+        
+        pendingLoad = std::make_shared<_PendingLoad>();
+        pendingLoad->finished = false;
+        pendingLoad->image = nullptr;
+        _pendingLoads[key] = pendingLoad;
+    }
+    
+    // Decode without holding the lock
+    auto loadError = ImageToolsError();
+    auto image = ImageContainer::load(path, assumedColorProfile, assumeSRGB, &loadError);
+    
+    {
+        std::lock_guard lock(_mutex);
+        if (image) {
+            auto size = image->getContentsSize();
+            if (size <= _maxBytes) {
+                _evict(_maxBytes - size);
+                _recentlyUsed.push_front(key);
+                _entries[key] = _Entry {
+                    .image = ImageContainerRetain(image),
+                    .size = size,
+                    .position = _recentlyUsed.begin()
+                };
+                _usedBytes += size;
+            }
+        }
+        
+        // Keep the image alive until all waiting threads retain it
+        pendingLoad->finished = true;
+        pendingLoad->image = ImageContainerRetain(image);
+        pendingLoad->error = loadError;
+        _pendingLoads.erase(key);
+    }
+    _condition.notify_all();
+    
+    if (image == nullptr && error) {
+        *error = loadError;
+    }
+    return image;
+}
+
+
+void ImageContainerCache::remove(const char* fn_nonnull path fn_noescape) {
+    std::lock_guard lock(_mutex);
+    auto prefix = _makePathPrefix(path);
+    for (auto key = _recentlyUsed.begin(); key != _recentlyUsed.end();) {
+        if (key->compare(0, prefix.size(), prefix) != 0) {
+            key++;
+            continue;
+        }
+        
+        auto entry = _entries.find(*key);
+        _usedBytes -= entry->second.size;
+        ImageContainerRelease(entry->second.image);
+        _entries.erase(entry);
+        key = _recentlyUsed.erase(key);
+    }
+}
+
+
+void ImageContainerCache::removeAll() {
+    std::lock_guard lock(_mutex);
+    _evict(0);
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(ImageContainerCache)
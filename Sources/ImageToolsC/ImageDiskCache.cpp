@@ -0,0 +1,479 @@
+//
+//  ImageDiskCache.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImageDiskCache.hpp>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <algorithm>
+#include <vector>
+
+
+// MARK: - ImageDiskCacheKey
+
+static constexpr uint64_t _prime1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t _prime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t _prime3 = 0x165667B19E3779F9ull;
+
+
+static inline uint64_t _rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+static inline uint64_t _round(uint64_t lane, uint64_t word) {
+    lane += word * _prime2;
+    lane = _rotateLeft(lane, 31);
+    return lane * _prime1;
+}
+
+
+static inline uint64_t _avalanche(uint64_t value) {
+    value ^= value >> 33;
+    value *= _prime2;
+    value ^= value >> 29;
+    value *= _prime3;
+    value ^= value >> 32;
+    return value;
+}
+
+
+ImageDiskCacheKey::ImageDiskCacheKey():
+_lanes { _prime1 + _prime2, _prime3 },
+_length(0) { }
+
+
+void ImageDiskCacheKey::add(const void* fn_nonnull data, long size) {
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    auto numWords = size / 8;
+    for (long i = 0; i < numWords; i++) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, 8);
+        _lanes[0] = _round(_lanes[0], word);
+        _lanes[1] = _round(_lanes[1], _rotateLeft(word, 17) ^ _prime3);
+    }
+    
+    // Remaining bytes and size separate this value from the next one
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + numWords * 8, size - numWords * 8);
+    _lanes[0] = _round(_lanes[0], tail ^ static_cast<uint64_t>(size));
+    _lanes[1] = _round(_lanes[1], _rotateLeft(tail, 17) ^ (static_cast<uint64_t>(size) * _prime1));
+    _length += size;
+}
+
+
+void ImageDiskCacheKey::add(long value) {
+    add(&value, sizeof(value));
+}
+
+
+void ImageDiskCacheKey::add(double value) {
+    add(&value, sizeof(value));
+}
+
+
+void ImageDiskCacheKey::add(bool value) {
+    uint8_t byte = value ? 1 : 0;
+    add(&byte, 1);
+}
+
+
+void ImageDiskCacheKey::add(const char* fn_nonnull string fn_noescape) {
+    add(string, static_cast<long>(strlen(string)));
+}
+
+
+bool ImageDiskCacheKey::addFile(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    auto file = fopen(path, "rb");
+    if (file == nullptr) {
+        ImageToolsError::set(error, "Could not open file");
+        return false;
+    }
+    
+    // Hash in chunks, files may be large
+    std::vector<char> buffer(1024 * 1024);
+    while (true) {
+        auto numRead = fread(buffer.data(), 1, buffer.size(), file);
+        if (numRead == 0) {
+            break;
+        }
+        add(buffer.data(), static_cast<long>(numRead));
+    }
+    
+    auto failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+        ImageToolsError::set(error, "Could not read file");
+        return false;
+    }
+    
+    return true;
+}
+
+
+void ImageDiskCacheKey::getHexString(char* fn_nonnull buffer) const {
+    auto high = _avalanche(_lanes[0] ^ _length);
+    auto low = _avalanche(_lanes[1] + _rotateLeft(_lanes[0], 7) + _length * _prime3);
+    snprintf(buffer, 33, "%016llx%016llx", static_cast<unsigned long long>(high), static_cast<unsigned long long>(low));
+}
+
+
+// MARK: - File layout
+
+// Images are stored in the native image format, see ``ImageContainer/save``.
+
+/// Header of cached data, followed by data.
+struct ImageDiskCacheDataHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t size;
+};
+
+
+// MARK: - ImageDiskCache
+
+ImageDiskCache::ImageDiskCache(const char* fn_nonnull directory, long maxBytes):
+_referenceCounter(1),
+_directory(directory),
+_mutex(),
+_maxBytes(maxBytes),
+_usedBytes(0),
+_recentlyUsed(),
+_entries() {
+    //
+}
+
+
+ImageDiskCache::~ImageDiskCache() {
+    //
+}
+
+
+ImageDiskCache* fn_nullable ImageDiskCache::create(const char* fn_nonnull directory fn_noescape, long maxBytes, ImageToolsError* fn_nullable error fn_noescape) {
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        ImageToolsError::set(error, "Could not create cache directory");
+        return nullptr;
+    }
+    
+    auto cache = new ImageDiskCache(directory, std::max(0l, maxBytes));
+    cache->_scanDirectory();
+    return cache;
+}
+
+
+long ImageDiskCache::getMaxBytes() {
+    std::lock_guard lock(_mutex);
+    return _maxBytes;
+}
+
+
+void ImageDiskCache::setMaxBytes(long maxBytes) {
+    std::lock_guard lock(_mutex);
+    _maxBytes = std::max(0l, maxBytes);
+    _evict(_maxBytes);
+}
+
+
+long ImageDiskCache::getUsedBytes() {
+    std::lock_guard lock(_mutex);
+    return _usedBytes;
+}
+
+
+/// Checks if the file name is a committed cache entry, not a temporary file.
+static bool _checkIsEntryName(const std::string& name) {
+    auto hasSuffix = [&name](const char* fn_nonnull suffix) {
+        auto length = strlen(suffix);
+        return name.size() > length && name.compare(name.size() - length, length, suffix) == 0;
+    };
+    return hasSuffix(".image") || hasSuffix(".data");
+}
+
+
+/// Checks if the file name is a temporary file of a process that doesn't exist anymore.
+static bool _checkIsStaleTemporaryName(const std::string& name) {
+    // Temporary files are named "<entry>.tmp<pid>-<counter>"
+    auto position = name.rfind(".tmp");
+    if (position == std::string::npos) {
+        return false;
+    }
+    
+    char* end = nullptr;
+    auto pid = strtol(name.c_str() + position + 4, &end, 10);
+    if (end == nullptr || *end != '-' || pid <= 0) {
+        return false;
+    }
+    
+    return pid != getpid() && kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+}
+
+
+void ImageDiskCache::_scanDirectory() {
+    struct ScannedFile {
+        std::string name;
+        long size;
+        struct timespec modificationTime;
+    };
+    std::vector<ScannedFile> files;
+    
+    auto directory = opendir(_directory.c_str());
+    if (directory == nullptr) {
+        return;
+    }
+    while (auto item = readdir(directory)) {
+        auto name = std::string(item->d_name);
+        if (_checkIsStaleTemporaryName(name)) {
+            ::remove((_directory + "/" + name).c_str());
+            continue;
+        }
+        
+        struct stat attributes;
+        if (_checkIsEntryName(name) == false || stat((_directory + "/" + name).c_str(), &attributes) != 0) {
+            continue;
+        }
+#if defined(__APPLE__)
+        auto modificationTime = attributes.st_mtimespec;
+#else
+        auto modificationTime = attributes.st_mtim;
+#endif
+        files.push_back(ScannedFile { name, static_cast<long>(attributes.st_size), modificationTime });
+    }
+    closedir(directory);
+    
+    // Loaded entries are touched, so the modification time tells the order of use
+    std::sort(files.begin(), files.end(), [](const ScannedFile& a, const ScannedFile& b) {
+        if (a.modificationTime.tv_sec != b.modificationTime.tv_sec) {
+            return a.modificationTime.tv_sec < b.modificationTime.tv_sec;
+        }
+        return a.modificationTime.tv_nsec < b.modificationTime.tv_nsec;
+    });
+    
+    std::lock_guard lock(_mutex);
+    for (auto& file: files) {
+        _recentlyUsed.push_front(file.name);
+        _entries[file.name] = _Entry { .size = file.size, .position = _recentlyUsed.begin() };
+        _usedBytes += file.size;
+    }
+    _evict(_maxBytes);
+}
+
+
+void ImageDiskCache::_recordFile(const std::string& name, long size) {
+    std::lock_guard lock(_mutex);
+    
+    // The file replaced an older version of the entry
+    auto entry = _entries.find(name);
+    if (entry != _entries.end()) {
+        _usedBytes -= entry->second.size;
+        _recentlyUsed.erase(entry->second.position);
+        _entries.erase(entry);
+    }
+    
+    _recentlyUsed.push_front(name);
+    _entries[name] = _Entry { .size = size, .position = _recentlyUsed.begin() };
+    _usedBytes += size;
+    _evict(_maxBytes);
+}
+
+
+void ImageDiskCache::_touchFile(const std::string& name) {
+    {
+        std::lock_guard lock(_mutex);
+        auto entry = _entries.find(name);
+        if (entry != _entries.end()) {
+            _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed, entry->second.position);
+        }
+    }
+    
+    // Keep the order for the next scan
+    utimes((_directory + "/" + name).c_str(), nullptr);
+}
+
+
+void ImageDiskCache::_forgetFile(const std::string& name) {
+    std::lock_guard lock(_mutex);
+    auto entry = _entries.find(name);
+    if (entry != _entries.end()) {
+        _usedBytes -= entry->second.size;
+        _recentlyUsed.erase(entry->second.position);
+        _entries.erase(entry);
+    }
+}
+
+
+void ImageDiskCache::_evict(long maxBytes) {
+    // Mapped images stay valid after their files are removed
+    while (_usedBytes > maxBytes && _recentlyUsed.empty() == false) {
+        auto& name = _recentlyUsed.back();
+        ::remove((_directory + "/" + name).c_str());
+        auto entry = _entries.find(name);
+        _usedBytes -= entry->second.size;
+        _entries.erase(entry);
+        _recentlyUsed.pop_back();
+    }
+}
+
+
+std::string ImageDiskCache::_getPath(const ImageDiskCacheKey& key, const char* fn_nonnull extension) const {
+    char name[33];
+    key.getHexString(name);
+    return _directory + "/" + name + extension;
+}
+
+
+std::string ImageDiskCache::_getName(const std::string& path) const {
+    return path.substr(_directory.size() + 1);
+}
+
+
+std::string ImageDiskCache::_getTemporaryPath(const std::string& path) {
+    static std::atomic<long> counter = 0;
+    return path + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(counter.fetch_add(1));
+}
+
+
+bool ImageDiskCache::_checkFits(long size, ImageToolsError* fn_nullable error fn_noescape) {
+    std::lock_guard lock(_mutex);
+    if (size > _maxBytes) {
+        ImageToolsError::set(error, "Entry is larger than the cache size");
+        return false;
+    }
+    
+    return true;
+}
+
+
+bool ImageDiskCache::_commitFile(const std::string& temporaryPath, const std::string& path, ImageToolsError* fn_nullable error fn_noescape) {
+    // Check the final size before replacing anything, otherwise eviction would remove all other entries and then the new one
+    struct stat attributes;
+    if (stat(temporaryPath.c_str(), &attributes) != 0 || _checkFits(static_cast<long>(attributes.st_size), error) == false) {
+        ::remove(temporaryPath.c_str());
+        return false;
+    }
+    
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        ::remove(temporaryPath.c_str());
+        ImageToolsError::set(error, "Could not write cache file");
+        return false;
+    }
+    
+    _recordFile(_getName(path), static_cast<long>(attributes.st_size));
+    return true;
+}
+
+
+bool ImageDiskCache::_writeFile(const std::string& path, const void* fn_nonnull header, long headerSize, const void* fn_nullable data, long size, ImageToolsError* fn_nullable error fn_noescape) {
+    // Write to a unique temporary file first, so nobody reads a partially written entry
+    auto temporaryPath = _getTemporaryPath(path);
+    auto file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        ImageToolsError::set(error, "Could not create cache file");
+        return false;
+    }
+    
+    auto success = fwrite(header, 1, headerSize, file) == static_cast<size_t>(headerSize);
+    if (success && data && size > 0) {
+        success = fwrite(data, 1, size, file) == static_cast<size_t>(size);
+    }
+    success = (fclose(file) == 0) && success;
+    
+    if (success == false) {
+        ::remove(temporaryPath.c_str());
+        ImageToolsError::set(error, "Could not write cache file");
+        return false;
+    }
+    
+    return _commitFile(temporaryPath, path, error);
+}
+
+
+ImageContainer* fn_nullable ImageDiskCache::loadImage(const ImageDiskCacheKey& key) {
+    // Cached contents are mapped into memory, not read
+    auto path = _getPath(key, ".image");
+    auto image = ImageContainer::open(path.c_str());
+    if (image) {
+        _touchFile(_getName(path));
+    }
+    return image;
+}
+
+
+bool ImageDiskCache::storeImage(const ImageDiskCacheKey& key, ImageContainer* fn_nonnull image, ImageToolsError* fn_nullable error fn_noescape) {
+    // Don't write images that can't fit anyway, the header is checked after writing
+    if (_checkFits(image->getContentsSize(), error) == false) {
+        return false;
+    }
+    
+    auto path = _getPath(key, ".image");
+    auto temporaryPath = _getTemporaryPath(path);
+    if (image->save(temporaryPath.c_str(), error) == false) {
+        ::remove(temporaryPath.c_str());
+        return false;
+    }
+    
+    return _commitFile(temporaryPath, path, error);
+}
+
+
+bool ImageDiskCache::loadData(const ImageDiskCacheKey& key, void* fn_nullable userInfo, ImageDiskCacheDataCallback fn_nonnull callback) {
+    auto path = _getPath(key, ".data");
+    auto file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    
+    ImageDiskCacheDataHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "ITDC", 4) != 0 || header.version != 1 || header.size == 0) {
+        fclose(file);
+        return false;
+    }
+    
+    std::vector<char> data(header.size);
+    auto success = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    if (success == false) {
+        return false;
+    }
+    
+    _touchFile(_getName(path));
+    callback(userInfo, data.data(), static_cast<long>(data.size()));
+    return true;
+}
+
+
+bool ImageDiskCache::storeData(const ImageDiskCacheKey& key, const void* fn_nonnull data, long size, ImageToolsError* fn_nullable error fn_noescape) {
+    if (size <= 0) {
+        ImageToolsError::set(error, "Data is empty");
+        return false;
+    }
+    
+    if (_checkFits(static_cast<long>(sizeof(ImageDiskCacheDataHeader)) + size, error) == false) {
+        return false;
+    }
+    
+    auto header = ImageDiskCacheDataHeader {
+        .magic = { 'I', 'T', 'D', 'C' },
+        .version = 1,
+        .size = static_cast<uint64_t>(size)
+    };
+    return _writeFile(_getPath(key, ".data"), &header, sizeof(header), data, size, error);
+}
+
+
+void ImageDiskCache::remove(const ImageDiskCacheKey& key) {
+    for (auto extension: { ".image", ".data" }) {
+        auto path = _getPath(key, extension);
+        ::remove(path.c_str());
+        _forgetFile(_getName(path));
+    }
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(ImageDiskCache)
@@ -21,8 +21,21 @@ ImageEditor::~ImageEditor() {
 }
 
 
+void ImageEditor::_prepareForEditing() {
+    if (_image->_checkIsUniquelyReferenced()) {
+        return;
+    }
+    
+    auto imageCopy = _image->copy();
+    ImageContainerRelease(_image);
+    _image = imageCopy;
+}
+
+
 ImageEditor* fn_nonnull ImageEditor::create(ImageContainer* fn_nonnull image) {
-    return new ImageEditor(image->copy());
+    // Contents are copied on first modification
+    image->_ensureDecoded();
+    return new ImageEditor(ImageContainerRetain(image));
 }
 
 
@@ -63,13 +76,15 @@ void ImageEditor::edit(ImageContainer* fn_nonnull image) {
         return;
     }
     
+    image->_ensureDecoded();
+    ImageContainerRetain(image);
     ImageContainerRelease(_image);
-    _image = image->copy();
+    _image = image;
 }
 
 
 ImageContainer* fn_nonnull ImageEditor::getImageCopy() {
-    return _image->copy();
+    return ImageContainerRetain(_image);
 }
 
 
@@ -97,6 +112,7 @@ bool ImageEditor::getSRGB() const {
 }
 
 void ImageEditor::setSRGB(bool value) {
+    _prepareForEditing();
     _image->_sRGB = value;
 }
 
@@ -105,6 +121,7 @@ bool ImageEditor::getHDR() const {
 }
 
 void ImageEditor::setHDR(bool value) {
+    _prepareForEditing();
     _image->_hdr = value;
 }
 
@@ -120,11 +137,13 @@ ImagePixelFormat ImageEditor::getPixelFormat() SWIFT_COMPUTED_PROPERTY {
 
 
 void ImageEditor::setComponentType(PixelComponentType componentType) {
+    _prepareForEditing();
     _image->_setComponentType(componentType);
 }
 
 
 bool ImageEditor::setNumComponents(long numComponents, float fill, ImageToolsError* fn_nullable error fn_noescape) {
+    _prepareForEditing();
     return _image->_setNumComponents(numComponents, fill, error);
 }
 
@@ -135,6 +154,7 @@ ImagePixel ImageEditor::getPixel(long x, long y, long z) {
 
 
 void ImageEditor::setPixel(ImagePixel pixel, long x, long y, long z) {
+    _prepareForEditing();
     _image->_setPixel(pixel, x, y, z);
 }
 
@@ -145,6 +165,7 @@ bool ImageEditor::setChannel(long channelIndex, ImageContainer* fn_nonnull sourc
         return false;
     }
     
+    _prepareForEditing();
     return _image->_setChannel(channelIndex, sourceImage, sourceChannelIndex, error);
 }
 
@@ -155,6 +176,7 @@ bool ImageEditor::setChannel(long channelIndex, ImageEditor* fn_nonnull sourceEd
         return false;
     }
     
+    _prepareForEditing();
     return _image->_setChannel(channelIndex, sourceEditor->_image, sourceChannelIndex, error);
 }
 
@@ -165,11 +187,13 @@ LCMSColorProfile* fn_nullable ImageEditor::getColorProfile() SWIFT_COMPUTED_PROP
 
 
 void ImageEditor::setColorProfile(LCMSColorProfile* fn_nullable colorProfile) SWIFT_COMPUTED_PROPERTY {
+    _prepareForEditing();
     _image->_assignColorProfile(colorProfile);
 }
 
 
 bool ImageEditor::convertColorProfile(LCMSColorProfile* fn_nullable colorProfile) {
+    _prepareForEditing();
     return _image->_convertColorProfile(colorProfile);
 }
 
@@ -180,22 +204,38 @@ long ImageEditor::calculateMipLevelCount() {
 
 
 void ImageEditor::resample(ResamplingAlgorithm algorithm, float quality, long width, long height, long depth, bool renormalize, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    _prepareForEditing();
     _image->_resample(algorithm, quality, width, height, depth, renormalize, userInfo, progressCallback);
 }
 
 
 void ImageEditor::downsample(ResamplingAlgorithm algorithm, float quality, bool renormalize, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    _prepareForEditing();
     _image->_resample(algorithm, quality, _image->_width / 2, _image->_height / 2, _image->_depth / 2, renormalize, userInfo, progressCallback);
 }
 
 
 void ImageEditor::sRGBToLinear(bool preserveAlpha) {
+    _prepareForEditing();
     _image->_sRGBToLinear(preserveAlpha);
 }
 
 void ImageEditor::linearToSRGB(bool preserveAlpha) {
+    _prepareForEditing();
     _image->_linearToSRGB(preserveAlpha);
 }
 
 
+bool ImageEditor::applyColorLUT(ColorLUT* fn_nonnull lut, ColorLUTInterpolation interpolation, bool linearize, ImageToolsError* fn_nullable error fn_noescape) {
+    _prepareForEditing();
+    return _image->_applyColorLUT(lut, interpolation, linearize, error);
+}
+
+
+void ImageEditor::toneMap(ToneMappingOperator toneMappingOperator, float exposure, bool dither) {
+    _prepareForEditing();
+    _image->_toneMap(toneMappingOperator, exposure, dither);
+}
+
+
 FN_IMPLEMENT_SWIFT_INTERFACE1(ImageEditor)
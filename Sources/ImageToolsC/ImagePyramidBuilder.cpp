@@ -0,0 +1,194 @@
+//
+//  ImagePyramidBuilder.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImagePyramidBuilder.hpp>
+#include "ColorProfiles.hpp"
+#include "Threading.hpp"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+
+// MARK: - ImagePyramidOptions
+
+ImagePyramidOptions::ImagePyramidOptions():
+tileSize(256),
+overlap(1),
+quality(3),
+renormalize(false) {
+    //
+}
+
+
+ImagePyramidOptions::ImagePyramidOptions(long tileSize, long overlap, float quality, bool renormalize):
+tileSize(tileSize),
+overlap(overlap),
+quality(quality),
+renormalize(renormalize) {
+    //
+}
+
+
+// MARK: - ImagePyramidBuilder
+
+long ImagePyramidBuilder::getNumLevels(long width, long height) {
+    auto size = std::max(1l, std::max(width, height));
+    long numLevels = 1;
+    while ((1l << (numLevels - 1)) < size) {
+        numLevels += 1;
+    }
+    
+    return numLevels;
+}
+
+
+ImageContainer* fn_nonnull ImagePyramidBuilder::_createNextLevel(ImageContainer* fn_nonnull level, const ImagePyramidOptions& options) {
+    // Resampling leaves pixels in the linear colour profile, so lower levels are computed from linear pixels without converting them again
+    auto nextLevel = level->copy();
+    nextLevel->_resample(ResamplingAlgorithm::lanczos, options.quality, (level->_width + 1) / 2, (level->_height + 1) / 2, 1, options.renormalize, nullptr, nullptr);
+    return nextLevel;
+}
+
+
+ImageContainer* fn_nonnull ImagePyramidBuilder::_createEmittedLevel(ImageContainer* fn_nonnull level, ImageContainer* fn_nonnull image) {
+    if (level == image || (level->_colorProfile == image->_colorProfile && level->_sRGB == image->_sRGB)) {
+        return ImageContainerRetain(level);
+    }
+    
+    // Tiles have the same colour encoding as the source image
+    auto emittedLevel = level->copy();
+    if (image->_colorProfile) {
+        emittedLevel->_convertColorProfile(image->_colorProfile);
+    }
+    else if (image->_sRGB) {
+        auto sRGBProfile = createSharedSRGBColorProfile();
+        emittedLevel->_convertColorProfile(sRGBProfile);
+        emittedLevel->_assignColorProfile(nullptr);
+        LCMSColorProfileRelease(sRGBProfile);
+    }
+    emittedLevel->_sRGB = image->_sRGB;
+    return emittedLevel;
+}
+
+
+bool ImagePyramidBuilder::_emitTiles(ImageContainer* fn_nonnull level, long levelIndex, const ImagePyramidOptions& options, void* fn_nullable userInfo, ImagePyramidTileCallback fn_nonnull callback) {
+    auto tileSize = options.tileSize;
+    auto numColumns = (level->_width + tileSize - 1) / tileSize;
+    auto numRows = (level->_height + tileSize - 1) / tileSize;
+    auto pixelSize = level->_pixelFormat.getSize();
+    std::atomic<bool> cancelled = false;
+    
+    CONCURRENT_LOOP_START(0, numColumns * numRows, tileIndex) {
+        if (cancelled.load() == false) {
+            auto column = tileIndex % numColumns;
+            auto row = tileIndex / numColumns;
+            auto left = std::max(0l, column * tileSize - options.overlap);
+            auto top = std::max(0l, row * tileSize - options.overlap);
+            auto right = std::min(level->_width, (column + 1) * tileSize + options.overlap);
+            auto bottom = std::min(level->_height, (row + 1) * tileSize + options.overlap);
+            
+            auto tile = ImageContainer::create(level->_pixelFormat, level->_colorProfile, level->_sRGB, level->_hdr, right - left, bottom - top, 1);
+            for (auto y = top; y < bottom; y++) {
+                std::memcpy(tile->_getRow(y - top, 0),
+                            level->_getRow(y, 0) + left * pixelSize,
+                            tile->_width * pixelSize);
+            }
+            
+            if (callback(userInfo, levelIndex, column, row, tile)) {
+                cancelled.store(true);
+            }
+            ImageContainerRelease(tile);
+        }
+    } CONCURRENT_LOOP_END
+    
+    return cancelled.load() == false;
+}
+
+
+bool ImagePyramidBuilder::build(ImageContainer* fn_nonnull image, ImagePyramidOptions options, void* fn_nullable userInfo, ImagePyramidTileCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape) {
+    image->_ensureDecoded();
+    if (image->_depth != 1) {
+        ImageToolsError::set(error, "Only flat images can be split into tiles");
+        return false;
+    }
+    
+    options.tileSize = std::max(1l, options.tileSize);
+    options.overlap = std::clamp(options.overlap, 0l, options.tileSize);
+    
+    // Levels waiting for their tiles to be emitted
+    struct PendingLevel {
+        ImageContainer* fn_nonnull image;
+        long index;
+    };
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<PendingLevel> pendingLevels;
+    bool finished = false;
+    std::atomic<bool> cancelled = false;
+    
+    auto emitter = std::thread([&]() {
+        while (true) {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&]() { return pendingLevels.empty() == false || finished; });
+            if (pendingLevels.empty()) {
+                return;
+            }
+            
+            auto level = pendingLevels.front();
+            lock.unlock();
+            
+            if (cancelled.load() == false && _emitTiles(level.image, level.index, options, userInfo, callback) == false) {
+                cancelled.store(true);
+            }
+            ImageContainerRelease(level.image);
+            
+            lock.lock();
+            pendingLevels.pop_front();
+            lock.unlock();
+            condition.notify_all();
+        }
+    });
+    
+    // Compute the next level while tiles of the previous one are emitted
+    auto level = ImageContainerRetain(image);
+    for (auto levelIndex = getNumLevels(image->_width, image->_height) - 1; levelIndex >= 0 && cancelled.load() == false; levelIndex--) {
+        auto emittedLevel = _createEmittedLevel(level, image);
+        {
+            // Keep at most two levels in flight to bound memory usage
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&]() { return pendingLevels.size() < 2; });
+            pendingLevels.push_back(PendingLevel {
+                .image = emittedLevel,
+                .index = levelIndex
+            });
+        }
+        condition.notify_all();
+        
+        if (levelIndex > 0) {
+            auto nextLevel = _createNextLevel(level, options);
+            ImageContainerRelease(level);
+            level = nextLevel;
+        }
+    }
+    ImageContainerRelease(level);
+    
+    {
+        std::lock_guard lock(mutex);
+        finished = true;
+    }
+    condition.notify_all();
+    emitter.join();
+    
+    if (cancelled.load()) {
+        if (error) {
+            error->set(ImageToolsErrorCode::taskCancelled);
+        }
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,671 @@
+//
+//  ImageRowSource.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/ImageRowSource.hpp>
+#include "Threading.hpp"
+#include "UInt8SRGBTable.hpp"
+#include "PixelComponents.hpp"
+#include "ComponentConversion.hpp"
+#include "Float16SRGBTable.hpp"
+#include "SRGBTransfer.hpp"
+#include "ColorProfiles.hpp"
+#include "Lanczos.hpp"
+#include <condition_variable>
+#include <thread>
+
+
+// MARK: - Stages
+
+/// Producer of rows behind an ``ImageRowSource``.
+struct ImageRowStage {
+    virtual ~ImageRowStage() { }
+    
+    /// Reads next rows into the destination buffer and returns the number of rows read.
+    virtual long readRows(char* fn_nonnull destination, long maxRows) = 0;
+};
+
+
+/// Yields rows of a decoded image container. The container is released once all rows are read.
+struct ContainerRowStage final: ImageRowStage {
+    ImageContainer* fn_nullable image;
+    long currentRow;
+    
+    ContainerRowStage(ImageContainer* fn_nonnull image):
+    image(ImageContainerRetain(image)),
+    currentRow(0) { }
+    
+    ~ContainerRowStage() override {
+        ImageContainerRelease(image);
+    }
+    
+    long readRows(char* fn_nonnull destination, long maxRows) override {
+        if (image == nullptr) {
+            return 0;
+        }
+        
+        // Rows of the container may be padded
+        auto numRows = std::min(maxRows, image->getHeight() - currentRow);
+        auto rowSize = image->getWidth() * image->getPixelFormat().getSize();
+        auto bytesPerRow = image->getBytesPerRow();
+        auto contents = image->getContents();
+        for (auto row = 0; row < numRows; row++) {
+            std::memcpy(destination + row * rowSize, contents + (currentRow + row) * bytesPerRow, rowSize);
+        }
+        currentRow += numRows;
+        
+        // Decoded pixels are not needed anymore
+        if (currentRow >= image->getHeight()) {
+            ImageContainerRelease(image);
+            image = nullptr;
+        }
+        
+        return numRows;
+    }
+};
+
+
+/// Converts rows of the upstream source to another component type.
+struct PromoteRowStage final: ImageRowStage {
+    ImageRowSource* fn_nonnull upstream;
+    PixelComponentType componentType;
+    std::vector<char> scratch;
+    
+    PromoteRowStage(ImageRowSource* fn_nonnull upstream, PixelComponentType componentType):
+    upstream(ImageRowSourceRetain(upstream)),
+    componentType(componentType) { }
+    
+    ~PromoteRowStage() override {
+        ImageRowSourceRelease(upstream);
+    }
+    
+    long readRows(char* fn_nonnull destination, long maxRows) override {
+        auto sourceBytesPerRow = upstream->getBytesPerRow();
+        scratch.resize(maxRows * sourceBytesPerRow);
+        auto numRows = upstream->readRows(scratch.data(), maxRows);
+        
+        auto pixelFormat = upstream->getPixelFormat();
+        auto count = numRows * upstream->getWidth() * pixelFormat.numComponents;
+        getComponentConversionKernel(pixelFormat.componentType, componentType)(scratch.data(), destination, count);
+        return numRows;
+    }
+};
+
+
+/// Converts rows of the upstream source between sRGB and linear colour spaces in place.
+struct TransferRowStage final: ImageRowStage {
+    ImageRowSource* fn_nonnull upstream;
+    bool toLinear;
+    bool preserveAlpha;
+    
+    TransferRowStage(ImageRowSource* fn_nonnull upstream, bool toLinear, bool preserveAlpha):
+    upstream(ImageRowSourceRetain(upstream)),
+    toLinear(toLinear),
+    preserveAlpha(preserveAlpha) { }
+    
+    ~TransferRowStage() override {
+        ImageRowSourceRelease(upstream);
+    }
+    
+    template <typename Type, typename Transfer>
+    void apply(char* fn_nonnull contents, long numPixels, long numComponents, long numColorComponents, Transfer transfer) {
+        auto values = reinterpret_cast<Type*>(contents);
+        for (auto index = 0; index < numPixels; index++) {
+            for (auto i = 0; i < numColorComponents; i++) {
+                values[i] = transfer(values[i]);
+            }
+            values += numComponents;
+        }
+    }
+    
+    long readRows(char* fn_nonnull destination, long maxRows) override {
+        auto numRows = upstream->readRows(destination, maxRows);
+        
+        auto pixelFormat = upstream->getPixelFormat();
+        auto numPixels = numRows * upstream->getWidth();
+        auto numComponents = pixelFormat.numComponents;
+        auto numColorComponents = (preserveAlpha && pixelFormat.hasAlpha) ? numComponents - 1 : numComponents;
+        
+        switch (pixelFormat.componentType) {
+            case PixelComponentType::uint8:
+                if (toLinear) {
+                    apply<uint8_t>(destination, numPixels, numComponents, numColorComponents, [](uint8_t value) { return uint8Table[value].linear; });
+                }
+                else {
+                    apply<uint8_t>(destination, numPixels, numComponents, numColorComponents, [](uint8_t value) { return uint8Table[value].srgb; });
+                }
+                break;
+                
+            case PixelComponentType::uint16:
+                if (toLinear) {
+                    apply<uint16_t>(destination, numPixels, numComponents, numColorComponents, [](uint16_t value) { return _fromFloat<uint16_t>(fromSRGBToLinear(_toFloat(value))); });
+                }
+                else {
+                    apply<uint16_t>(destination, numPixels, numComponents, numColorComponents, [](uint16_t value) { return _fromFloat<uint16_t>(fromLinearToSRGB(_toFloat(value))); });
+                }
+                break;
+                
+            case PixelComponentType::uint32:
+                if (toLinear) {
+                    apply<uint32_t>(destination, numPixels, numComponents, numColorComponents, [](uint32_t value) { return _fromFloat<uint32_t>(fromSRGBToLinear(_toFloat(value))); });
+                }
+                else {
+                    apply<uint32_t>(destination, numPixels, numComponents, numColorComponents, [](uint32_t value) { return _fromFloat<uint32_t>(fromLinearToSRGB(_toFloat(value))); });
+                }
+                break;
+                
+            case PixelComponentType::float16:
+                applyFloat16SRGBTable(toLinear ? getFloat16SRGBTable().linear : getFloat16SRGBTable().srgb,
+                                      reinterpret_cast<_Float16*>(destination), numPixels, numComponents, numColorComponents);
+                break;
+                
+            case PixelComponentType::float32:
+                getSRGBTransferKernel(toLinear)(reinterpret_cast<float*>(destination), numPixels, numComponents, numColorComponents);
+                break;
+        }
+        
+        return numRows;
+    }
+};
+
+
+/// Converts rows of the upstream source to another colour profile in place, the same way ``ImageContainer`` converts its contents.
+struct ColorProfileRowStage final: ImageRowStage {
+    ImageRowSource* fn_nonnull upstream;
+    LCMSColorProfile* fn_nonnull colorProfile;
+    
+    ColorProfileRowStage(ImageRowSource* fn_nonnull upstream, LCMSColorProfile* fn_nonnull colorProfile):
+    upstream(ImageRowSourceRetain(upstream)),
+    colorProfile(LCMSColorProfileRetain(colorProfile)) { }
+    
+    ~ColorProfileRowStage() override {
+        LCMSColorProfileRelease(colorProfile);
+        ImageRowSourceRelease(upstream);
+    }
+    
+    long readRows(char* fn_nonnull destination, long maxRows) override {
+        auto numRows = upstream->readRows(destination, maxRows);
+        if (numRows <= 0) {
+            return numRows;
+        }
+        
+        // Rows are wrapped into a container, so conversions use the sRGB transfer fast path, cached transforms and LCMS like whole images
+        auto bytesPerRow = upstream->getBytesPerRow();
+        auto rows = ImageContainer::createBorrowing(destination, upstream->getPixelFormat(), upstream->getColorProfile(), upstream->getSRGB(), upstream->getHDR(), upstream->getWidth(), numRows, 1, bytesPerRow, 0, nullptr, nullptr);
+        rows->_convertColorProfile(colorProfile);
+        
+        // Integer components that LCMS can't convert are promoted into new contents
+        if (rows->_contents != destination) {
+            std::memcpy(destination, rows->_contents, numRows * bytesPerRow);
+        }
+        ImageContainerRelease(rows);
+        
+        return numRows;
+    }
+};
+
+
+// MARK: - Streaming Lanczos
+
+/// Lanczos weights of one output position.
+struct LanczosTap {
+    /// First contributing source index, already clamped.
+    long first;
+    
+    /// Last contributing source index, already clamped.
+    long last;
+    
+    /// Offset of this tap's weights in ``LanczosKernel/weights``.
+    long weightsOffset;
+};
+
+
+/// Precomputed Lanczos weights along one axis.
+///
+/// Uses the same sampling positions, window and edge clamping as ``ImageContainer/_resample``.
+struct LanczosKernel {
+    std::vector<LanczosTap> taps;
+    std::vector<long> indices;
+    std::vector<float> weights;
+    
+    LanczosKernel(long sourceSize, long destinationSize, float a) {
+        auto scale = static_cast<float>(sourceSize) / destinationSize;
+        taps.reserve(destinationSize);
+        for (auto d = 0; d < destinationSize; d++) {
+            auto s = (d + 0.5) * scale - 0.5;
+            long left = floor(s - a + 1);
+            long right = floor(s + a);
+            
+            auto tap = LanczosTap {
+                .first = std::clamp(left, 0l, sourceSize - 1),
+                .last = std::clamp(right, 0l, sourceSize - 1),
+                .weightsOffset = static_cast<long>(weights.size())
+            };
+            
+            // Normalize weights here, so passes only need to accumulate
+            float totalWeight = 0;
+            for (auto i = left; i <= right; i++) {
+                totalWeight += _lanczos_float32(s - i, a);
+            }
+            for (auto i = left; i <= right; i++) {
+                indices.push_back(std::clamp(i, 0l, sourceSize - 1));
+                weights.push_back(_lanczos_float32(s - i, a) / totalWeight);
+            }
+            taps.push_back(tap);
+        }
+    }
+    
+    long getNumWeights(long index) const {
+        auto end = index + 1 < static_cast<long>(taps.size()) ? taps[index + 1].weightsOffset : static_cast<long>(weights.size());
+        return end - taps[index].weightsOffset;
+    }
+};
+
+
+/// Resamples rows of the upstream source keeping only a window of horizontally resampled rows in memory.
+struct ResampleRowStage final: ImageRowStage {
+    ImageRowSource* fn_nonnull upstream;
+    ImagePixelFormat pixelFormat;
+    long sourceWidth;
+    long sourceHeight;
+    long width;
+    long height;
+    bool renormalize;
+    
+    LanczosKernel horizontalKernel;
+    LanczosKernel verticalKernel;
+    
+    /// Ring of horizontally resampled rows stored as `float` components.
+    std::vector<float> ring;
+    long ringCapacity;
+    
+    /// Batch of raw upstream rows and the same rows converted to `float` components.
+    std::vector<char> sourceBatch;
+    std::vector<float> floatBatch;
+    long batchCapacity;
+    
+    /// Vertically resampled `float` rows before they are converted to the destination format.
+    std::vector<float> outputRows;
+    
+    /// Number of upstream rows read so far.
+    long loadedRows;
+    
+    long currentRow;
+    
+    ResampleRowStage(ImageRowSource* fn_nonnull upstream, float quality, long width, long height, bool renormalize):
+    upstream(ImageRowSourceRetain(upstream)),
+    pixelFormat(upstream->getPixelFormat()),
+    sourceWidth(upstream->getWidth()),
+    sourceHeight(upstream->getHeight()),
+    width(width),
+    height(height),
+    renormalize(renormalize),
+    horizontalKernel(upstream->getWidth(), width, quality),
+    verticalKernel(upstream->getHeight(), height, quality),
+    loadedRows(0),
+    currentRow(0) {
+        // The widest vertical window plus one batch of freshly loaded rows
+        long window = 1;
+        for (auto y = 0; y < height; y++) {
+            window = std::max(window, verticalKernel.taps[y].last - verticalKernel.taps[y].first + 1);
+        }
+        batchCapacity = 32;
+        ringCapacity = window + batchCapacity;
+        ring.resize(ringCapacity * width * pixelFormat.numComponents);
+        sourceBatch.resize(batchCapacity * upstream->getBytesPerRow());
+        floatBatch.resize(batchCapacity * sourceWidth * pixelFormat.numComponents);
+    }
+    
+    ~ResampleRowStage() override {
+        ImageRowSourceRelease(upstream);
+    }
+    
+    float* fn_nonnull getRingRow(long sourceRow) {
+        return ring.data() + (sourceRow % ringCapacity) * width * pixelFormat.numComponents;
+    }
+    
+    /// Loads next upstream rows without overwriting rows starting from `firstNeededRow`.
+    void loadRows(long firstNeededRow) {
+        auto end = std::min({ sourceHeight, firstNeededRow + ringCapacity, loadedRows + batchCapacity });
+        auto numRows = upstream->readRows(sourceBatch.data(), end - loadedRows);
+        if (numRows <= 0) {
+            // Upstream ended earlier than expected, repeat the last row
+            sourceHeight = loadedRows;
+            return;
+        }
+        
+        // Horizontal pass on rows converted to float
+        auto firstRow = loadedRows;
+        auto numComponents = pixelFormat.numComponents;
+        auto sourceRowLength = sourceWidth * numComponents;
+        auto toFloat = getComponentConversionKernel(pixelFormat.componentType, PixelComponentType::float32);
+        toFloat(sourceBatch.data(), reinterpret_cast<char*>(floatBatch.data()), numRows * sourceRowLength);
+        CONCURRENT_LOOP_START(0, numRows, row) {
+            auto src = floatBatch.data() + row * sourceRowLength;
+            auto dst = getRingRow(firstRow + row);
+            for (auto x = 0; x < width; x++) {
+                auto& tap = horizontalKernel.taps[x];
+                auto numWeights = horizontalKernel.getNumWeights(x);
+                float sum[4] = { 0, 0, 0, 0 };
+                for (auto i = 0; i < numWeights; i++) {
+                    auto pixel = src + horizontalKernel.indices[tap.weightsOffset + i] * numComponents;
+                    auto w = horizontalKernel.weights[tap.weightsOffset + i];
+                    for (auto c = 0; c < numComponents; c++) {
+                        sum[c] += pixel[c] * w;
+                    }
+                }
+                for (auto c = 0; c < numComponents; c++) {
+                    dst[x * numComponents + c] = sum[c];
+                }
+            }
+        } CONCURRENT_LOOP_END
+        loadedRows += numRows;
+    }
+    
+    long readRows(char* fn_nonnull destination, long maxRows) override {
+        auto numComponents = pixelFormat.numComponents;
+        auto rowLength = width * numComponents;
+        auto fromFloat = getComponentConversionKernel(PixelComponentType::float32, pixelFormat.componentType);
+        outputRows.resize(std::max(static_cast<long>(outputRows.size()), maxRows * rowLength));
+        long produced = 0;
+        
+        while (produced < maxRows && currentRow < height && sourceHeight > 0) {
+            // Make sure that rows of the current output row are loaded
+            auto& tap = verticalKernel.taps[currentRow];
+            auto lastNeededRow = std::min(tap.last, sourceHeight - 1);
+            if (lastNeededRow >= loadedRows) {
+                loadRows(tap.first);
+                continue;
+            }
+            
+            // Collect output rows that can be produced with the loaded rows
+            auto firstRow = currentRow;
+            auto numRows = 0l;
+            while (produced + numRows < maxRows && firstRow + numRows < height) {
+                auto& nextTap = verticalKernel.taps[firstRow + numRows];
+                if (std::min(nextTap.last, sourceHeight - 1) >= loadedRows || nextTap.first < loadedRows - ringCapacity) {
+                    break;
+                }
+                numRows += 1;
+            }
+            
+            // Vertical pass into float rows
+            CONCURRENT_LOOP_START(0, numRows, row) {
+                auto y = firstRow + row;
+                auto& rowTap = verticalKernel.taps[y];
+                auto numWeights = verticalKernel.getNumWeights(y);
+                auto dst = outputRows.data() + (produced + row) * rowLength;
+                for (auto x = 0; x < width; x++) {
+                    float sum[4] = { 0, 0, 0, 0 };
+                    for (auto i = 0; i < numWeights; i++) {
+                        auto sourceRow = std::min(verticalKernel.indices[rowTap.weightsOffset + i], sourceHeight - 1);
+                        auto src = getRingRow(sourceRow) + x * numComponents;
+                        auto w = verticalKernel.weights[rowTap.weightsOffset + i];
+                        for (auto c = 0; c < numComponents; c++) {
+                            sum[c] += src[c] * w;
+                        }
+                    }
+                    if (renormalize) {
+                        auto length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                        for (auto c = 0; c < std::min(numComponents, 3l); c++) {
+                            sum[c] /= length;
+                        }
+                    }
+                    for (auto c = 0; c < numComponents; c++) {
+                        dst[x * numComponents + c] = sum[c];
+                    }
+                }
+            } CONCURRENT_LOOP_END
+            
+            currentRow += numRows;
+            produced += numRows;
+        }
+        
+        fromFloat(reinterpret_cast<const char*>(outputRows.data()), destination, produced * rowLength);
+        return produced;
+    }
+};
+
+
+// MARK: - ImageRowSource
+
+ImageRowSource::ImageRowSource(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, ImageRowStage* fn_nonnull stage):
+_referenceCounter(1),
+_pixelFormat(pixelFormat),
+_colorProfile(colorProfile),
+_sRGB(sRGB),
+_hdr(hdr),
+_width(width),
+_height(height),
+_currentRow(0),
+_stage(stage) {
+    //
+}
+
+
+ImageRowSource::~ImageRowSource() {
+    delete _stage;
+    LCMSColorProfileRelease(_colorProfile);
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::_createWithImage(ImageContainer* fn_nonnull image) {
+    auto stage = new ContainerRowStage(image);
+    return new ImageRowSource(image->getPixelFormat(), LCMSColorProfileRetain(image->getColorProfile()), image->getSRGB(), image->getHDR(), image->getWidth(), image->getHeight(), stage);
+}
+
+
+ImageRowSource* fn_nullable ImageRowSource::open(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) {
+    auto image = ImageContainer::load(path, assumedColorProfile, assumeSRGB, error);
+    if (image == nullptr) {
+        return nullptr;
+    }
+    
+    auto source = _createWithImage(image);
+    ImageContainerRelease(image);
+    return source;
+}
+
+
+ImageRowSource* fn_nullable ImageRowSource::open(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) {
+    auto image = ImageContainer::load(buffer, bufferSize, assumedColorProfile, assumeSRGB, error);
+    if (image == nullptr) {
+        return nullptr;
+    }
+    
+    auto source = _createWithImage(image);
+    ImageContainerRelease(image);
+    return source;
+}
+
+
+long ImageRowSource::readRows(char* fn_nonnull destination, long maxRows) {
+    auto numRows = std::min(maxRows, _height - _currentRow);
+    if (numRows <= 0) {
+        return 0;
+    }
+    
+    numRows = _stage->readRows(destination, numRows);
+    _currentRow += numRows;
+    return numRows;
+}
+
+
+bool ImageRowSource::drain(long rowsPerBatch, void* fn_nullable userInfo, ImageRowSourceCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape) {
+    rowsPerBatch = std::max(1l, rowsPerBatch);
+    
+    // Double buffering - one batch is produced while the other one is consumed
+    struct Batch {
+        std::vector<char> rows;
+        long firstRow;
+        long numRows;
+        bool ready;
+    };
+    Batch batches[2];
+    for (auto& batch : batches) {
+        batch.rows.resize(rowsPerBatch * getBytesPerRow());
+        batch.firstRow = 0;
+        batch.numRows = 0;
+        batch.ready = false;
+    }
+    
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool cancelled = false;
+    
+    // Producer
+    std::thread producer([&]() {
+        for (auto index = 0; ; index++) {
+            auto& batch = batches[index % 2];
+            {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [&]() { return batch.ready == false || cancelled; });
+                if (cancelled) {
+                    return;
+                }
+            }
+            
+            auto firstRow = _currentRow;
+            auto numRows = readRows(batch.rows.data(), rowsPerBatch);
+            
+            {
+                std::lock_guard lock(mutex);
+                batch.firstRow = firstRow;
+                batch.numRows = numRows;
+                batch.ready = true;
+            }
+            condition.notify_all();
+            
+            if (numRows == 0) {
+                return;
+            }
+        }
+    });
+    
+    // Consumer
+    for (auto index = 0; ; index++) {
+        auto& batch = batches[index % 2];
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&]() { return batch.ready; });
+        }
+        
+        if (batch.numRows == 0) {
+            break;
+        }
+        
+        auto cancel = callback(userInfo, batch.rows.data(), batch.firstRow, batch.numRows);
+        
+        {
+            std::lock_guard lock(mutex);
+            batch.ready = false;
+            cancelled = cancel;
+        }
+        condition.notify_all();
+        
+        if (cancel) {
+            break;
+        }
+    }
+    
+    producer.join();
+    
+    if (cancelled) {
+        if (error) {
+            error->set(ImageToolsErrorCode::taskCancelled);
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+
+ImageContainer* fn_nullable ImageRowSource::createImage(ImageToolsError* fn_nullable error fn_noescape) {
+    if (_currentRow != 0) {
+        ImageToolsError::set(error, "Rows were already read from the source");
+        return nullptr;
+    }
+    
+    auto image = ImageContainer::create(_pixelFormat, _colorProfile, _sRGB, _hdr, _width, _height, 1);
+    auto numRows = readRows(image->_contents, _height);
+    if (numRows != _height) {
+        ImageContainerRelease(image);
+        ImageToolsError::set(error, "Source ended unexpectedly");
+        return nullptr;
+    }
+    
+    return image;
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::createPromoted(PixelComponentType componentType) {
+    auto pixelFormat = _pixelFormat;
+    pixelFormat.componentType = componentType;
+    auto stage = new PromoteRowStage(this, componentType);
+    return new ImageRowSource(pixelFormat, LCMSColorProfileRetain(_colorProfile), _sRGB, _hdr, _width, _height, stage);
+}
+
+
+/// Returns the retained profile that rows with the colour profile are converted to, or `nullptr` if rows don't have a colour profile.
+static LCMSColorProfile* fn_nullable _getTransferProfile(LCMSColorProfile* fn_nullable colorProfile, bool toLinear) {
+    if (colorProfile == nullptr) {
+        return nullptr;
+    }
+    
+    // Linear version of the profile, same as before resampling whole images
+    if (toLinear) {
+        return colorProfile->checkIsLinear() ? LCMSColorProfileRetain(colorProfile) : createSharedLinearColorProfile(colorProfile);
+    }
+    
+    // Profile that the linear profile was created from, otherwise sRGB
+    if (colorProfile->checkIsLinear() == false) {
+        return LCMSColorProfileRetain(colorProfile);
+    }
+    auto description = ColorProfileDescription();
+    if (describeSharedColorProfile(colorProfile, description) && description.linear) {
+        description.linear = false;
+        if (auto profile = createSharedColorProfile(description)) {
+            return profile;
+        }
+    }
+    return createSharedSRGBColorProfile();
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::_createTransferConverted(bool toLinear, bool preserveAlpha) {
+    // Rows with a colour profile are converted through it, so pixels keep matching the profile
+    if (auto colorProfile = _getTransferProfile(_colorProfile, toLinear)) {
+        auto stage = new ColorProfileRowStage(this, colorProfile);
+        return new ImageRowSource(_pixelFormat, colorProfile, colorProfile->checkIsSRGB(), _hdr, _width, _height, stage);
+    }
+    
+    auto stage = new TransferRowStage(this, toLinear, preserveAlpha);
+    return new ImageRowSource(_pixelFormat, nullptr, toLinear == false, _hdr, _width, _height, stage);
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::createSRGBToLinearConverted(bool preserveAlpha) {
+    return _createTransferConverted(true, preserveAlpha);
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::createLinearToSRGBConverted(bool preserveAlpha) {
+    return _createTransferConverted(false, preserveAlpha);
+}
+
+
+ImageRowSource* fn_nonnull ImageRowSource::createResampled(ResamplingAlgorithm algorithm, float quality, long width, long height, bool renormalize) {
+    // Correct dimensions if wrong
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    
+    auto stage = new ResampleRowStage(this, quality, width, height, renormalize);
+    return new ImageRowSource(_pixelFormat, LCMSColorProfileRetain(_colorProfile), _sRGB, _hdr, width, height, stage);
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(ImageRowSource)
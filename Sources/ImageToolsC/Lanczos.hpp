@@ -0,0 +1,25 @@
+//
+//  Lanczos.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <cmath>
+
+
+// MARK: - Lanczos
+
+static inline float _sinc_float32(float x) {
+    if (x == 0.0) return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static inline float _lanczos_float32(float x, float a) {
+    if (fabs(x) >= a) return 0.0;
+    return _sinc_float32(x) * _sinc_float32(x / a);
+}
@@ -0,0 +1,85 @@
+//
+//  PixelComponents.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include "UInt8SRGBTable.hpp"
+#include <limits>
+
+
+// MARK: - Normalized values
+
+/// Converts a component to a `float` value. Integer components are normalized to `[0, 1]`.
+static inline float _toFloat(uint8_t value) { return uint8Table[value].fp32Value; }
+static inline float _toFloat(uint16_t value) { return static_cast<float>(value) * (1.0f / std::numeric_limits<uint16_t>::max()); }
+static inline float _toFloat(uint32_t value) { return static_cast<float>(static_cast<double>(value) / std::numeric_limits<uint32_t>::max()); }
+static inline float _toFloat(_Float16 value) { return static_cast<float>(value); }
+static inline float _toFloat(float value) { return value; }
+
+
+/// Converts a `float` value to a component. Integer components are clamped and rounded to the nearest value, `NaN` becomes `0`.
+template <typename Type>
+static inline Type _fromFloat(float value);
+
+template <>
+inline uint8_t _fromFloat<uint8_t>(float value) {
+    constexpr auto max = static_cast<float>(std::numeric_limits<uint8_t>::max());
+    // std::max returns its first argument if the comparison fails, so NaN becomes 0 instead of reaching the cast
+    return static_cast<uint8_t>(std::min(std::max(0.0f, value), 1.0f) * max + 0.5f);
+}
+
+template <>
+inline uint16_t _fromFloat<uint16_t>(float value) {
+    constexpr auto max = static_cast<float>(std::numeric_limits<uint16_t>::max());
+    return static_cast<uint16_t>(std::min(std::max(0.0f, value), 1.0f) * max + 0.5f);
+}
+
+template <>
+inline uint32_t _fromFloat<uint32_t>(float value) {
+    constexpr auto max = static_cast<double>(std::numeric_limits<uint32_t>::max());
+    return static_cast<uint32_t>(std::min(std::max(0.0, static_cast<double>(value)), 1.0) * max + 0.5);
+}
+
+template <>
+inline _Float16 _fromFloat<_Float16>(float value) { return static_cast<_Float16>(value); }
+
+template <>
+inline float _fromFloat<float>(float value) { return value; }
+
+
+// MARK: - Component conversion
+
+/// Converts a component to another component type.
+///
+/// Integer components are rescaled with exact integer arithmetic, so widening conversions are lossless and `uint8 -> uint16 -> uint8` round trips.
+template <typename SourceType, typename DestinationType>
+static inline DestinationType _convertComponent(SourceType value) {
+    if constexpr (std::is_same_v<SourceType, DestinationType>) {
+        return value;
+    }
+    else if constexpr (std::is_integral_v<SourceType> && std::is_integral_v<DestinationType>) {
+        constexpr uint64_t sourceMax = std::numeric_limits<SourceType>::max();
+        constexpr uint64_t destinationMax = std::numeric_limits<DestinationType>::max();
+        return static_cast<DestinationType>((static_cast<uint64_t>(value) * destinationMax + sourceMax / 2) / sourceMax);
+    }
+    else {
+        return _fromFloat<DestinationType>(_toFloat(value));
+    }
+}
+
+
+/// Converts a row of components.
+template <typename SourceType, typename DestinationType>
+static inline void _convertComponents(const char* fn_nonnull source, char* fn_nonnull destination, long count) {
+    auto src = reinterpret_cast<const SourceType*>(source);
+    auto dst = reinterpret_cast<DestinationType*>(destination);
+    for (long i = 0; i < count; i++) {
+        dst[i] = _convertComponent<SourceType, DestinationType>(src[i]);
+    }
+}
+
@@ -0,0 +1,350 @@
+//
+//  SRGBTransfer.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include "SRGBTransfer.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define USE_X86_KERNELS 1
+#else
+#define USE_X86_KERNELS 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_KERNELS 1
+#else
+#define USE_NEON_KERNELS 0
+#endif
+
+
+// MARK: - Constants
+
+// Linear segments of the transfer functions
+static constexpr float _sRGBThreshold = 0.04045f;
+static constexpr float _linearThreshold = 0.0031308f;
+static constexpr float _linearScale = 12.92f;
+
+// Power segments
+static constexpr float _offset = 0.055f;
+static constexpr float _scale = 1.055f;
+static constexpr float _toLinearPower = 2.4f;
+static constexpr float _toSRGBPower = 1.0f / 2.4f;
+
+// log2(m) = 2 / ln(2) * atanh(t), where t = (m - 1) / (m + 1). Mantissas are in [sqrt(0.5), sqrt(2)), so |t| < 0.1716 and four terms of the series are enough
+static constexpr float _log2C1 = 2.8853900817779268f;
+static constexpr float _log2C3 = 0.9617966939259756f;
+static constexpr float _log2C5 = 0.5770780163555854f;
+static constexpr float _log2C7 = 0.4121985831111324f;
+
+// exp2(f) = sum(ln(2)^k / k! * f^k), where f is in [-0.5, 0.5]
+static constexpr float _exp2C1 = 0.6931471805599453f;
+static constexpr float _exp2C2 = 0.2402265069591007f;
+static constexpr float _exp2C3 = 0.05550410866482158f;
+static constexpr float _exp2C4 = 0.009618129107628477f;
+static constexpr float _exp2C5 = 0.0013333558146428443f;
+static constexpr float _exp2C6 = 0.00015403530393381606f;
+
+static constexpr float _sqrt2 = 1.4142135623730951f;
+
+
+// MARK: - Scalar approximations
+
+/// Base two logarithm of a positive normal value.
+static inline float _log2(float value) {
+    auto bits = std::bit_cast<int32_t>(value);
+    auto exponent = static_cast<float>(((bits >> 23) & 0xff) - 127);
+    auto mantissa = std::bit_cast<float>((bits & 0x007fffff) | 0x3f800000);
+    if (mantissa > _sqrt2) {
+        mantissa *= 0.5f;
+        exponent += 1.0f;
+    }
+    
+    auto t = (mantissa - 1.0f) / (mantissa + 1.0f);
+    auto t2 = t * t;
+    return exponent + t * (_log2C1 + t2 * (_log2C3 + t2 * (_log2C5 + t2 * _log2C7)));
+}
+
+
+static inline float _exp2(float value) {
+    value = std::clamp(value, -126.0f, 127.0f);
+    auto integer = std::nearbyint(value);
+    auto f = value - integer;
+    auto p = 1.0f + f * (_exp2C1 + f * (_exp2C2 + f * (_exp2C3 + f * (_exp2C4 + f * (_exp2C5 + f * _exp2C6)))));
+    return p * std::bit_cast<float>((static_cast<int32_t>(integer) + 127) << 23);
+}
+
+
+float fastSRGBToLinear(float sRGB) {
+    if (!(sRGB > _sRGBThreshold)) {
+        return sRGB / _linearScale;
+    }
+    if (sRGB == std::numeric_limits<float>::infinity()) {
+        return sRGB;
+    }
+    
+    return _exp2(_toLinearPower * _log2((sRGB + _offset) / _scale));
+}
+
+
+float fastLinearToSRGB(float linear) {
+    if (!(linear >= _linearThreshold)) {
+        return linear * _linearScale;
+    }
+    if (linear == std::numeric_limits<float>::infinity()) {
+        return linear;
+    }
+    
+    return _exp2(_toSRGBPower * _log2(linear)) * _scale - _offset;
+}
+
+
+template <bool toLinear>
+static void _transferScalar(float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    for (long index = 0; index < numPixels; index++) {
+        for (auto i = 0; i < numColorComponents; i++) {
+            values[i] = toLinear ? fastSRGBToLinear(values[i]) : fastLinearToSRGB(values[i]);
+        }
+        values += numComponents;
+    }
+}
+
+
+/// Vector kernels convert eight values at a time. Alpha components are preserved by blending, which works if pixels don't cross groups of eight values.
+static inline bool _checkCanVectorize(long numComponents, long numColorComponents) {
+    return numColorComponents == numComponents || numComponents == 2 || numComponents == 4;
+}
+
+
+// MARK: - x86 kernels
+
+#if USE_X86_KERNELS
+
+#define X86_KERNEL __attribute__((target("avx2")))
+
+
+X86_KERNEL static inline __m256 _log2_x86(__m256 value) {
+    auto bits = _mm256_castps_si256(value);
+    auto exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+    auto mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    
+    auto large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(_sqrt2), _CMP_GT_OQ);
+    mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), large);
+    exponent = _mm256_add_ps(exponent, _mm256_and_ps(large, _mm256_set1_ps(1.0f)));
+    
+    auto one = _mm256_set1_ps(1.0f);
+    auto t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+    auto t2 = _mm256_mul_ps(t, t);
+    auto series = _mm256_add_ps(_mm256_set1_ps(_log2C5), _mm256_mul_ps(t2, _mm256_set1_ps(_log2C7)));
+    series = _mm256_add_ps(_mm256_set1_ps(_log2C3), _mm256_mul_ps(t2, series));
+    series = _mm256_add_ps(_mm256_set1_ps(_log2C1), _mm256_mul_ps(t2, series));
+    return _mm256_add_ps(exponent, _mm256_mul_ps(t, series));
+}
+
+
+X86_KERNEL static inline __m256 _exp2_x86(__m256 value) {
+    value = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+    auto integer = _mm256_round_ps(value, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    auto f = _mm256_sub_ps(value, integer);
+    
+    auto p = _mm256_add_ps(_mm256_set1_ps(_exp2C5), _mm256_mul_ps(f, _mm256_set1_ps(_exp2C6)));
+    p = _mm256_add_ps(_mm256_set1_ps(_exp2C4), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(_exp2C3), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(_exp2C2), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(_exp2C1), _mm256_mul_ps(f, p));
+    p = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(f, p));
+    
+    auto scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(integer), _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(p, scale);
+}
+
+
+template <bool toLinear>
+X86_KERNEL static inline __m256 _transferVector_x86(__m256 value) {
+    auto infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 power;
+    __m256 linear;
+    __m256 usePower;
+    if constexpr (toLinear) {
+        auto base = _mm256_div_ps(_mm256_add_ps(value, _mm256_set1_ps(_offset)), _mm256_set1_ps(_scale));
+        power = _exp2_x86(_mm256_mul_ps(_mm256_set1_ps(_toLinearPower), _log2_x86(base)));
+        linear = _mm256_div_ps(value, _mm256_set1_ps(_linearScale));
+        usePower = _mm256_cmp_ps(value, _mm256_set1_ps(_sRGBThreshold), _CMP_GT_OQ);
+    }
+    else {
+        power = _mm256_sub_ps(_mm256_mul_ps(_exp2_x86(_mm256_mul_ps(_mm256_set1_ps(_toSRGBPower), _log2_x86(value))), _mm256_set1_ps(_scale)), _mm256_set1_ps(_offset));
+        linear = _mm256_mul_ps(value, _mm256_set1_ps(_linearScale));
+        usePower = _mm256_cmp_ps(value, _mm256_set1_ps(_linearThreshold), _CMP_GE_OQ);
+    }
+    
+    auto result = _mm256_blendv_ps(linear, power, usePower);
+    return _mm256_blendv_ps(result, value, _mm256_cmp_ps(value, infinity, _CMP_EQ_OQ));
+}
+
+
+template <bool toLinear>
+X86_KERNEL static void _transfer_x86(float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    if (_checkCanVectorize(numComponents, numColorComponents) == false) {
+        _transferScalar<toLinear>(values, numPixels, numComponents, numColorComponents);
+        return;
+    }
+    
+    // Lanes of alpha components keep their values
+    auto alphaMask = _mm256_setzero_ps();
+    if (numColorComponents != numComponents) {
+        alphaMask = _mm256_castsi256_ps(numComponents == 2 ? _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1) : _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+    }
+    
+    auto count = numPixels * numComponents;
+    long index = 0;
+    for (; index + 8 <= count; index += 8) {
+        auto value = _mm256_loadu_ps(values + index);
+        _mm256_storeu_ps(values + index, _mm256_blendv_ps(_transferVector_x86<toLinear>(value), value, alphaMask));
+    }
+    
+    _transferScalar<toLinear>(values + index, (count - index) / numComponents, numComponents, numColorComponents);
+}
+
+
+static bool _checkX86KernelsSupported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+
+// MARK: - NEON kernels
+
+#if USE_NEON_KERNELS
+
+static inline float32x4_t _log2_neon(float32x4_t value) {
+    auto bits = vreinterpretq_s32_f32(value);
+    auto exponent = vcvtq_f32_s32(vsubq_s32(vandq_s32(vshrq_n_s32(bits, 23), vdupq_n_s32(0xff)), vdupq_n_s32(127)));
+    auto mantissa = vreinterpretq_f32_s32(vorrq_s32(vandq_s32(bits, vdupq_n_s32(0x007fffff)), vdupq_n_s32(0x3f800000)));
+    
+    auto large = vcgtq_f32(mantissa, vdupq_n_f32(_sqrt2));
+    mantissa = vbslq_f32(large, vmulq_f32(mantissa, vdupq_n_f32(0.5f)), mantissa);
+    exponent = vaddq_f32(exponent, vreinterpretq_f32_u32(vandq_u32(large, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+    
+    auto one = vdupq_n_f32(1.0f);
+    auto t = vdivq_f32(vsubq_f32(mantissa, one), vaddq_f32(mantissa, one));
+    auto t2 = vmulq_f32(t, t);
+    auto series = vaddq_f32(vdupq_n_f32(_log2C5), vmulq_f32(t2, vdupq_n_f32(_log2C7)));
+    series = vaddq_f32(vdupq_n_f32(_log2C3), vmulq_f32(t2, series));
+    series = vaddq_f32(vdupq_n_f32(_log2C1), vmulq_f32(t2, series));
+    return vaddq_f32(exponent, vmulq_f32(t, series));
+}
+
+
+static inline float32x4_t _exp2_neon(float32x4_t value) {
+    value = vminq_f32(vmaxq_f32(value, vdupq_n_f32(-126.0f)), vdupq_n_f32(127.0f));
+    auto integer = vrndnq_f32(value);
+    auto f = vsubq_f32(value, integer);
+    
+    auto p = vaddq_f32(vdupq_n_f32(_exp2C5), vmulq_f32(f, vdupq_n_f32(_exp2C6)));
+    p = vaddq_f32(vdupq_n_f32(_exp2C4), vmulq_f32(f, p));
+    p = vaddq_f32(vdupq_n_f32(_exp2C3), vmulq_f32(f, p));
+    p = vaddq_f32(vdupq_n_f32(_exp2C2), vmulq_f32(f, p));
+    p = vaddq_f32(vdupq_n_f32(_exp2C1), vmulq_f32(f, p));
+    p = vaddq_f32(vdupq_n_f32(1.0f), vmulq_f32(f, p));
+    
+    auto scale = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(integer), vdupq_n_s32(127)), 23));
+    return vmulq_f32(p, scale);
+}
+
+
+template <bool toLinear>
+static inline float32x4_t _transferVector_neon(float32x4_t value) {
+    float32x4_t power;
+    float32x4_t linear;
+    uint32x4_t usePower;
+    if constexpr (toLinear) {
+        auto base = vdivq_f32(vaddq_f32(value, vdupq_n_f32(_offset)), vdupq_n_f32(_scale));
+        power = _exp2_neon(vmulq_f32(vdupq_n_f32(_toLinearPower), _log2_neon(base)));
+        linear = vdivq_f32(value, vdupq_n_f32(_linearScale));
+        usePower = vcgtq_f32(value, vdupq_n_f32(_sRGBThreshold));
+    }
+    else {
+        power = vsubq_f32(vmulq_f32(_exp2_neon(vmulq_f32(vdupq_n_f32(_toSRGBPower), _log2_neon(value))), vdupq_n_f32(_scale)), vdupq_n_f32(_offset));
+        linear = vmulq_f32(value, vdupq_n_f32(_linearScale));
+        usePower = vcgeq_f32(value, vdupq_n_f32(_linearThreshold));
+    }
+    
+    auto result = vbslq_f32(usePower, power, linear);
+    return vbslq_f32(vceqq_f32(value, vdupq_n_f32(std::numeric_limits<float>::infinity())), value, result);
+}
+
+
+template <bool toLinear>
+static void _transfer_neon(float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    if (_checkCanVectorize(numComponents, numColorComponents) == false) {
+        _transferScalar<toLinear>(values, numPixels, numComponents, numColorComponents);
+        return;
+    }
+    
+    // Lanes of alpha components keep their values
+    auto alphaMask = vdupq_n_u32(0);
+    if (numColorComponents != numComponents) {
+        static const uint32_t gaMask[4] = { 0, 0xffffffff, 0, 0xffffffff };
+        static const uint32_t rgbaMask[4] = { 0, 0, 0, 0xffffffff };
+        alphaMask = vld1q_u32(numComponents == 2 ? gaMask : rgbaMask);
+    }
+    
+    auto count = numPixels * numComponents;
+    long index = 0;
+    for (; index + 8 <= count; index += 8) {
+        auto value0 = vld1q_f32(values + index);
+        auto value1 = vld1q_f32(values + index + 4);
+        vst1q_f32(values + index, vbslq_f32(alphaMask, value0, _transferVector_neon<toLinear>(value0)));
+        vst1q_f32(values + index + 4, vbslq_f32(alphaMask, value1, _transferVector_neon<toLinear>(value1)));
+    }
+    
+    _transferScalar<toLinear>(values + index, (count - index) / numComponents, numComponents, numColorComponents);
+}
+
+#endif
+
+
+// MARK: - Dispatch
+
+struct SRGBTransferKernels {
+    SRGBTransferKernel fn_nonnull toLinear;
+    SRGBTransferKernel fn_nonnull toSRGB;
+};
+
+
+static SRGBTransferKernels _createKernels() {
+    auto kernels = SRGBTransferKernels {
+        .toLinear = _transferScalar<true>,
+        .toSRGB = _transferScalar<false>
+    };
+    
+#if USE_X86_KERNELS
+    if (_checkX86KernelsSupported()) {
+        kernels.toLinear = _transfer_x86<true>;
+        kernels.toSRGB = _transfer_x86<false>;
+    }
+#endif
+
+#if USE_NEON_KERNELS
+    kernels.toLinear = _transfer_neon<true>;
+    kernels.toSRGB = _transfer_neon<false>;
+#endif
+    
+    return kernels;
+}
+
+
+SRGBTransferKernel fn_nonnull getSRGBTransferKernel(bool toLinear) {
+    static const auto kernels = _createKernels();
+    return toLinear ? kernels.toLinear : kernels.toSRGB;
+}
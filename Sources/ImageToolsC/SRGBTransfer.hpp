@@ -0,0 +1,26 @@
+//
+//  SRGBTransfer.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+
+
+/// Converts `float32` values between sRGB and linear spaces in place, leaving the alpha component untouched if `numColorComponents` is smaller than `numComponents`.
+typedef void (* SRGBTransferKernel)(float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents);
+
+
+// Kernels replace std::pow with exp2 and log2 polynomials. Relative error stays below 1e-5, well under half float precision, and values outside of [0, 1] are converted as well.
+// Kernels are selected once per process depending on what the CPU supports - AVX2 on x86, NEON on arm64 - and fall back to scalar approximations. The function is thread-safe.
+
+/// Returns the fastest kernel converting values to the linear space if `toLinear` is `true`, to the sRGB space otherwise.
+SRGBTransferKernel fn_nonnull getSRGBTransferKernel(bool toLinear);
+
+
+/// Scalar versions of the approximations.
+float fastSRGBToLinear(float sRGB);
+float fastLinearToSRGB(float linear);
@@ -70,6 +70,21 @@ void ImageTools_testThreadSpawning() {
 
 // MARK: - Process concurrently
 
+/// Loops of threads that already run in parallel are processed serially.
+static thread_local bool _serialLoops = false;
+
+
+SerialLoopScope::SerialLoopScope():
+_previousSerial(_serialLoops) {
+    _serialLoops = true;
+}
+
+
+SerialLoopScope::~SerialLoopScope() {
+    _serialLoops = _previousSerial;
+}
+
+
 struct ConcurrentTaskContext {
     std::atomic<long> currentIndex;
     const long endIndex;
@@ -79,6 +94,9 @@ struct ConcurrentTaskContext {
 };
 
 static void concurrentTaskThread(ThreadInfo* threadInfo, ConcurrentTaskContext* context) {
+    // Every core is already busy with this loop
+    _serialLoops = true;
+    
     auto currentIndex = &(context->currentIndex);
     auto endIndex = context->endIndex;
     auto userInfo = context->userInfo;
@@ -104,6 +122,13 @@ static void concurrentTaskThread(ThreadInfo* threadInfo, ConcurrentTaskContext*
 }
 
 void processConcurrentlyCommon(void* userInfo, long start, long end, void(* callback)(void* userInfo, long index)) {
+    if (_serialLoops) {
+        for (auto index = start; index < end; index++) {
+            callback(userInfo, index);
+        }
+        return;
+    }
+    
     // Get number of cores
     auto numCores = std::min(static_cast<long>(std::thread::hardware_concurrency()),
                              static_cast<long>(MAX_THREADS));
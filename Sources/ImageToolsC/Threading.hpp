@@ -39,6 +39,22 @@ void processConcurrently(ContextType&& context, long start, long end, void(* cal
 
 void processConcurrently(long start, long end, std::function<void(long)> callback);
 
+
+/// Runs concurrent loops of the current thread serially while alive.
+///
+/// Concurrent loops spawn a thread per core, so loops nested in other concurrent work would multiply threads. Worker threads of concurrent loops always run nested loops serially, use this on other threads that already run in parallel with each other.
+class SerialLoopScope final {
+private:
+    bool _previousSerial;
+    
+public:
+    SerialLoopScope();
+    ~SerialLoopScope();
+    
+    SerialLoopScope(const SerialLoopScope&) = delete;
+    SerialLoopScope& operator=(const SerialLoopScope&) = delete;
+};
+
 #if USE_CONCURRENT_LOOPS
 #  define CONCURRENT_LOOP_START(_start, _end, _index_name) processConcurrently(_start, _end, [&](long _index_name)
 #else
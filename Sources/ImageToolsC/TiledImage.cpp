@@ -0,0 +1,576 @@
+//
+//  TiledImage.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include <ImageToolsC/TiledImage.hpp>
+#include "Threading.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+
+
+// MARK: - TiledImage
+
+static std::string _getTemporaryDirectory() {
+    auto directory = getenv("TMPDIR");
+    if (directory == nullptr || directory[0] == 0) {
+        return "/tmp";
+    }
+    
+    return directory;
+}
+
+
+static std::string _getDirectory(const char* fn_nonnull path) {
+    auto string = std::string(path);
+    auto separator = string.find_last_of('/');
+    if (separator == std::string::npos) {
+        return ".";
+    }
+    if (separator == 0) {
+        return "/";
+    }
+    
+    return string.substr(0, separator);
+}
+
+
+TiledImage::TiledImage(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, int fileDescriptor, const std::string& directory, bool keepFile):
+_referenceCounter(1),
+_pixelFormat(pixelFormat),
+_colorProfile(colorProfile),
+_sRGB(sRGB),
+_hdr(hdr),
+_width(width),
+_height(height),
+_tileSize(tileSize),
+_numTilesX((width + tileSize - 1) / tileSize),
+_numTilesY((height + tileSize - 1) / tileSize),
+_cacheSize(cacheSize),
+_fileDescriptor(fileDescriptor),
+_directory(directory),
+_keepFile(keepFile),
+_mutex(),
+_condition(),
+_maxCachedTiles(0),
+_tiles(),
+_recentlyUsed(),
+_ioFailed(false) {
+    // Every thread needs a few tiles at once, for example for resampling halo
+    auto numCores = static_cast<long>(std::max(1u, std::thread::hardware_concurrency()));
+    _maxCachedTiles = std::max(cacheSize / _getTileContentsSize(), numCores * 4);
+}
+
+
+TiledImage::~TiledImage() {
+    for (auto& [index, tile]: _tiles) {
+        if (_keepFile && tile.dirty) {
+            _writeTile(index, tile.contents);
+        }
+        ImageAllocator::deallocate(tile.contents);
+    }
+    
+    close(_fileDescriptor);
+    LCMSColorProfileRelease(_colorProfile);
+}
+
+
+TiledImage* fn_nullable TiledImage::_create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, const char* fn_nullable path, const std::string& directory, ImageToolsError* fn_nullable error fn_noescape) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    tileSize = std::max(1l, tileSize);
+    
+    int fileDescriptor = -1;
+    if (path) {
+        fileDescriptor = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    else {
+        auto temporaryPath = directory + "/ImageTools-XXXXXX";
+        fileDescriptor = mkstemp(temporaryPath.data());
+        if (fileDescriptor >= 0) {
+            // The file is deleted as soon as the descriptor is closed
+            unlink(temporaryPath.c_str());
+        }
+    }
+    if (fileDescriptor < 0) {
+        ImageToolsError::set(error, "Could not create tiles file");
+        return nullptr;
+    }
+    
+    // Tiles that were never written read as zeros
+    auto numTiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+    if (ftruncate(fileDescriptor, static_cast<off_t>(numTiles * tileSize * tileSize * pixelFormat.getSize())) != 0) {
+        close(fileDescriptor);
+        ImageToolsError::set(error, "Could not allocate tiles file");
+        return nullptr;
+    }
+    
+    return new TiledImage(pixelFormat, LCMSColorProfileRetain(colorProfile), sRGB, hdr, width, height, tileSize, cacheSize, fileDescriptor, directory, path != nullptr);
+}
+
+
+TiledImage* fn_nullable TiledImage::create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape) {
+    auto directory = path ? _getDirectory(path) : _getTemporaryDirectory();
+    return _create(pixelFormat, colorProfile, sRGB, hdr, width, height, tileSize, cacheSize, path, directory, error);
+}
+
+
+TiledImage* fn_nullable TiledImage::create(ImageContainer* fn_nonnull image, long tileSize, long cacheSize, ImageToolsError* fn_nullable error fn_noescape) {
+    if (image->getDepth() != 1) {
+        ImageToolsError::set(error, "Only flat images can be tiled");
+        return nullptr;
+    }
+    
+    auto tiledImage = create(image->getPixelFormat(), image->getColorProfile(), image->getSRGB(), image->getHDR(), image->getWidth(), image->getHeight(), tileSize, cacheSize, nullptr, error);
+    if (tiledImage == nullptr) {
+        return nullptr;
+    }
+    
+    tiledImage->_setRegionImage(image, 0, 0);
+    return tiledImage;
+}
+
+
+TiledImage* fn_nullable TiledImage::create(ImageRowSource* fn_nonnull source, long tileSize, long cacheSize, ImageToolsError* fn_nullable error fn_noescape) {
+    auto tiledImage = create(source->getPixelFormat(), source->getColorProfile(), source->getSRGB(), source->getHDR(), source->getWidth(), source->getHeight(), tileSize, cacheSize, nullptr, error);
+    if (tiledImage == nullptr) {
+        return nullptr;
+    }
+    
+    // Fill one row of tiles at a time
+    auto success = source->drain(tiledImage->_tileSize, tiledImage, [](void* fn_nullable userInfo, const char* fn_nonnull rows, long firstRow, long numRows) {
+        auto tiledImage = reinterpret_cast<TiledImage*>(userInfo);
+        tiledImage->_copyRegion(0, firstRow, tiledImage->_width, numRows, const_cast<char*>(rows), true);
+        return false;
+    }, error);
+    if (success == false) {
+        TiledImageRelease(tiledImage);
+        return nullptr;
+    }
+    
+    return tiledImage;
+}
+
+
+TiledImage* fn_nullable TiledImage::_createDerived(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, ImageToolsError* fn_nullable error fn_noescape) {
+    return _create(pixelFormat, colorProfile, sRGB, hdr, width, height, _tileSize, _cacheSize, nullptr, _directory, error);
+}
+
+
+// MARK: - Tile cache
+
+void TiledImage::_readTile(long tileIndex, char* fn_nonnull contents) {
+    auto size = _getTileContentsSize();
+    auto offset = static_cast<off_t>(tileIndex * size);
+    long numRead = 0;
+    while (numRead < size) {
+        auto result = pread(_fileDescriptor, contents + numRead, size - numRead, offset + numRead);
+        if (result <= 0) {
+            if (result < 0) {
+                _ioFailed.store(true);
+            }
+            std::memset(contents + numRead, 0, size - numRead);
+            break;
+        }
+        numRead += result;
+    }
+}
+
+
+void TiledImage::_writeTile(long tileIndex, const char* fn_nonnull contents) {
+    auto size = _getTileContentsSize();
+    auto offset = static_cast<off_t>(tileIndex * size);
+    long numWritten = 0;
+    while (numWritten < size) {
+        auto result = pwrite(_fileDescriptor, contents + numWritten, size - numWritten, offset + numWritten);
+        if (result <= 0) {
+            _ioFailed.store(true);
+            return;
+        }
+        numWritten += result;
+    }
+}
+
+
+char* fn_nonnull TiledImage::_lockTile(long tileIndex) {
+    std::unique_lock lock(_mutex);
+    while (true) {
+        auto tile = _tiles.find(tileIndex);
+        if (tile == _tiles.end()) {
+            break;
+        }
+        
+        // Another thread is reading or writing the tile
+        if (tile->second.busy) {
+            _condition.wait(lock);
+            continue;
+        }
+        
+        // Cache hit
+        if (tile->second.numUsers == 0) {
+            _recentlyUsed.erase(tile->second.position);
+        }
+        tile->second.numUsers += 1;
+        return tile->second.contents;
+    }
+    
+    // Reserve the tile, so other threads wait for it instead of reading it too
+    _tiles[tileIndex] = _Tile {
+        .contents = nullptr,
+        .numUsers = 1,
+        .busy = true,
+        .dirty = false,
+        .position = {}
+    };
+    
+    // Reuse memory of the least recently used tile if the cache is full
+    char* contents = nullptr;
+    long evictedIndex = -1;
+    if (static_cast<long>(_tiles.size()) > _maxCachedTiles && _recentlyUsed.empty() == false) {
+        evictedIndex = _recentlyUsed.back();
+        _recentlyUsed.pop_back();
+        
+        auto& evicted = _tiles[evictedIndex];
+        contents = evicted.contents;
+        if (evicted.dirty) {
+            evicted.busy = true;
+        }
+        else {
+            _tiles.erase(evictedIndex);
+            evictedIndex = -1;
+        }
+    }
+    lock.unlock();
+    
+    // Write back modified tile without holding the lock
+    if (evictedIndex >= 0) {
+        _writeTile(evictedIndex, contents);
+        lock.lock();
+        _tiles.erase(evictedIndex);
+        lock.unlock();
+    }
+    
+    if (contents == nullptr) {
+        contents = ImageAllocator::allocate(_getTileContentsSize());
+    }
+    _readTile(tileIndex, contents);
+    
+    lock.lock();
+    auto& tile = _tiles[tileIndex];
+    tile.contents = contents;
+    tile.busy = false;
+    lock.unlock();
+    _condition.notify_all();
+    
+    return contents;
+}
+
+
+void TiledImage::_unlockTile(long tileIndex, bool modified) {
+    std::lock_guard lock(_mutex);
+    auto& tile = _tiles[tileIndex];
+    tile.dirty = tile.dirty || modified;
+    tile.numUsers -= 1;
+    if (tile.numUsers == 0) {
+        _recentlyUsed.push_front(tileIndex);
+        tile.position = _recentlyUsed.begin();
+    }
+}
+
+
+bool TiledImage::flush(ImageToolsError* fn_nullable error fn_noescape) {
+    std::unique_lock lock(_mutex);
+    for (auto& [index, tile]: _tiles) {
+        // Tiles in use are flushed when they are evicted or the image is released
+        if (tile.dirty && tile.busy == false && tile.numUsers == 0) {
+            _writeTile(index, tile.contents);
+            tile.dirty = false;
+        }
+    }
+    lock.unlock();
+    
+    if (_ioFailed.load() || fsync(_fileDescriptor) != 0) {
+        ImageToolsError::set(error, "Could not read or write tiles file");
+        return false;
+    }
+    
+    return true;
+}
+
+
+// MARK: - Regions
+
+void TiledImage::_copyRegion(long x, long y, long width, long height, char* fn_nonnull pixels, bool write) {
+    auto pixelSize = _pixelFormat.getSize();
+    auto firstTileX = x / _tileSize;
+    auto firstTileY = y / _tileSize;
+    auto lastTileX = (x + width - 1) / _tileSize;
+    auto lastTileY = (y + height - 1) / _tileSize;
+    
+    for (auto tileY = firstTileY; tileY <= lastTileY; tileY++) {
+        for (auto tileX = firstTileX; tileX <= lastTileX; tileX++) {
+            // Intersection of the tile and the region
+            auto left = std::max(x, tileX * _tileSize);
+            auto right = std::min(x + width, (tileX + 1) * _tileSize);
+            auto top = std::max(y, tileY * _tileSize);
+            auto bottom = std::min(y + height, (tileY + 1) * _tileSize);
+            
+            auto tileIndex = tileY * _numTilesX + tileX;
+            auto tileContents = _lockTile(tileIndex);
+            auto rowSize = (right - left) * pixelSize;
+            for (auto row = top; row < bottom; row++) {
+                auto tilePixels = tileContents + ((row - tileY * _tileSize) * _tileSize + (left - tileX * _tileSize)) * pixelSize;
+                auto regionPixels = pixels + ((row - y) * width + (left - x)) * pixelSize;
+                if (write) {
+                    std::memcpy(tilePixels, regionPixels, rowSize);
+                }
+                else {
+                    std::memcpy(regionPixels, tilePixels, rowSize);
+                }
+            }
+            _unlockTile(tileIndex, write);
+        }
+    }
+}
+
+
+ImageContainer* fn_nonnull TiledImage::_createRegionImage(long x, long y, long width, long height) {
+    auto image = ImageContainer::create(_pixelFormat, _colorProfile, _sRGB, _hdr, width, height, 1);
+    _copyRegion(x, y, width, height, image->_contents, false);
+    return image;
+}
+
+
+void TiledImage::_setRegionImage(ImageContainer* fn_nonnull image, long x, long y) {
+    image->_ensureDecoded();
+    
+    // Clip to image bounds
+    auto left = std::max(0l, x);
+    auto top = std::max(0l, y);
+    auto right = std::min(_width, x + image->_width);
+    auto bottom = std::min(_height, y + image->_height);
+    if (left >= right || top >= bottom) {
+        return;
+    }
+    
+    auto pixelSize = _pixelFormat.getSize();
+    if (image->getIsPacked() && left == x && right == x + image->_width) {
+        _copyRegion(left, top, right - left, bottom - top, image->_contents + (top - y) * image->_width * pixelSize, true);
+        return;
+    }
+    
+    // Rows of the clipped or padded region are not contiguous
+    for (auto row = top; row < bottom; row++) {
+        auto pixels = image->_getRow(row - y, 0) + (left - x) * pixelSize;
+        _copyRegion(left, row, right - left, 1, pixels, true);
+    }
+}
+
+
+ImageContainer* fn_nullable TiledImage::createImage(long x, long y, long width, long height, ImageToolsError* fn_nullable error fn_noescape) {
+    if (width < 1 || height < 1 || x < 0 || y < 0 || x + width > _width || y + height > _height) {
+        ImageToolsError::set(error, "Region is out of image bounds");
+        return nullptr;
+    }
+    
+    return _createRegionImage(x, y, width, height);
+}
+
+
+bool TiledImage::setImage(ImageContainer* fn_nonnull image, long x, long y, ImageToolsError* fn_nullable error fn_noescape) {
+    if (!(image->getPixelFormat() == _pixelFormat) || image->getDepth() != 1) {
+        ImageToolsError::set(error, "Image must be flat and have the same pixel format");
+        return false;
+    }
+    
+    _setRegionImage(image, x, y);
+    return true;
+}
+
+
+// MARK: - Processing
+
+TiledImage* fn_nullable TiledImage::_process(TiledImage* fn_nonnull destination, void* fn_nullable context, ImageContainer* fn_nonnull (* fn_nonnull function)(TiledImage* fn_nonnull source, void* fn_nullable context, long x, long y, long width, long height), ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    auto numTiles = destination->_numTilesX * destination->_numTilesY;
+    std::atomic<long> numProcessedTiles = 0;
+    std::atomic<bool> cancelled = false;
+    std::mutex progressMutex;
+    
+    // Tiles are processed in row-major order, so neighbouring threads share source tiles in the cache.
+    // Tiles are the unit of parallelism, conversions of a single tile run serially on its worker thread
+    CONCURRENT_LOOP_START(0, numTiles, tileIndex) {
+        if (cancelled.load() == false) {
+            auto x = (tileIndex % destination->_numTilesX) * destination->_tileSize;
+            auto y = (tileIndex / destination->_numTilesX) * destination->_tileSize;
+            auto width = std::min(destination->_tileSize, destination->_width - x);
+            auto height = std::min(destination->_tileSize, destination->_height - y);
+            
+            auto tile = function(this, context, x, y, width, height);
+            destination->_setRegionImage(tile, x, y);
+            ImageContainerRelease(tile);
+            
+            auto processed = numProcessedTiles.fetch_add(1) + 1;
+            if (progressCallback) {
+                std::lock_guard lock(progressMutex);
+                if (progressCallback(userInfo, static_cast<float>(processed) / numTiles)) {
+                    cancelled.store(true);
+                }
+            }
+        }
+    } CONCURRENT_LOOP_END
+    
+    if (cancelled.load()) {
+        if (error) {
+            error->set(ImageToolsErrorCode::taskCancelled);
+        }
+        TiledImageRelease(destination);
+        return nullptr;
+    }
+    
+    if (_ioFailed.load() || destination->_ioFailed.load()) {
+        ImageToolsError::set(error, "Could not read or write tiles file");
+        TiledImageRelease(destination);
+        return nullptr;
+    }
+    
+    return destination;
+}
+
+
+/// Creates an image with the pixel format and colour information of a processed 1x1 probe image.
+static ImageContainer* fn_nonnull _createProbe(TiledImage* fn_nonnull image) {
+    return ImageContainer::create(image->getPixelFormat(), image->getColorProfile(), image->getSRGB(), image->getHDR(), 1, 1, 1);
+}
+
+
+TiledImage* fn_nullable TiledImage::createPromoted(PixelComponentType componentType, ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    auto pixelFormat = ImagePixelFormat(componentType, _pixelFormat.numComponents, _pixelFormat.hasAlpha);
+    auto destination = _createDerived(pixelFormat, _colorProfile, _sRGB, _hdr, _width, _height, error);
+    if (destination == nullptr) {
+        return nullptr;
+    }
+    
+    return _process(destination, &componentType, [](TiledImage* fn_nonnull source, void* fn_nullable context, long x, long y, long width, long height) {
+        auto tile = source->_createRegionImage(x, y, width, height);
+        tile->_setComponentType(*reinterpret_cast<PixelComponentType*>(context));
+        return tile;
+    }, error, userInfo, progressCallback);
+}
+
+
+TiledImage* fn_nullable TiledImage::createSRGBToLinearConverted(bool preserveAlpha, ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    auto probe = _createProbe(this);
+    probe->_sRGBToLinear(preserveAlpha);
+    auto destination = _createDerived(_pixelFormat, probe->_colorProfile, probe->_sRGB, probe->_hdr, _width, _height, error);
+    ImageContainerRelease(probe);
+    if (destination == nullptr) {
+        return nullptr;
+    }
+    
+    return _process(destination, &preserveAlpha, [](TiledImage* fn_nonnull source, void* fn_nullable context, long x, long y, long width, long height) {
+        auto tile = source->_createRegionImage(x, y, width, height);
+        tile->_sRGBToLinear(*reinterpret_cast<bool*>(context));
+        return tile;
+    }, error, userInfo, progressCallback);
+}
+
+
+TiledImage* fn_nullable TiledImage::createLinearToSRGBConverted(bool preserveAlpha, ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    auto probe = _createProbe(this);
+    probe->_linearToSRGB(preserveAlpha);
+    auto destination = _createDerived(_pixelFormat, probe->_colorProfile, probe->_sRGB, probe->_hdr, _width, _height, error);
+    ImageContainerRelease(probe);
+    if (destination == nullptr) {
+        return nullptr;
+    }
+    
+    return _process(destination, &preserveAlpha, [](TiledImage* fn_nonnull source, void* fn_nullable context, long x, long y, long width, long height) {
+        auto tile = source->_createRegionImage(x, y, width, height);
+        tile->_linearToSRGB(*reinterpret_cast<bool*>(context));
+        return tile;
+    }, error, userInfo, progressCallback);
+}
+
+
+TiledImage* fn_nullable TiledImage::createResampled(float quality, long width, long height, bool renormalize, ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) {
+    width = std::max(1l, width);
+    height = std::max(1l, height);
+    
+    // Resampling leaves pixels in the linear version of the colour profile
+    auto probe = _createProbe(this);
+    LCMSColorProfileRelease(probe->_convertToLinearProfile());
+    auto destination = _createDerived(_pixelFormat, probe->_colorProfile, probe->_sRGB, probe->_hdr, width, height, error);
+    ImageContainerRelease(probe);
+    if (destination == nullptr) {
+        return nullptr;
+    }
+    
+    struct Context {
+        float quality;
+        bool renormalize;
+        long width;
+        long height;
+    };
+    auto context = Context {
+        .quality = quality,
+        .renormalize = renormalize,
+        .width = width,
+        .height = height
+    };
+    return _process(destination, &context, [](TiledImage* fn_nonnull source, void* fn_nullable contextPointer, long x, long y, long width, long height) {
+        auto& context = *reinterpret_cast<Context*>(contextPointer);
+        
+        // Source region covered by the filter, including halo
+        auto scaleX = static_cast<float>(source->_width) / context.width;
+        auto scaleY = static_cast<float>(source->_height) / context.height;
+        auto halo = static_cast<long>(ceil(context.quality)) + 1;
+        auto left = std::max(0l, static_cast<long>(floor(x * scaleX)) - halo);
+        auto top = std::max(0l, static_cast<long>(floor(y * scaleY)) - halo);
+        auto right = std::min(source->_width, static_cast<long>(ceil((x + width) * scaleX)) + halo);
+        auto bottom = std::min(source->_height, static_cast<long>(ceil((y + height) * scaleY)) + halo);
+        
+        auto tile = source->_createRegionImage(left, top, right - left, bottom - top);
+        tile->_resampleRegion(context.quality, context.renormalize, source->_width, source->_height, left, top, context.width, context.height, x, y, width, height);
+        return tile;
+    }, error, userInfo, progressCallback);
+}
+
+
+bool TiledImage::setChannel(long channelIndex, TiledImage* fn_nonnull sourceImage, long sourceChannelIndex, ImageToolsError* fn_nullable error fn_noescape) {
+    if (sourceImage->_width != _width || sourceImage->_height != _height) {
+        ImageToolsError::set(error, "Image sizes are not equal. Resize the source or destination image first to match the sizes");
+        return false;
+    }
+    if (channelIndex >= _pixelFormat.numComponents || sourceChannelIndex >= sourceImage->_pixelFormat.numComponents) {
+        ImageToolsError::set(error, "Channel index out ouf bounds");
+        return false;
+    }
+    
+    // Modify tiles in place, every tile is processed serially on its worker thread
+    CONCURRENT_LOOP_START(0, _numTilesX * _numTilesY, tileIndex) {
+        auto x = (tileIndex % _numTilesX) * _tileSize;
+        auto y = (tileIndex / _numTilesX) * _tileSize;
+        auto width = std::min(_tileSize, _width - x);
+        auto height = std::min(_tileSize, _height - y);
+        
+        auto tile = _createRegionImage(x, y, width, height);
+        auto sourceTile = sourceImage->_createRegionImage(x, y, width, height);
+        tile->_setChannel(channelIndex, sourceTile, sourceChannelIndex, nullptr);
+        _setRegionImage(tile, x, y);
+        ImageContainerRelease(sourceTile);
+        ImageContainerRelease(tile);
+    } CONCURRENT_LOOP_END
+    
+    if (_ioFailed.load() || sourceImage->_ioFailed.load()) {
+        ImageToolsError::set(error, "Could not read or write tiles file");
+        return false;
+    }
+    
+    return true;
+}
+
+
+FN_IMPLEMENT_SWIFT_INTERFACE1(TiledImage)
@@ -0,0 +1,133 @@
+//
+//  ToneMapping.cpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#include "ToneMapping.hpp"
+#include <algorithm>
+
+
+// MARK: - Operators
+
+static inline float _clampToneMapping(float value) {
+    return std::min(1.0f, value);
+}
+
+
+static inline float _reinhard(float value) {
+    return value / (1 + value);
+}
+
+
+/// Krzysztof Narkowicz's fit of the ACES reference rendering transform.
+static inline float _aces(float value) {
+    auto numerator = value * (2.51f * value + 0.03f);
+    auto denominator = value * (2.43f * value + 0.59f) + 0.14f;
+    return std::min(1.0f, numerator / denominator);
+}
+
+
+/// John Hable's filmic curve from Uncharted 2.
+static constexpr float _hableCurve(float value) {
+    constexpr float a = 0.15f; // Shoulder strength
+    constexpr float b = 0.50f; // Linear strength
+    constexpr float c = 0.10f; // Linear angle
+    constexpr float d = 0.20f; // Toe strength
+    constexpr float e = 0.02f; // Toe numerator
+    constexpr float f = 0.30f; // Toe denominator
+    return (value * (a * value + c * b) + d * e) / (value * (a * value + b) + d * f) - e / f;
+}
+
+
+/// Scale that maps the white point of 11.2 to 1.
+static constexpr float _hableWhiteScale = 1 / _hableCurve(11.2f);
+
+
+static inline float _hable(float value) {
+    return std::min(1.0f, _hableCurve(value) * _hableWhiteScale);
+}
+
+
+template<float (* curve)(float)>
+static void _applyToneMapping(float exposureScale, float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    if (numColorComponents == numComponents) {
+        auto count = numPixels * numComponents;
+        for (long index = 0; index < count; index++) {
+            // std::max returns the first argument for NaN
+            values[index] = curve(std::max(0.0f, values[index] * exposureScale));
+        }
+        return;
+    }
+    
+    for (long index = 0; index < numPixels; index++) {
+        auto pixel = values + index * numComponents;
+        for (long i = 0; i < numColorComponents; i++) {
+            pixel[i] = curve(std::max(0.0f, pixel[i] * exposureScale));
+        }
+        pixel[numColorComponents] = std::min(1.0f, std::max(0.0f, pixel[numColorComponents]));
+    }
+}
+
+
+void applyToneMapping(ToneMappingOperator toneMappingOperator, float exposureScale, float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents) {
+    switch (toneMappingOperator) {
+        case ToneMappingOperator::clamp:
+            _applyToneMapping<_clampToneMapping>(exposureScale, values, numPixels, numComponents, numColorComponents);
+            return;
+            
+        case ToneMappingOperator::reinhard:
+            _applyToneMapping<_reinhard>(exposureScale, values, numPixels, numComponents, numColorComponents);
+            return;
+            
+        case ToneMappingOperator::aces:
+            _applyToneMapping<_aces>(exposureScale, values, numPixels, numComponents, numColorComponents);
+            return;
+            
+        case ToneMappingOperator::hable:
+            _applyToneMapping<_hable>(exposureScale, values, numPixels, numComponents, numColorComponents);
+            return;
+    }
+}
+
+
+// MARK: - Quantization
+
+/// Chris Wellons' lowbias32 integer hash.
+static inline uint32_t _hash(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x7feb352d;
+    value ^= value >> 15;
+    value *= 0x846ca68b;
+    value ^= value >> 16;
+    return value;
+}
+
+
+/// Sum of two uniform random values in the (-1, 1) range, so noise doesn't depend on the signal.
+static inline float _triangularNoise(uint32_t seed) {
+    auto hash = _hash(seed);
+    auto first = static_cast<float>(hash & 0xffff);
+    auto second = static_cast<float>(hash >> 16);
+    return (first + second) * (1.0f / 65536.0f) - 1.0f;
+}
+
+
+void quantizeToUInt8(const float* fn_nonnull values, uint8_t* fn_nonnull destination, long numPixels, long numComponents, long numColorComponents, bool dither, long firstPixelIndex) {
+    auto count = numPixels * numComponents;
+    
+    if (dither == false) {
+        for (long index = 0; index < count; index++) {
+            destination[index] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, values[index] * 255.0f + 0.5f)));
+        }
+        return;
+    }
+    
+    for (long index = 0; index < count; index++) {
+        auto component = index % numComponents;
+        auto seed = static_cast<uint32_t>(firstPixelIndex * numComponents + index);
+        auto noise = component < numColorComponents ? _triangularNoise(seed) : 0.0f;
+        destination[index] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, values[index] * 255.0f + 0.5f + noise)));
+    }
+}
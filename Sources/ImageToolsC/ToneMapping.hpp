@@ -0,0 +1,22 @@
+//
+//  ToneMapping.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+
+
+// Loops are branchless and work on blocks of float pixels, so compilers vectorize them.
+
+/// Scales colour components of linear pixels by `exposureScale` and compresses them into the [0, 1] range in place. Negative and NaN values become 0, alpha is clamped.
+void applyToneMapping(ToneMappingOperator toneMappingOperator, float exposureScale, float* fn_nonnull values, long numPixels, long numComponents, long numColorComponents);
+
+/// Rounds pixels in the [0, 1] range to `uint8`.
+///
+/// If `dither` is `true`, colour components get triangular noise of one step, which hides banding of smooth gradients. Noise depends only on `firstPixelIndex` and the pixel position after it, so results don't depend on how pixels are split between threads.
+void quantizeToUInt8(const float* fn_nonnull values, uint8_t* fn_nonnull destination, long numPixels, long numComponents, long numColorComponents, bool dither, long firstPixelIndex);
@@ -0,0 +1,62 @@
+//
+//  ColorLUT.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+
+
+/// Interpolation between entries of a 3D lookup table.
+enum class ColorLUTInterpolation: uint32_t {
+    /// Blends 8 surrounding entries.
+    trilinear = 0,
+    
+    /// Blends 4 entries of the tetrahedron containing the colour. Faster than trilinear and keeps the neutral axis neutral.
+    tetrahedral = 1
+};
+
+
+/// 3D colour lookup table loaded from an _.cube_ file.
+///
+/// Tables are applied to images using ``ImageEditor/applyColorLUT``.
+///
+/// - Note: This object is immutable and thread-safe.
+class ColorLUT final {
+private:
+    std::atomic<size_t> _referenceCounter;
+    
+    /// Number of entries along every axis.
+    long _size;
+    float _domainMin[3];
+    float _domainMax[3];
+    
+    /// RGB entries, red changes fastest like in _.cube_ files.
+    std::vector<float> _entries;
+    
+    ColorLUT(long size, const float* fn_nonnull domainMin, const float* fn_nonnull domainMax, std::vector<float>&& entries);
+    ~ColorLUT();
+    
+    friend class ImageContainer;
+    FN_FRIEND_SWIFT_INTERFACE(ColorLUT)
+    
+    /// Replaces the first 3 components of float pixels with table values. Other components are not changed.
+    void _apply(float* fn_nonnull values, long numPixels, long numComponents, ColorLUTInterpolation interpolation) const;
+    
+public:
+    /// Parses the _.cube_ format. Only 3D tables are supported.
+    static ColorLUT* fn_nullable load(const char* fn_nonnull buffer fn_noescape, long bufferSize, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(buffer:size:_:)) SWIFT_RETURNS_RETAINED;
+    static ColorLUT* fn_nullable load(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(path:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a table with the [0, 1] domain from `size * size * size` RGB entries, red changes fastest.
+    static ColorLUT* fn_nullable create(long size, const float* fn_nonnull entries fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createUnsafe(size:entries:_:)) SWIFT_RETURNS_RETAINED;
+    
+    long getSize() SWIFT_COMPUTED_PROPERTY;
+} FN_SWIFT_INTERFACE(ColorLUT);
+
+
+FN_DEFINE_SWIFT_INTERFACE(ColorLUT)
@@ -0,0 +1,55 @@
+//
+//  ImageAllocator.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+
+
+/// Alignment of memory allocated by ImageAllocator in bytes.
+#define IMAGE_ALLOCATOR_ALIGNMENT 64
+
+
+/// Custom memory arena.
+struct ImageAllocatorArena {
+    void* fn_nullable userInfo;
+    
+    /// Allocates memory of the size aligned to the alignment. Returns `nullptr` if the arena can't allocate memory, in which case the default allocator is used.
+    void* fn_nullable (* fn_nonnull allocate)(void* fn_nullable userInfo, long size, long alignment);
+    
+    /// Releases memory allocated by the arena. Receives the same size and alignment as in the allocation.
+    void (* fn_nonnull deallocate)(void* fn_nullable userInfo, void* fn_nonnull memory, long size, long alignment);
+};
+
+
+/// Allocates image contents and intermediate processing buffers.
+///
+/// Large buffers are rounded up to size classes and kept in a pool after they are released, so processing functions that repeatedly need scratch memory of similar sizes reuse already mapped pages instead of requesting new ones from the system.
+///
+/// - Note: This object is thread-safe.
+class ImageAllocator final {
+public:
+    /// Allocates memory aligned to `IMAGE_ALLOCATOR_ALIGNMENT`.
+    static char* fn_nonnull allocate(long size);
+    
+    /// Releases memory allocated by ``allocate``. Large buffers are kept in the pool.
+    static void deallocate(char* fn_nullable memory);
+    
+    /// Sets the arena used for new allocations. If `nullptr`, the default allocator is used.
+    ///
+    /// Memory allocated before the call is still released to the arena it was allocated from. The pool is trimmed.
+    static void setArena(const ImageAllocatorArena* fn_nullable arena);
+    
+    /// Sets the maximum size of released buffers kept in the pool in bytes. `256` megabytes by default, `0` disables pooling.
+    static void setMaxPooledSize(long size);
+    
+    /// Size of released buffers kept in the pool in bytes.
+    static long getPooledSize();
+    
+    /// Releases all pooled buffers.
+    static void trim();
+};
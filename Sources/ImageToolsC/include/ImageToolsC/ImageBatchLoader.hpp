@@ -0,0 +1,91 @@
+//
+//  ImageBatchLoader.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+#include <LCMS2C/LCMS2C.hpp>
+#include <string>
+#include <vector>
+
+
+/// Batch loading result callback.
+///
+/// Called on the thread that called ``ImageBatchLoader/load`` once for every item, in the order the items finish loading.
+///
+/// - Parameter index: Index of the item in the order it was added to the loader.
+/// - Parameter image: Loaded image or `nullptr` if loading failed. The image is released after the callback returns, retain it to keep it.
+/// - Parameter error: Reason of the failure or `nullptr` if the image was loaded.
+/// - Returns: `true` if the operation should be cancelled, otherwise `false`.
+typedef bool (* ImageBatchLoaderCallback)(void* fn_nullable userInfo, long index, ImageContainer* fn_nullable image, const ImageToolsError* fn_nullable error);
+
+
+/// Loads many images in parallel.
+///
+/// Files are read into memory on I/O threads and decoded on separate decode threads, so reading the next files overlaps with decoding the previous ones. Every decode thread processes its image serially, so decode threads don't spawn more threads. Encoded and decoded bytes that are not yet passed to the callback are capped by `maxInFlightBytes`, so a slow consumer throttles reading and decoding.
+///
+/// - Warning: This object is not thread-safe. Access this object only from one thread at a time.
+class ImageBatchLoader final {
+private:
+    struct _Item {
+        bool usePath;
+        std::string path;
+        const void* fn_nullable buffer;
+        long bufferSize;
+        
+        /// Copy of the buffer if requested.
+        std::vector<char> contents;
+    };
+    
+    std::atomic<size_t> _referenceCounter;
+    
+    long _ioConcurrency;
+    long _decodeConcurrency;
+    long _maxInFlightBytes;
+    std::vector<_Item> _items;
+    
+    ImageBatchLoader(long ioConcurrency, long decodeConcurrency, long maxInFlightBytes);
+    ~ImageBatchLoader();
+    
+    FN_FRIEND_SWIFT_INTERFACE(ImageBatchLoader)
+    
+public:
+    /// Creates a batch loader.
+    ///
+    /// - Parameter ioConcurrency: Number of threads reading files. `0` to choose automatically.
+    /// - Parameter decodeConcurrency: Number of threads decoding images. `0` to choose automatically.
+    /// - Parameter maxInFlightBytes: Maximum number of encoded and decoded bytes waiting to be passed to the callback. `0` for no limit.
+    static ImageBatchLoader* fn_nonnull create(long ioConcurrency = 0, long decodeConcurrency = 0, long maxInFlightBytes = 0) SWIFT_NAME(create(ioConcurrency:decodeConcurrency:maxInFlightBytes:)) SWIFT_RETURNS_RETAINED;
+    
+    long getIOConcurrency() SWIFT_COMPUTED_PROPERTY { return _ioConcurrency; }
+    long getDecodeConcurrency() SWIFT_COMPUTED_PROPERTY { return _decodeConcurrency; }
+    long getMaxInFlightBytes() SWIFT_COMPUTED_PROPERTY { return _maxInFlightBytes; }
+    long getNumItems() SWIFT_COMPUTED_PROPERTY { return static_cast<long>(_items.size()); }
+    
+    /// Adds a file to load and returns its index.
+    long addPath(const char* fn_nonnull path fn_noescape) SWIFT_NAME(add(path:));
+    
+    /// Adds an encoded image in memory and returns its index.
+    ///
+    /// - Parameter copy: Copy the buffer. If `false`, keep the buffer alive until ``load`` returns.
+    long addBuffer(const void* fn_nonnull buffer, long bufferSize, bool copy = false) SWIFT_NAME(__addUnsafe(buffer:size:copy:));
+    
+    /// Removes all items.
+    void removeAll();
+    
+    /// Loads all items and passes results to the callback in completion order.
+    ///
+    /// Blocks until all items are loaded or the callback cancels the operation.
+    ///
+    /// - Returns: `true` if all items were passed to the callback, `false` if the callback cancelled the operation.
+    bool load(LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, void* fn_nullable userInfo, ImageBatchLoaderCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(_:_:userInfo:callback:error:));
+} FN_SWIFT_INTERFACE(ImageBatchLoader);
+
+
+FN_DEFINE_SWIFT_INTERFACE(ImageBatchLoader)
@@ -8,10 +8,13 @@
 #pragma once
 
 #include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageAllocator.hpp>
 #include <ImageToolsC/ImagePixel.hpp>
 #include <ImageToolsC/ProgressCallback.hpp>
+#include <ImageToolsC/ColorLUT.hpp>
 #include <LCMS2C/LCMS2C.hpp>
 #include <ASTCEncoderC/ASTCEncoderC.hpp>
+#include <mutex>
 
 
 struct ImageContainerCollection;
@@ -50,14 +53,17 @@ enum class PixelComponentType: long {
     /// Unsigned 8-bit integer.
     uint8 = 0,
     
-    //uint16 = 1,
-    //uint32 = 2,
-    
     /// Half-precision floating point value.
     float16 = 1,
     
     /// Floating point value.
-    float32 = 2
+    float32 = 2,
+    
+    /// Unsigned 16-bit integer.
+    uint16 = 3,
+    
+    /// Unsigned 32-bit integer.
+    uint32 = 4
 };
 
 
@@ -97,13 +103,81 @@ struct ImagePixelFormat {
 };
 
 
+/// Statistics of one pixel component. See ``ImageContainer/calculateStatistics``.
+struct ImageChannelStatistics {
+    /// Number of finite values. If `0`, other fields except NaN and infinity counts are `0` too.
+    long numValues;
+    
+    float min;
+    float max;
+    double mean;
+    
+    /// Population variance.
+    double variance;
+    
+    long numNaNs;
+    long numInfinities;
+};
+
+
+/// Image loading options.
+///
+/// Allows to extract only a region of an image and/or to reduce its size by a power-of-two factor while loading.
+///
+/// - Note: Decoders always decode the whole image at full size, so decoding takes as long as without options. Only the region is copied into the ``ImageContainer``, which saves memory and the cost of cropping and resampling afterwards.
+struct ImageLoadOptions {
+    /// Left edge of the region to decode in pixels of the full-size image.
+    long regionX;
+    
+    /// Top edge of the region to decode in pixels of the full-size image.
+    long regionY;
+    
+    /// Width of the region to decode. If `0`, the region spans to the right edge of the image.
+    long regionWidth;
+    
+    /// Height of the region to decode. If `0`, the region spans to the bottom edge of the image.
+    long regionHeight;
+    
+    /// Reduction factor - `1`, `2`, `4` or `8`. Loading fails for other factors and for regions outside of the image.
+    ///
+    /// Every `reductionFactor x reductionFactor` block of the decoded region is averaged into one pixel. Colour components of 8 and 16-bit sRGB images are averaged in the linear space.
+    long reductionFactor;
+    
+    /// Decodes the whole image at full size.
+    ImageLoadOptions();
+    ImageLoadOptions(long regionX, long regionY, long regionWidth, long regionHeight, long reductionFactor = 1);
+    
+    /// Decodes the whole image reduced by the specified factor.
+    static ImageLoadOptions reduced(long reductionFactor);
+};
+
+
 enum class ResamplingAlgorithm: long {
     lanczos = 0
 };
 
 
+/// Curves that compress linear HDR values into the [0, 1] range.
+enum class ToneMappingOperator: long {
+    /// Clips values above 1.
+    clamp = 0,
+    
+    /// `c / (1 + c)` - keeps shadows and midtones, desaturates highlights.
+    reinhard = 1,
+    
+    /// Krzysztof Narkowicz's fit of the ACES filmic curve.
+    aces = 2,
+    
+    /// John Hable's filmic curve with the white point of 11.2.
+    hable = 3
+};
+
+
 #define IMAGE_CONTAINER_COLLECTION_MAX_IMAGES 23
 
+/// Alignment of contents allocated by ImageContainer and of padded rows in bytes.
+#define IMAGE_CONTAINER_CONTENTS_ALIGNMENT IMAGE_ALLOCATOR_ALIGNMENT
+
 struct ImageContainerCollection final {
 private:
     long _numImages;
@@ -122,6 +196,10 @@ public:
 };
 
 
+/// Releases image contents that are not allocated by ImageContainer.
+typedef void (* ImageContentsReleaseCallback)(void* fn_nullable userInfo, char* fn_nonnull contents);
+
+
 /// Image container.
 ///
 /// - Note: This object is immutable and thus thread-safe. You can access its properties from any thread.
@@ -142,12 +220,28 @@ private:
     /// Assumption that colour values may exceed standard dynamic range.
     bool _hdr;
     
-    // bool _borrowedContents;
-    char* fn_nonnull _contents;
+    /// `nullptr` until a lazily loaded container is decoded.
+    char* fn_nullable _contents;
     long _width;
     long _height;
     long _depth;
     
+    /// Distance between rows in bytes. Rows may be padded, for example to align them for SIMD processing.
+    long _bytesPerRow;
+    
+    /// Distance between slices in bytes.
+    long _bytesPerSlice;
+    
+    /// Releases contents that are not allocated by ImageAllocator, for example a file mapping. If `nullptr`, contents are returned to ImageAllocator.
+    ImageContentsReleaseCallback fn_nullable _contentsRelease;
+    void* fn_nullable _contentsReleaseUserInfo;
+    
+    /// Encoded image of a lazily loaded container. `nullptr` once pixels are decoded, kept together with the error if decoding failed.
+    struct _LazySource;
+    _LazySource* fn_nullable _lazySource;
+    std::atomic<bool> _decoded;
+    std::mutex _decodeMutex;
+    
     
     struct _LoadInfo {
         bool usePath;
@@ -161,59 +255,215 @@ private:
                 long bufferSize;
             };
         };
+        
+        ImageLoadOptions options;
     };
     
-    static ImageContainer* fn_nullable _tryLoadTGA(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED;
-    static ImageContainer* fn_nullable _tryLoadJPEG(const _LoadInfo& info fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB) SWIFT_RETURNS_RETAINED;
-    static ImageContainer* fn_nullable _tryLoadPNG(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED;
-    static ImageContainer* fn_nullable _tryLoadOpenEXR(const _LoadInfo& info fn_noescape) SWIFT_RETURNS_RETAINED;
+    // Loaders return `nullptr` without setting the error if the image has a different format
+    static ImageContainer* fn_nullable _tryLoadTGA(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable _tryLoadJPEG(const _LoadInfo& info fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable _tryLoadPNG(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable _tryLoadOpenEXR(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable _tryLoadNative(const _LoadInfo& info fn_noescape, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
     static ImageContainer* fn_nullable _load(const _LoadInfo& info fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    /// Parses the image header with the decoder that decodes it later. Returns `false` if the header can't be parsed without decoding the whole image.
+    static bool _probe(const _LoadInfo& info fn_noescape, ImagePixelFormat* fn_nonnull pixelFormat, long* fn_nonnull width, long* fn_nonnull height, bool* fn_nonnull hdr);
+    static ImageContainer* fn_nullable _loadLazily(const _LoadInfo& info fn_noescape, _LazySource* fn_nonnull lazySource, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
     
     
     ImageContainer(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, char* fn_nonnull contents, long width, long height, long depth);
+    /// Creates a lazily loaded container without contents.
+    ImageContainer(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, _LazySource* fn_nonnull lazySource, long width, long height);
     ~ImageContainer();
     
     
+    /// Contents buffer together with the function that releases it.
+    struct _Contents {
+        char* fn_nonnull contents;
+        ImageContentsReleaseCallback fn_nullable release;
+        void* fn_nullable releaseUserInfo;
+    };
+    
+    /// Allocates a buffer in the same kind of storage as contents of this container - memory or a temporary file.
+    _Contents _allocateContents(long size);
+    static void _releaseContents(const _Contents& contents);
+    /// Releases current contents and takes ownership of the new ones.
+    void _replaceContents(const _Contents& contents);
+    /// Changes size of contents preserving their beginning.
+    void _resizeContents(long oldSize, long newSize);
+    
+    /// Sets distances between rows and slices for current dimensions and pixel format. Rows and slices are tightly packed if distances are smaller than their sizes.
+    void _setBytesPerRow(long bytesPerRow, long bytesPerSlice = 0);
+    char* fn_nonnull _getRow(long y, long z) { return _contents + z * _bytesPerSlice + y * _bytesPerRow; }
+    /// Removes row padding. Functions that pass contents to libraries without stride support, like LCMS and the ASTC encoder, or process them as a whole pack contents first.
+    void _pack();
+    /// Copies pixels into a container of the same size and pixel format.
+    void _copyContents(ImageContainer* fn_nonnull destination);
+    /// Number of pixel runs that can be processed independently. Tightly packed contents are split into runs spanning several rows, otherwise every row is a run.
+    long _getNumPixelRuns();
+    /// Returns the first pixel of the run and the number of pixels in it.
+    char* fn_nonnull _getPixelRun(long index, long* fn_nonnull numPixels);
+    
+    
     friend class ImageEditor;
+    friend class ImageRowSource;
+    friend struct ColorProfileRowStage;
+    friend class TiledImage;
+    friend class ImagePyramidBuilder;
     FN_FRIEND_SWIFT_INTERFACE(ImageContainer)
     
     
+    /// Decodes pixels of a lazily loaded container if not decoded yet.
+    void _ensureDecoded() {
+        if (_decoded.load(std::memory_order_acquire) == false) {
+            _decode(nullptr);
+        }
+    }
+    bool _decode(ImageToolsError* fn_nullable error fn_noescape);
+    
+    /// Checks if nobody else references the container and its contents can be modified in place. Borrowed contents and mapped image files are never modified.
+    bool _checkIsUniquelyReferenced();
+    
     void _assignColorProfile(LCMSColorProfile* fn_nullable colorProfile);
     bool _convertColorProfile(LCMSColorProfile* fn_nullable colorProfile);
     void _setComponentType(PixelComponentType componentType);
     bool _setNumComponents(long numComponents, float fill, ImageToolsError* fn_nullable error fn_noescape);
+    /// Accesses tightly packed contents with the specified layout. Used while the number of components changes.
     ImagePixel _getPixel(long x, long y, long z, long numComponents, PixelComponentType componentType);
     void _setPixel(ImagePixel pixel, long x, long y, long z, long numComponents, PixelComponentType componentType);
+    ImagePixel _getPixel(long x, long y, long z);
     void _setPixel(ImagePixel pixel, long x, long y, long z);
     bool _setChannel(long channelIndex, ImageContainer* fn_nonnull sourceImage fn_noescape, long sourceChannelIndex, ImageToolsError* fn_nullable error fn_noescape);
     
+    /// Converts pixels to the linear version of the colour profile. Returns the retained linear profile or `nullptr` if pixels are already linear.
+    LCMSColorProfile* fn_nullable _convertToLinearProfile();
     void _resample(ResamplingAlgorithm algorithm, float quality, long width, long height, long depth, bool renormalize, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape);
+    /// Resamples a region of a larger flat image using Lanczos filter in coordinates of the whole image, so neighbouring regions match seamlessly.
+    ///
+    /// The container has to contain all source pixels covered by the filter for the target region, clamped to the source image bounds.
+    void _resampleRegion(float quality, bool renormalize, long sourceWidth, long sourceHeight, long sourceX, long sourceY, long targetWidth, long targetHeight, long targetX, long targetY, long width, long height);
     
+    /// Converts pixels between sRGB and linear spaces in parallel. If `preserveAlpha` is `true`, the alpha component of pixel formats with alpha is not converted.
+    void _applyTransferFunction(bool toLinear, bool preserveAlpha);
     void _sRGBToLinear(bool preserveAlpha);
     void _linearToSRGB(bool preserveAlpha);
     
+    /// Replaces colours with values of the lookup table in parallel. If `linearize` is `true`, results are converted from sRGB to linear space in the same pass.
+    bool _applyColorLUT(const ColorLUT* fn_nonnull lut, ColorLUTInterpolation interpolation, bool linearize, ImageToolsError* fn_nullable error fn_noescape);
+    
+    /// Converts pixels to `uint8` sRGB in one parallel pass - exposure in stops, tone mapping, sRGB encoding and optional dithering.
+    void _toneMap(ToneMappingOperator toneMappingOperator, float exposure, bool dither);
+    
 public:
     static ImageContainer* fn_nonnull create(const char* fn_nonnull contents, long width, long height, ImagePixelFormat pixelFormat) SWIFT_RETURNS_RETAINED;
     static ImageContainer* fn_nonnull create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates an image container with padded rows.
+    ///
+    /// - Parameter bytesPerRow: Distance between rows in bytes. Values smaller than the row size are rounded up to it. Use ``getAlignedBytesPerRow`` to align every row for SIMD processing.
+    static ImageContainer* fn_nonnull create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, long bytesPerRow) SWIFT_NAME(create(_:_:_:_:_:_:_:bytesPerRow:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates an image container that uses external memory as its contents without copying it.
+    ///
+    /// The container doesn't modify contents - processing functions work on copies, so the container stays immutable and thread-safe as long as the caller doesn't modify contents either.
+    ///
+    /// - Parameter bytesPerRow: Distance between rows in bytes. `0` for tightly packed rows.
+    /// - Parameter bytesPerSlice: Distance between slices in bytes. `0` for tightly packed slices.
+    /// - Parameter release: Called with `userInfo` and `contents` when the container is released. If `nullptr`, contents must outlive the container.
+    static ImageContainer* fn_nonnull createBorrowing(char* fn_nonnull contents, ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, long bytesPerRow, long bytesPerSlice, void* fn_nullable userInfo, ImageContentsReleaseCallback fn_nullable release) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates an image container that refers to a region of this image without copying pixels.
+    ///
+    /// The view retains this image and shares its contents, so rows and slices of the view keep distances of this image. Views can be passed to all processing functions, copies of views have tightly packed pixels.
+    ///
+    /// - Note: The region is clamped to image bounds.
+    ImageContainer* fn_nonnull createView(long x, long y, long z, long width, long height, long depth) SWIFT_NAME(createView(x:y:z:width:height:depth:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a view of a single slice of a 3D image.
+    ImageContainer* fn_nonnull createSliceView(long z) SWIFT_NAME(createSliceView(z:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Row size of an image rounded up to `IMAGE_CONTAINER_CONTENTS_ALIGNMENT`.
+    static long getAlignedBytesPerRow(long width, ImagePixelFormat pixelFormat);
     // TODO: Implement conversion from ASTCRawImage or ASTCImage
     //static ImageContainer* fn_nonnull create(ASTCRawImage* fn_nonnull decompressedImage, ImageContainer* fn_nonnull originalImage);
     static ImageContainer* fn_nonnull createRGBA8Unorm(long width, long height) SWIFT_RETURNS_RETAINED;
     
+    /// Creates an image container with contents stored in a memory-mapped file instead of memory.
+    ///
+    /// Use it for images that don't fit into memory, the system pages contents in and out as needed. Images derived from a file-backed container, for example by ``copy``, ``createResampled`` or ``createPromoted``, and intermediate processing buffers are stored in temporary files in the same directory.
+    ///
+    /// - Parameter path: File to store contents in. The file is created or overwritten and keeps raw pixel data after the container is released. If `nullptr`, an unnamed file in the temporary directory is used.
+    static ImageContainer* fn_nullable createFileBacked(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long depth, const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createFileBackedUnsafe(_:_:_:_:_:_:_:path:_:)) SWIFT_RETURNS_RETAINED;
+    
     static ImageContainer* fn_nullable load(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(path:_:_:_:)) SWIFT_RETURNS_RETAINED;
     static ImageContainer* fn_nullable load(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(buffer:size:_:_:_:)) SWIFT_RETURNS_RETAINED;
     
+    /// Loads only a region of an image and/or a reduced version of it.
+    static ImageContainer* fn_nullable load(const char* fn_nonnull path fn_noescape, ImageLoadOptions options, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(path:options:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable load(const void* fn_nonnull buffer fn_noescape, long bufferSize, ImageLoadOptions options, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(buffer:size:options:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Saves the image in the native ImageTools format.
+    ///
+    /// The file contains a small header with pixel format, dimensions, flags and colour profile, followed by raw pixel data aligned to the memory page size, so ``open`` can map it without copying.
+    ///
+    /// - Note: Only images without colour profiles or with colour profiles created by ImageTools can be saved, since arbitrary LCMS profiles can't be serialized.
+    bool save(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__saveUnsafe(path:_:));
+    
+    /// Opens an image saved in the native ImageTools format.
+    ///
+    /// The file is mapped into memory and contents are backed by the mapping - nothing is decoded or copied, pixels are read from disk on first access. ``load`` also recognizes the native format.
+    static ImageContainer* fn_nullable open(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__openUnsafe(path:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates an image container that only parses the image header and decodes pixels on first access.
+    ///
+    /// Pixel format and dimensions are available right away. Contents, pixels, colour information and all processing functions decode the image first. Decoding happens only once and is thread-safe.
+    ///
+    /// PNG, JPEG, OpenEXR and formats decoded by stb_image are decoded lazily. FastTGA can't parse headers without decoding the whole image, so TGA images are decoded right away. Images in the native format are mapped like in ``open``.
+    ///
+    /// - Note: Buffer contents are copied.
+    static ImageContainer* fn_nullable loadLazily(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadLazilyUnsafe(path:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nullable loadLazily(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadLazilyUnsafe(buffer:size:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Checks if pixels are decoded. Always `true` for containers that are not loaded lazily, `false` if decoding failed.
+    bool getIsDecoded() SWIFT_COMPUTED_PROPERTY { return _decoded.load(std::memory_order_acquire) && _lazySource == nullptr; }
+    
+    /// Decodes pixels of a lazily loaded container.
+    ///
+    /// Implicit decoding on first access fills contents with zeros if the image can't be decoded. The decoding error is kept and reported by this function, no matter if pixels were accessed before.
+    ///
+    /// - Returns: `false` if the image could not be decoded, otherwise `true`.
+    bool decode(ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__decodeUnsafe(_:));
+    
     ImagePixelFormat getPixelFormat() SWIFT_COMPUTED_PROPERTY { return _pixelFormat; }
-    LCMSColorProfile* fn_nullable getColorProfile() SWIFT_COMPUTED_PROPERTY SWIFT_RETURNS_UNRETAINED { return _colorProfile; }
-    bool getSRGB() SWIFT_COMPUTED_PROPERTY { return _sRGB; }
-    bool getHDR() SWIFT_COMPUTED_PROPERTY { return _hdr; }
-    bool getLinear() SWIFT_COMPUTED_PROPERTY { return _colorProfile == nullptr && _sRGB == false; }
+    LCMSColorProfile* fn_nullable getColorProfile() SWIFT_COMPUTED_PROPERTY SWIFT_RETURNS_UNRETAINED { _ensureDecoded(); return _colorProfile; }
+    bool getSRGB() SWIFT_COMPUTED_PROPERTY { _ensureDecoded(); return _sRGB; }
+    bool getHDR() SWIFT_COMPUTED_PROPERTY { _ensureDecoded(); return _hdr; }
+    bool getLinear() SWIFT_COMPUTED_PROPERTY { _ensureDecoded(); return _colorProfile == nullptr && _sRGB == false; }
     
-    const char* fn_nonnull getContents() SWIFT_COMPUTED_PROPERTY { return _contents; }
-    long getContentsSize() SWIFT_COMPUTED_PROPERTY { return _width * _height * _depth * _pixelFormat.getSize(); }
+    const char* fn_nonnull getContents() SWIFT_COMPUTED_PROPERTY { _ensureDecoded(); return _contents; }
+    /// Size of contents in bytes from the first to the last pixel, including row padding.
+    long getContentsSize() SWIFT_COMPUTED_PROPERTY { return (_depth - 1) * _bytesPerSlice + (_height - 1) * _bytesPerRow + _width * _pixelFormat.getSize(); }
+    
+    /// Distance between rows of contents in bytes.
+    ///
+    /// Rows are tightly packed unless the container is created with padded rows. Processing functions that can't handle padding remove it.
+    long getBytesPerRow() SWIFT_COMPUTED_PROPERTY { return _bytesPerRow; }
+    
+    /// Distance between slices of contents in bytes.
+    long getBytesPerSlice() SWIFT_COMPUTED_PROPERTY { return _bytesPerSlice; }
+    
+    /// Checks if rows and slices are tightly packed.
+    bool getIsPacked() SWIFT_COMPUTED_PROPERTY { return _bytesPerRow == _width * _pixelFormat.getSize() && _bytesPerSlice == _bytesPerRow * _height; }
+    
+    /// Checks if the container refers to a region of another image. See ``createView``.
+    bool getIsView() SWIFT_COMPUTED_PROPERTY;
     long getWidth() SWIFT_COMPUTED_PROPERTY { return _width; }
     long getHeight() SWIFT_COMPUTED_PROPERTY { return _height; }
     long getDepth() SWIFT_COMPUTED_PROPERTY { return _depth; }
     
+    /// Checks if contents are stored in a memory-mapped file. See ``createFileBacked``.
+    bool getIsFileBacked() SWIFT_COMPUTED_PROPERTY;
+    
     
     ImagePixel getPixel(long x, long y, long z = 0);
     
@@ -221,6 +471,9 @@ public:
     [[nodiscard("Don't forget to release the copied object using the ImageContainerRelease function.")]]
     ImageContainer* fn_nonnull copy() SWIFT_RETURNS_RETAINED;
     
+    /// Creates a copy of the image container with contents stored in a memory-mapped file. See ``createFileBacked``.
+    ImageContainer* fn_nullable copyToFile(const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__copyToFileUnsafe(path:_:)) SWIFT_RETURNS_RETAINED;
+    
     /// Creates a copy of the image container with modifier component type.
     ImageContainer* fn_nonnull createPromoted(PixelComponentType componentType) SWIFT_RETURNS_RETAINED;
     
@@ -232,6 +485,12 @@ public:
     
     /// Estimates number of possible mip levels.
     long calculateMipLevelCount();
+    
+    /// Calculates statistics of every component and optionally their histograms in one parallel pass. Integer components are normalized to the [0, 1] range like in ``getPixel``.
+    ///
+    /// - Parameter statistics: Receives an entry for every component.
+    /// - Parameter histograms: Receives `numBins` counts for every component, bins of the first component go first. Values outside of the histogram range are counted in the edge bins, NaN and infinity are not counted. Pass `nullptr` to skip histograms.
+    bool calculateStatistics(ImageChannelStatistics* fn_nonnull statistics, long* fn_nullable histograms, long numBins, float histogramMin, float histogramMax, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__calculateStatisticsUnsafe(_:_:numBins:histogramMin:histogramMax:_:));
     //ImageContainerCollection generateMips(ResamplingAlgorithm algorithm, float quality, bool renormalize, bool ignoreColorSpace);
     
     //void generateCubeMap();
@@ -0,0 +1,92 @@
+//
+//  ImageContainerCache.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+#include <LCMS2C/LCMS2C.hpp>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/// Cache of decoded images.
+///
+/// Images are keyed by path, file modification time and size, and loading assumptions, so a modified file is decoded again. Least recently used images are evicted once the total size of cached contents exceeds the memory budget.
+///
+/// Concurrent loads of the same image are deduplicated - only one thread decodes the image, other threads wait for it and share the result.
+///
+/// - Note: This object is thread-safe.
+class ImageContainerCache final {
+private:
+    struct _Entry {
+        ImageContainer* fn_nonnull image;
+        long size;
+        std::list<std::string>::iterator position;
+    };
+    
+    struct _PendingLoad {
+        bool finished;
+        ImageContainer* fn_nullable image;
+        ImageToolsError error;
+        
+        ~_PendingLoad() {
+            ImageContainerRelease(image);
+        }
+    };
+    
+    std::atomic<size_t> _referenceCounter;
+    
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    long _maxBytes;
+    long _usedBytes;
+    
+    /// Keys from the most to the least recently used.
+    std::list<std::string> _recentlyUsed;
+    std::unordered_map<std::string, _Entry> _entries;
+    std::unordered_map<std::string, std::shared_ptr<_PendingLoad>> _pendingLoads;
+    
+    ImageContainerCache(long maxBytes);
+    ~ImageContainerCache();
+    
+    FN_FRIEND_SWIFT_INTERFACE(ImageContainerCache)
+    
+    void _evict(long maxBytes);
+    
+public:
+    /// Creates a cache.
+    ///
+    /// - Parameter maxBytes: Maximum total size of cached image contents.
+    static ImageContainerCache* fn_nonnull create(long maxBytes) SWIFT_NAME(create(maxBytes:)) SWIFT_RETURNS_RETAINED;
+    
+    long getMaxBytes() SWIFT_COMPUTED_PROPERTY;
+    void setMaxBytes(long maxBytes) SWIFT_COMPUTED_PROPERTY;
+    long getUsedBytes() SWIFT_COMPUTED_PROPERTY;
+    long getNumImages() SWIFT_COMPUTED_PROPERTY;
+    
+    /// Returns a cached image or loads it using ``ImageContainer/load``.
+    ///
+    /// Images larger than the memory budget are loaded but not cached. Images are not cached either if the assumed colour profile was not created by ImageTools, since such profiles can't be identified after they are released.
+    ///
+    /// - Note: Returned images are shared between callers. ImageContainer is immutable, so it's safe.
+    ImageContainer* fn_nullable load(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__loadUnsafe(path:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Removes an image loaded from the path with any assumptions.
+    void remove(const char* fn_nonnull path fn_noescape) SWIFT_NAME(remove(path:));
+    
+    /// Removes all cached images.
+    void removeAll();
+} FN_SWIFT_INTERFACE(ImageContainerCache);
+
+
+FN_DEFINE_SWIFT_INTERFACE(ImageContainerCache)
@@ -0,0 +1,136 @@
+//
+//  ImageDiskCache.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/// Identifies a cached result by a hash of source data and operation parameters.
+///
+/// Every added value is hashed separately from its neighbours, so `add(1); add(23)` and `add(12); add(3)` produce different keys. Add values in the same order every time.
+///
+/// - Note: The hash is fast but not cryptographic. Don't use the cache for untrusted inputs.
+struct ImageDiskCacheKey {
+    uint64_t _lanes[2];
+    uint64_t _length;
+    
+    ImageDiskCacheKey();
+    
+    void add(const void* fn_nonnull data, long size) SWIFT_NAME(__addUnsafe(_:size:));
+    void add(long value);
+    void add(double value);
+    void add(bool value);
+    void add(const char* fn_nonnull string fn_noescape);
+    
+    /// Adds contents of a file.
+    bool addFile(const char* fn_nonnull path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__addFileUnsafe(path:_:));
+    
+    /// Writes a 32 characters long hexadecimal representation of the key and a null terminator.
+    void getHexString(char* fn_nonnull buffer) const;
+};
+
+
+/// Disk cache data callback.
+///
+/// Receives the cached data. The data is only valid during the call.
+typedef void (* ImageDiskCacheDataCallback)(void* fn_nullable userInfo, const void* fn_nonnull data, long size);
+
+
+/// Persistent cache of processed images and other data on disk.
+///
+/// Files are written to a temporary file first and then renamed, so concurrent readers and writers, even from different processes, never see partially written entries.
+///
+/// Least recently used entries are removed once the total size of cache files exceeds the byte budget. Entries of other processes sharing the directory are only accounted for when the cache is created.
+///
+/// - Note: ``ASTCImage`` has no public byte representation here, so store encoded ASTC payloads as data using ``storeData``.
+/// - Note: This object is thread-safe.
+class ImageDiskCache final {
+private:
+    struct _Entry {
+        long size;
+        std::list<std::string>::iterator position;
+    };
+    
+    std::atomic<size_t> _referenceCounter;
+    
+    std::string _directory;
+    
+    std::mutex _mutex;
+    long _maxBytes;
+    long _usedBytes;
+    
+    /// File names from the most to the least recently used.
+    std::list<std::string> _recentlyUsed;
+    std::unordered_map<std::string, _Entry> _entries;
+    
+    ImageDiskCache(const char* fn_nonnull directory, long maxBytes);
+    ~ImageDiskCache();
+    
+    FN_FRIEND_SWIFT_INTERFACE(ImageDiskCache)
+    
+    std::string _getPath(const ImageDiskCacheKey& key, const char* fn_nonnull extension) const;
+    std::string _getName(const std::string& path) const;
+    static std::string _getTemporaryPath(const std::string& path);
+    bool _commitFile(const std::string& temporaryPath, const std::string& path, ImageToolsError* fn_nullable error fn_noescape);
+    bool _writeFile(const std::string& path, const void* fn_nonnull header, long headerSize, const void* fn_nullable data, long size, ImageToolsError* fn_nullable error fn_noescape);
+    
+    /// Checks that an entry of the size fits into the byte budget.
+    bool _checkFits(long size, ImageToolsError* fn_nullable error fn_noescape);
+    
+    /// Scans existing cache files, oldest first. Temporary files left behind by crashed writers are removed.
+    void _scanDirectory();
+    /// Records a written entry and removes least recently used files that exceed the budget.
+    void _recordFile(const std::string& name, long size);
+    /// Marks an entry as recently used.
+    void _touchFile(const std::string& name);
+    void _forgetFile(const std::string& name);
+    /// Must be called with locked mutex.
+    void _evict(long maxBytes);
+    
+public:
+    /// Creates a cache stored in the directory. The directory is created if it doesn't exist.
+    ///
+    /// - Parameter maxBytes: Maximum total size of cache files.
+    static ImageDiskCache* fn_nullable create(const char* fn_nonnull directory fn_noescape, long maxBytes, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createUnsafe(directory:maxBytes:_:)) SWIFT_RETURNS_RETAINED;
+    
+    long getMaxBytes() SWIFT_COMPUTED_PROPERTY;
+    void setMaxBytes(long maxBytes) SWIFT_COMPUTED_PROPERTY;
+    long getUsedBytes() SWIFT_COMPUTED_PROPERTY;
+    
+    /// Loads a cached image.
+    ///
+    /// Contents of the image are memory-mapped from the cache file.
+    ///
+    /// - Returns: `nullptr` if there is no valid cached image for the key.
+    ImageContainer* fn_nullable loadImage(const ImageDiskCacheKey& key) SWIFT_RETURNS_RETAINED;
+    
+    /// Stores an image. Images larger than the byte budget are not stored.
+    ///
+    /// - Note: Only images without colour profiles or with colour profiles created by ImageTools can be stored, since arbitrary LCMS profiles can't be serialized.
+    bool storeImage(const ImageDiskCacheKey& key, ImageContainer* fn_nonnull image, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__storeImageUnsafe(_:_:_:));
+    
+    /// Passes cached data to the callback.
+    ///
+    /// - Returns: `false` if there is no valid cached data for the key.
+    bool loadData(const ImageDiskCacheKey& key, void* fn_nullable userInfo, ImageDiskCacheDataCallback fn_nonnull callback) SWIFT_NAME(__loadDataUnsafe(_:userInfo:callback:));
+    
+    /// Stores arbitrary data, for example an encoded ASTC image. Data larger than the byte budget is not stored.
+    bool storeData(const ImageDiskCacheKey& key, const void* fn_nonnull data, long size, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__storeDataUnsafe(_:_:size:_:));
+    
+    /// Removes cached image and data for the key.
+    void remove(const ImageDiskCacheKey& key);
+} FN_SWIFT_INTERFACE(ImageDiskCache);
+
+
+FN_DEFINE_SWIFT_INTERFACE(ImageDiskCache)
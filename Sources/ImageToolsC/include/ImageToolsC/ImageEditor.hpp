@@ -14,6 +14,8 @@
 
 /// Image editor.
 ///
+/// The editor shares contents with images it's created from and images it returns. Contents are copied only when the editor modifies them while they are still referenced elsewhere.
+///
 /// - Warning: This object is not thread-safe. Access this object only from one thread at a time.
 class ImageEditor final {
 private:
@@ -24,6 +26,9 @@ private:
     ImageEditor(ImageContainer* fn_nonnull image);
     ~ImageEditor();
     
+    /// Copies the image if it's shared before it's modified.
+    void _prepareForEditing();
+    
     friend ImageEditor* fn_nullable ImageEditorRetain(ImageEditor* fn_nullable editor) SWIFT_RETURNS_UNRETAINED;
     friend void ImageEditorRelease(ImageEditor* fn_nullable editor);
     
@@ -35,6 +40,7 @@ public:
     
     void edit(ImageContainer* fn_nonnull image);
     
+    /// Returns the edited image. The image shares contents with the editor until the editor modifies it again.
     [[nodiscard("Don't forget to release the image using the ImageContainerRelease function.")]]
     ImageContainer* fn_nonnull getImageCopy() SWIFT_COMPUTED_PROPERTY SWIFT_RETURNS_RETAINED;
     
@@ -71,6 +77,18 @@ public:
     
     void sRGBToLinear(bool preserveAlpha) SWIFT_NAME(sRGBToLinear(preserveAlpha:));
     void linearToSRGB(bool preserveAlpha) SWIFT_NAME(linearToSRGB(preserveAlpha:));
+    
+    /// Applies a 3D lookup table to the first 3 components, other components are not changed. Fails for images with less than 3 components.
+    ///
+    /// - Parameter linearize: Converts results from sRGB to linear space in the same pass, as if ``sRGBToLinear`` was called afterwards.
+    bool applyColorLUT(ColorLUT* fn_nonnull lut, ColorLUTInterpolation interpolation, bool linearize, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__applyColorLUTUnsafe(_:interpolation:linearize:error:));
+    
+    /// Converts an HDR image to an SDR `uint8` sRGB image.
+    ///
+    /// Pixels are converted to linear sRGB if needed, scaled by `2^exposure`, tone mapped and sRGB encoded in one pass.
+    ///
+    /// - Parameter dither: Adds noise of one step before rounding to hide banding.
+    void toneMap(ToneMappingOperator toneMappingOperator, float exposure, bool dither) SWIFT_NAME(toneMap(_:exposure:dither:));
 } FN_SWIFT_INTERFACE(ImageEditor);
 
 
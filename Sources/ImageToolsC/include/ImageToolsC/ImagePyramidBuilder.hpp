@@ -0,0 +1,60 @@
+//
+//  ImagePyramidBuilder.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+
+
+/// Pyramid tile callback.
+///
+/// Receives a tile of the pyramid level at the column and row. The tile is only valid during the call, retain it to keep it.
+///
+/// - Note: The callback is called concurrently from multiple threads.
+/// - Returns: `true` to cancel building the pyramid.
+typedef bool (* ImagePyramidTileCallback)(void* fn_nullable userInfo, long level, long column, long row, ImageContainer* fn_nonnull tile);
+
+
+/// Image pyramid options.
+struct ImagePyramidOptions {
+    /// Width and height of tiles without overlap.
+    long tileSize;
+    
+    /// Number of pixels a tile shares with each neighbouring tile. Tiles on image edges have no overlap on the outer side.
+    long overlap;
+    
+    /// Lanczos filter quality used to build lower levels.
+    float quality;
+    
+    bool renormalize;
+    
+    /// 256 pixels tiles with one pixel overlap.
+    ImagePyramidOptions();
+    ImagePyramidOptions(long tileSize, long overlap, float quality = 3, bool renormalize = false);
+};
+
+
+/// Builds deep zoom tile pyramids.
+///
+/// Levels are numbered like in the Deep Zoom format - level `0` is a 1x1 image, every next level doubles the size and the last level has the full image size. Every level is built by downsampling the previous one, and tiles of a level are passed to the callback on a separate thread while the next level is computed.
+class ImagePyramidBuilder final {
+private:
+    static ImageContainer* fn_nonnull _createNextLevel(ImageContainer* fn_nonnull level, const ImagePyramidOptions& options) SWIFT_RETURNS_RETAINED;
+    static ImageContainer* fn_nonnull _createEmittedLevel(ImageContainer* fn_nonnull level, ImageContainer* fn_nonnull image) SWIFT_RETURNS_RETAINED;
+    static bool _emitTiles(ImageContainer* fn_nonnull level, long levelIndex, const ImagePyramidOptions& options, void* fn_nullable userInfo, ImagePyramidTileCallback fn_nonnull callback);
+    
+public:
+    /// Number of pyramid levels for an image of the specified size.
+    static long getNumLevels(long width, long height);
+    
+    /// Builds a pyramid of a flat image and passes its tiles to the callback, from the full size level down to the 1x1 level.
+    ///
+    /// - Returns: `false` if the callback cancelled the operation or the image is not flat.
+    static bool build(ImageContainer* fn_nonnull image, ImagePyramidOptions options, void* fn_nullable userInfo, ImagePyramidTileCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__buildUnsafe(_:options:userInfo:callback:_:));
+};
@@ -0,0 +1,114 @@
+//
+//  ImageRowSource.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+#include <LCMS2C/LCMS2C.hpp>
+
+
+struct ImageRowStage;
+
+
+/// Row batch callback.
+///
+/// Receives tightly packed rows in the source's pixel format.
+///
+/// - Returns: `true` if the operation should be cancelled, otherwise `false`.
+typedef bool (* ImageRowSourceCallback)(void* fn_nullable userInfo, const char* fn_nonnull rows, long firstRow, long numRows);
+
+
+/// Source of image rows.
+///
+/// Yields rows of a decoded image from top to bottom. Sources can be chained with converters and a resampler. In a `decode -> linearize -> downscale -> encode` job the decode stage holds the whole decoded image, every following stage only keeps a few rows in memory.
+///
+/// Every stage retains its upstream source and reads from it. Don't read rows from a source after it has been connected to another stage.
+///
+/// - Note: Images are opened using ``ImageContainer/load``. Decoders used by ImageTools hand over fully decoded images, so a decoder source keeps the decoded container until all rows are read. Only the converted rows are produced on demand.
+///
+/// - Warning: This object is not thread-safe. Access this object only from one thread at a time.
+class ImageRowSource final {
+private:
+    std::atomic<size_t> _referenceCounter;
+    
+    ImagePixelFormat _pixelFormat;
+    LCMSColorProfile* fn_nullable _colorProfile;
+    bool _sRGB;
+    bool _hdr;
+    long _width;
+    long _height;
+    long _currentRow;
+    
+    ImageRowStage* fn_nonnull _stage;
+    
+    ImageRowSource(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, ImageRowStage* fn_nonnull stage);
+    ~ImageRowSource();
+    
+    FN_FRIEND_SWIFT_INTERFACE(ImageRowSource)
+    
+    /// Creates a source yielding rows of the decoded image.
+    static ImageRowSource* fn_nonnull _createWithImage(ImageContainer* fn_nonnull image) SWIFT_RETURNS_RETAINED;
+    ImageRowSource* fn_nonnull _createTransferConverted(bool toLinear, bool preserveAlpha) SWIFT_RETURNS_RETAINED;
+    
+public:
+    static ImageRowSource* fn_nullable open(const char* fn_nonnull path fn_noescape, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__openUnsafe(path:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    static ImageRowSource* fn_nullable open(const void* fn_nonnull buffer fn_noescape, long bufferSize, LCMSColorProfile* fn_nullable assumedColorProfile, bool assumeSRGB, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__openUnsafe(buffer:size:_:_:_:)) SWIFT_RETURNS_RETAINED;
+    
+    ImagePixelFormat getPixelFormat() SWIFT_COMPUTED_PROPERTY { return _pixelFormat; }
+    LCMSColorProfile* fn_nullable getColorProfile() SWIFT_COMPUTED_PROPERTY SWIFT_RETURNS_UNRETAINED { return _colorProfile; }
+    bool getSRGB() SWIFT_COMPUTED_PROPERTY { return _sRGB; }
+    bool getHDR() SWIFT_COMPUTED_PROPERTY { return _hdr; }
+    bool getLinear() SWIFT_COMPUTED_PROPERTY { return _colorProfile == nullptr && _sRGB == false; }
+    
+    long getWidth() SWIFT_COMPUTED_PROPERTY { return _width; }
+    long getHeight() SWIFT_COMPUTED_PROPERTY { return _height; }
+    long getBytesPerRow() SWIFT_COMPUTED_PROPERTY { return _width * _pixelFormat.getSize(); }
+    
+    /// Index of the next row to be read.
+    long getCurrentRow() SWIFT_COMPUTED_PROPERTY { return _currentRow; }
+    
+    /// Reads next rows into the destination buffer.
+    ///
+    /// - Parameter destination: Buffer of at least `maxRows * getBytesPerRow()` bytes.
+    /// - Returns: Number of rows read. `0` if all rows are read.
+    long readRows(char* fn_nonnull destination, long maxRows);
+    
+    /// Reads all rows and passes them in batches to the callback.
+    ///
+    /// The next batch is produced on a separate thread while the callback processes the current one, so decoding and processing overlap.
+    ///
+    /// - Returns: `true` if all rows were passed to the callback, `false` if the callback cancelled the operation.
+    bool drain(long rowsPerBatch, void* fn_nullable userInfo, ImageRowSourceCallback fn_nonnull callback, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__drainUnsafe(rowsPerBatch:userInfo:callback:error:));
+    
+    /// Reads all rows into a new image container.
+    ImageContainer* fn_nullable createImage(ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createImageUnsafe(_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a stage that converts rows to another component type.
+    ImageRowSource* fn_nonnull createPromoted(PixelComponentType componentType) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a stage that converts rows from sRGB to linear colour space.
+    ///
+    /// Rows with a colour profile are converted to the linear version of the profile, alpha is always preserved in this case.
+    ImageRowSource* fn_nonnull createSRGBToLinearConverted(bool preserveAlpha) SWIFT_NAME(createSRGBToLinearConverted(preserveAlpha:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a stage that converts rows from linear to sRGB colour space.
+    ///
+    /// Rows with a linear colour profile are converted to the profile it was created from, or to sRGB. Alpha is always preserved in this case.
+    ImageRowSource* fn_nonnull createLinearToSRGBConverted(bool preserveAlpha) SWIFT_NAME(createLinearToSRGBConverted(preserveAlpha:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Creates a stage that resamples rows using the Lanczos filter.
+    ///
+    /// Only `2 * quality + 1` horizontally resampled rows and one batch of source rows are kept in memory.
+    ///
+    /// - Note: Unlike ``ImageContainer/createResampled``, pixels are not converted to a linear colour profile. Connect this stage after ``createSRGBToLinearConverted`` if needed.
+    ImageRowSource* fn_nonnull createResampled(ResamplingAlgorithm algorithm, float quality, long width, long height, bool renormalize = false) SWIFT_NAME(createResampled(_:quality:width:height:renormalize:)) SWIFT_RETURNS_RETAINED;
+} FN_SWIFT_INTERFACE(ImageRowSource);
+
+
+FN_DEFINE_SWIFT_INTERFACE(ImageRowSource)
@@ -11,8 +11,16 @@
 
 #include <ImageToolsC/Common.hpp>
 #include <ImageToolsC/ImagePixel.hpp>
+#include <ImageToolsC/ImageAllocator.hpp>
 #include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ColorLUT.hpp>
 #include <ImageToolsC/ImageEditor.hpp>
+#include <ImageToolsC/ImageRowSource.hpp>
+#include <ImageToolsC/ImageBatchLoader.hpp>
+#include <ImageToolsC/ImageContainerCache.hpp>
+#include <ImageToolsC/ImageDiskCache.hpp>
+#include <ImageToolsC/TiledImage.hpp>
+#include <ImageToolsC/ImagePyramidBuilder.hpp>
 
 void ImageTools_testThreadSpawning();
 
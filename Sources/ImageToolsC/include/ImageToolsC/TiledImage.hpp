@@ -0,0 +1,151 @@
+//
+//  TiledImage.hpp
+//  ImageTools
+//
+//  Created by Evgenij Lutz on 18.10.26.
+//
+
+#pragma once
+
+#include <ImageToolsC/Common.hpp>
+#include <ImageToolsC/ImageContainer.hpp>
+#include <ImageToolsC/ImageRowSource.hpp>
+#include <ImageToolsC/ProgressCallback.hpp>
+#include <LCMS2C/LCMS2C.hpp>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/// Flat image stored on disk as a grid of square tiles.
+///
+/// Only a bounded number of tiles is kept in memory, least recently used tiles are written back to disk. Processing functions work tile by tile on all cores and read neighbouring pixels (halo) where an operation needs them, so images of any size can be processed with a fixed amount of memory.
+///
+/// Processed images are stored in temporary files in the same directory as the source image.
+///
+/// - Note: This object is thread-safe.
+class TiledImage final {
+private:
+    struct _Tile {
+        char* fn_nullable contents;
+        long numUsers;
+        
+        /// The tile is being read from or written to disk.
+        bool busy;
+        bool dirty;
+        std::list<long>::iterator position;
+    };
+    
+    std::atomic<size_t> _referenceCounter;
+    
+    ImagePixelFormat _pixelFormat;
+    LCMSColorProfile* fn_nullable _colorProfile;
+    bool _sRGB;
+    bool _hdr;
+    long _width;
+    long _height;
+    long _tileSize;
+    long _numTilesX;
+    long _numTilesY;
+    long _cacheSize;
+    
+    /// Tiles are stored in row-major order, each one padded to the full tile size.
+    int _fileDescriptor;
+    
+    /// Directory for temporary files of processed images.
+    std::string _directory;
+    
+    /// The file is provided by user and has to be up to date when the image is released.
+    bool _keepFile;
+    
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    long _maxCachedTiles;
+    std::unordered_map<long, _Tile> _tiles;
+    
+    /// Indices of unused cached tiles from the most to the least recently used.
+    std::list<long> _recentlyUsed;
+    std::atomic<bool> _ioFailed;
+    
+    TiledImage(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, int fileDescriptor, const std::string& directory, bool keepFile);
+    ~TiledImage();
+    
+    FN_FRIEND_SWIFT_INTERFACE(TiledImage)
+    
+    static TiledImage* fn_nullable _create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, const char* fn_nullable path, const std::string& directory, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    /// Creates an empty image in a temporary file next to this one.
+    TiledImage* fn_nullable _createDerived(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, ImageToolsError* fn_nullable error fn_noescape) SWIFT_RETURNS_RETAINED;
+    
+    long _getTileContentsSize() const { return _tileSize * _tileSize * _pixelFormat.getSize(); }
+    void _readTile(long tileIndex, char* fn_nonnull contents);
+    void _writeTile(long tileIndex, const char* fn_nonnull contents);
+    
+    /// Returns contents of the tile and keeps them in memory until the tile is unlocked.
+    char* fn_nonnull _lockTile(long tileIndex);
+    void _unlockTile(long tileIndex, bool modified);
+    
+    void _copyRegion(long x, long y, long width, long height, char* fn_nonnull pixels, bool write);
+    ImageContainer* fn_nonnull _createRegionImage(long x, long y, long width, long height) SWIFT_RETURNS_RETAINED;
+    void _setRegionImage(ImageContainer* fn_nonnull image, long x, long y);
+    
+    /// Creates a processed image by calling the function for every tile of it on all cores.
+    ///
+    /// The function receives a new processed image and coordinates of the tile, and returns the processed region of the tile size.
+    TiledImage* fn_nullable _process(TiledImage* fn_nonnull destination, void* fn_nullable context, ImageContainer* fn_nonnull (* fn_nonnull function)(TiledImage* fn_nonnull source, void* fn_nullable context, long x, long y, long width, long height), ImageToolsError* fn_nullable error fn_noescape, void* fn_nullable userInfo fn_noescape, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape) SWIFT_RETURNS_RETAINED;
+    
+public:
+    /// Creates an empty tiled image filled with zeros.
+    ///
+    /// - Parameter tileSize: Width and height of tiles in pixels.
+    /// - Parameter cacheSize: Maximum size of tiles kept in memory in bytes. At least a few tiles per core are kept in memory.
+    /// - Parameter path: File to store tiles in. The file is created or overwritten and contains all tiles after the image is released. If `nullptr`, an unnamed file in the temporary directory is used.
+    static TiledImage* fn_nullable create(ImagePixelFormat pixelFormat, LCMSColorProfile* fn_nullable colorProfile, bool sRGB, bool hdr, long width, long height, long tileSize, long cacheSize, const char* fn_nullable path fn_noescape, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createUnsafe(_:_:_:_:width:height:tileSize:cacheSize:path:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Splits an image into tiles stored in a temporary file.
+    static TiledImage* fn_nullable create(ImageContainer* fn_nonnull image, long tileSize, long cacheSize, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createUnsafe(_:tileSize:cacheSize:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Reads all rows of the source into tiles stored in a temporary file. The source's decode stage holds the whole decoded image until all rows are read, tiles are limited by the cache size.
+    static TiledImage* fn_nullable create(ImageRowSource* fn_nonnull source, long tileSize, long cacheSize, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createUnsafe(_:tileSize:cacheSize:_:)) SWIFT_RETURNS_RETAINED;
+    
+    ImagePixelFormat getPixelFormat() SWIFT_COMPUTED_PROPERTY { return _pixelFormat; }
+    LCMSColorProfile* fn_nullable getColorProfile() SWIFT_COMPUTED_PROPERTY SWIFT_RETURNS_UNRETAINED { return _colorProfile; }
+    bool getSRGB() SWIFT_COMPUTED_PROPERTY { return _sRGB; }
+    bool getHDR() SWIFT_COMPUTED_PROPERTY { return _hdr; }
+    bool getLinear() SWIFT_COMPUTED_PROPERTY { return _colorProfile == nullptr && _sRGB == false; }
+    
+    long getWidth() SWIFT_COMPUTED_PROPERTY { return _width; }
+    long getHeight() SWIFT_COMPUTED_PROPERTY { return _height; }
+    long getTileSize() SWIFT_COMPUTED_PROPERTY { return _tileSize; }
+    long getNumTilesX() SWIFT_COMPUTED_PROPERTY { return _numTilesX; }
+    long getNumTilesY() SWIFT_COMPUTED_PROPERTY { return _numTilesY; }
+    
+    /// Copies a region of the image into an image container.
+    ImageContainer* fn_nullable createImage(long x, long y, long width, long height, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__createImageUnsafe(x:y:width:height:_:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Copies pixels of the image container into the image at the specified position.
+    ///
+    /// - Note: The image container must have the same pixel format. Pixels outside of the image are ignored.
+    bool setImage(ImageContainer* fn_nonnull image, long x, long y, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__setImageUnsafe(_:x:y:_:));
+    
+    /// Writes all modified tiles to disk.
+    bool flush(ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__flushUnsafe(_:));
+    
+    TiledImage* fn_nullable createPromoted(PixelComponentType componentType, ImageToolsError* fn_nullable error fn_noescape = nullptr, void* fn_nullable userInfo fn_noescape = nullptr, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape = nullptr) SWIFT_NAME(__createPromotedUnsafe(_:error:userInfo:progressCallback:)) SWIFT_RETURNS_RETAINED;
+    TiledImage* fn_nullable createSRGBToLinearConverted(bool preserveAlpha, ImageToolsError* fn_nullable error fn_noescape = nullptr, void* fn_nullable userInfo fn_noescape = nullptr, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape = nullptr) SWIFT_NAME(__createSRGBToLinearConvertedUnsafe(preserveAlpha:error:userInfo:progressCallback:)) SWIFT_RETURNS_RETAINED;
+    TiledImage* fn_nullable createLinearToSRGBConverted(bool preserveAlpha, ImageToolsError* fn_nullable error fn_noescape = nullptr, void* fn_nullable userInfo fn_noescape = nullptr, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape = nullptr) SWIFT_NAME(__createLinearToSRGBConvertedUnsafe(preserveAlpha:error:userInfo:progressCallback:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Resamples the image using Lanczos filter.
+    ///
+    /// Every tile reads the source region covered by the filter, so the result has no seams between tiles.
+    TiledImage* fn_nullable createResampled(float quality, long width, long height, bool renormalize = false, ImageToolsError* fn_nullable error fn_noescape = nullptr, void* fn_nullable userInfo fn_noescape = nullptr, ImageToolsProgressCallback fn_nullable progressCallback fn_noescape = nullptr) SWIFT_NAME(__createResampledUnsafe(quality:width:height:renormalize:error:userInfo:progressCallback:)) SWIFT_RETURNS_RETAINED;
+    
+    /// Copies a channel of the source image into a channel of this image in place.
+    ///
+    /// - Note: The source image must have the same dimensions.
+    bool setChannel(long channelIndex, TiledImage* fn_nonnull sourceImage, long sourceChannelIndex, ImageToolsError* fn_nullable error fn_noescape = nullptr) SWIFT_NAME(__setChannelUnsafe(_:_:_:_:));
+} FN_SWIFT_INTERFACE(TiledImage);
+
+
+FN_DEFINE_SWIFT_INTERFACE(TiledImage)